@@ -1,11 +1,27 @@
 #version 330 core
+#ifdef BINDLESS_TEXTURES
+#extension GL_ARB_bindless_texture : require
+#endif
 
 struct Material {
+#ifdef TEXTURE_ARRAYS
+    sampler2DArray diffuseArray;
+    sampler2DArray specularArray;
+#elif !defined(BINDLESS_TEXTURES)
     sampler2D texture_diffuse0;
     sampler2D texture_specular0;
+#endif
     float shininess;
 };
 
+// entry of the MaterialTable buffer, std140
+struct MaterialEntry {
+    // diffuse handle in xy, specular handle in zw
+    uvec4 handles;
+    // diffuse layer, specular layer, shininess, unused
+    vec4 parameters;
+};
+
 struct DirectionalLight {
     vec3 direction;
     
@@ -46,11 +62,43 @@ in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoords;
 
+// permutation defines, injected by Shader before compilation:
+// NR_POINT_LIGHTS  number of point lights (0 disables them)
+// NO_SPECULAR_MAP  the material has no specular texture
+// NO_SPOTLIGHT     the scene has no spotlight
+// TEXTURE_ARRAYS   drawn by a MeshBatch, textures are texture array layers
+//                  read from the material table
+// BINDLESS_TEXTURES textures are handles in the material table, selected
+//                  by materialIndex
+#ifndef NR_POINT_LIGHTS
 #define NR_POINT_LIGHTS 4
+#endif
+#if defined(TEXTURE_ARRAYS) || defined(BINDLESS_TEXTURES)
+#define MATERIAL_TABLE
+#endif
+// must match MaterialTable::maxMaterials
+#ifndef MAX_MATERIALS
+#define MAX_MATERIALS 512
+#endif
+
+#ifdef MATERIAL_TABLE
+layout (std140) uniform Materials {
+    MaterialEntry materials[MAX_MATERIALS];
+};
+#endif
+#ifdef TEXTURE_ARRAYS
+flat in uint MaterialIndex;
+#elif defined(BINDLESS_TEXTURES)
+uniform int materialIndex;
+#endif
 
 uniform DirectionalLight directionalLight;
+#if NR_POINT_LIGHTS > 0
 uniform PointLight pointLights[NR_POINT_LIGHTS];
+#endif
+#ifndef NO_SPOTLIGHT
 uniform SpotLight spotLight;
+#endif
 
 uniform Material material;
 uniform vec3 viewPos;
@@ -59,17 +107,29 @@ out vec4 FragColor;
 
 vec3 CalcDirectionalLight(DirectionalLight light, vec3 normal, vec3 viewDir);
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+#ifndef NO_SPOTLIGHT
 vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+#endif
+vec3 CalcSpecular(vec3 lightSpecular, vec3 lightDir, vec3 normal, vec3 viewDir);
+vec3 DiffuseColor();
+float Shininess();
+#ifndef NO_SPECULAR_MAP
+vec3 SpecularColor();
+#endif
 
 void main() {
     vec3 normal = normalize(Normal);
     vec3 viewDir = normalize(viewPos - FragPos);
 
     vec3 color = CalcDirectionalLight(directionalLight, normal, viewDir);
+#if NR_POINT_LIGHTS > 0
     for (int i = 0; i < NR_POINT_LIGHTS ; i++) {
         color += CalcPointLight(pointLights[i], normal, FragPos, viewDir);
     }
+#endif
+#ifndef NO_SPOTLIGHT
     color += CalcSpotLight(spotLight, normal, FragPos, viewDir);
+#endif
 
     FragColor = vec4(color, 1.0);
 }
@@ -79,16 +139,63 @@ vec3 CalcDirectionalLight(DirectionalLight light, vec3 normal, vec3 viewDir) {
     vec3 lightDir = normalize(light.direction);
     float diff = max(dot(normal, -lightDir), 0.0);
     
-    // specular
+    vec3 ambient = light.ambient * DiffuseColor();
+    vec3 diffuse = light.diffuse * (diff * DiffuseColor());
+    vec3 specular = CalcSpecular(light.specular, lightDir, normal, viewDir);
+
+    return ambient + diffuse + specular;
+}
+
+// lightDir points from the light towards the fragment
+vec3 CalcSpecular(vec3 lightSpecular, vec3 lightDir, vec3 normal, vec3 viewDir) {
+#ifdef NO_SPECULAR_MAP
+    return vec3(0.0);
+#else
     vec3 reflectDir = reflect(lightDir, normal);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), Shininess());
+    return lightSpecular * (spec * SpecularColor());
+#endif
+}
 
-    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse0, TexCoords));
-    vec3 diffuse = light.diffuse * (diff * vec3(texture(material.texture_diffuse0, TexCoords)));
-    vec3 specular = light.specular * (spec * vec3(texture(material.texture_specular0, TexCoords)));
+#ifdef MATERIAL_TABLE
+MaterialEntry CurrentMaterial() {
+#ifdef TEXTURE_ARRAYS
+    return materials[MaterialIndex];
+#else
+    return materials[materialIndex];
+#endif
+}
+#endif
+
+vec3 DiffuseColor() {
+#ifdef TEXTURE_ARRAYS
+    return vec3(texture(material.diffuseArray, vec3(TexCoords, CurrentMaterial().parameters.x)));
+#elif defined(BINDLESS_TEXTURES)
+    return vec3(texture(sampler2D(CurrentMaterial().handles.xy), TexCoords));
+#else
+    return vec3(texture(material.texture_diffuse0, TexCoords));
+#endif
+}
 
-    return ambient + diffuse + specular;
+float Shininess() {
+#ifdef MATERIAL_TABLE
+    return CurrentMaterial().parameters.z;
+#else
+    return material.shininess;
+#endif
+}
+
+#ifndef NO_SPECULAR_MAP
+vec3 SpecularColor() {
+#ifdef TEXTURE_ARRAYS
+    return vec3(texture(material.specularArray, vec3(TexCoords, CurrentMaterial().parameters.y)));
+#elif defined(BINDLESS_TEXTURES)
+    return vec3(texture(sampler2D(CurrentMaterial().handles.zw), TexCoords));
+#else
+    return vec3(texture(material.texture_specular0, TexCoords));
+#endif
 }
+#endif
 
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir) {
     vec3 lightDir = normalize(light.position - fragPos);
@@ -96,13 +203,9 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir) {
     // diffuse
     float diff = max(dot(normal, lightDir), 0.0);
     
-    // specular
-    vec3 reflectDir = reflect(-lightDir, normal);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-
-    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse0, TexCoords));
-    vec3 diffuse = light.diffuse * (diff * vec3(texture(material.texture_diffuse0, TexCoords)));
-    vec3 specular = light.specular * (spec * vec3(texture(material.texture_specular0, TexCoords)));
+    vec3 ambient = light.ambient * DiffuseColor();
+    vec3 diffuse = light.diffuse * (diff * DiffuseColor());
+    vec3 specular = CalcSpecular(light.specular, -lightDir, normal, viewDir);
 
     // attenuation
     float distance = length(light.position - fragPos);
@@ -114,19 +217,16 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir) {
     return ambient + diffuse + specular;
 }
 
+#ifndef NO_SPOTLIGHT
 vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir) {
     vec3 lightDir = normalize(light.position - fragPos);
     
     // diffuse
     float diff = max(dot(normal, lightDir), 0.0);
     
-    // specular
-    vec3 reflectDir = reflect(-lightDir, normal);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-
-    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse0, TexCoords));
-    vec3 diffuse = light.diffuse * (diff * vec3(texture(material.texture_diffuse0, TexCoords)));
-    vec3 specular = light.specular * (spec * vec3(texture(material.texture_specular0, TexCoords)));
+    vec3 ambient = light.ambient * DiffuseColor();
+    vec3 diffuse = light.diffuse * (diff * DiffuseColor());
+    vec3 specular = CalcSpecular(light.specular, -lightDir, normal, viewDir);
 
     // flashlight cone
     float theta = dot(lightDir, normalize(-light.direction));
@@ -143,4 +243,5 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir) {
     specular *= attenuation;
     
     return ambient + diffuse + specular;
-}
\ No newline at end of file
+}
+#endif
\ No newline at end of file
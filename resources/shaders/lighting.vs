@@ -3,6 +3,10 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+#ifdef TEXTURE_ARRAYS
+// the mesh's MaterialTable index, see MeshBatch
+layout (location = 3) in uint aMaterial;
+#endif
 
 uniform mat4 model;
 uniform mat4 view;
@@ -11,10 +15,19 @@ uniform mat4 projection;
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoords;
+#ifdef TEXTURE_ARRAYS
+flat out uint MaterialIndex;
+#endif
+
+// must match depth.vs for the GL_EQUAL shading pass after a depth prepass
+invariant gl_Position;
 
 void main() {
     gl_Position = projection * view * model * vec4(aPos, 1.0);    
     FragPos = vec3(model * vec4(aPos, 1.0));
     Normal = mat3(transpose(inverse(model))) * aNormal;
     TexCoords = aTexCoords;
+#ifdef TEXTURE_ARRAYS
+    MaterialIndex = aMaterial;
+#endif
 }
\ No newline at end of file
@@ -9,6 +9,9 @@ uniform mat4 projection;
 
 out vec2 TexCoords;
 
+// must match depth.vs for the GL_EQUAL shading pass after a depth prepass
+invariant gl_Position;
+
 void main() {
     gl_Position = projection * view * model * vec4(aPos, 1.0);
     TexCoords = aTexCoords;
@@ -0,0 +1,52 @@
+#version 330 core
+
+// Samples a virtual texture through its indirection table, see
+// VirtualTextureSystem. With VT_FEEDBACK defined, writes the page (x, y,
+// level, texture id) this fragment needs instead, for the feedback pass.
+
+in vec2 TexCoords;
+
+// physical page cache: pages of vtPageSize texels plus a vtBorder texel
+// border on every side, so bilinear filtering never reads a neighbour
+uniform sampler2D vtCache;
+// one texel per page and level: cache slot (rg) and level (b) of the
+// page actually resident, which is a coarser one while the page streams
+uniform sampler2D vtIndirection;
+uniform vec2 vtSize;
+uniform float vtMaxLevel;
+uniform float vtPageSize;
+uniform float vtBorder;
+uniform float vtCacheSize;
+uniform float vtId;
+// the feedback buffer is smaller than the screen, which makes
+// derivatives larger: the bias compensates for it
+uniform float vtLodBias;
+
+out vec4 FragColor;
+
+vec2 levelSize(float level) {
+    return max(floor(vtSize / exp2(level)), vec2(1.0));
+}
+
+ivec2 pageAt(vec2 uv, float level) {
+    vec2 pages = ceil(levelSize(level) / vtPageSize);
+    return ivec2(min(floor(uv * levelSize(level) / vtPageSize), pages - 1.0));
+}
+
+void main() {
+    // textures repeat, like GL_REPEAT on the regular ones
+    vec2 uv = fract(TexCoords);
+    vec2 texel = TexCoords * vtSize;
+    float lod = 0.5 * log2(max(dot(dFdx(texel), dFdx(texel)), dot(dFdy(texel), dFdy(texel))));
+    float level = floor(clamp(lod + vtLodBias, 0.0, vtMaxLevel));
+
+#ifdef VT_FEEDBACK
+    FragColor = vec4(vec2(pageAt(uv, level)), level, vtId) / 255.0;
+#else
+    vec3 entry = round(texelFetch(vtIndirection, pageAt(uv, level), int(level)).rgb * 255.0);
+    float resident = entry.b;
+    vec2 inPage = uv * levelSize(resident) - vec2(pageAt(uv, resident)) * vtPageSize;
+    vec2 cacheTexel = entry.rg * (vtPageSize + 2.0 * vtBorder) + vtBorder + inPage;
+    FragColor = textureLod(vtCache, cacheTexel / vtCacheSize, 0.0);
+#endif
+}
\ No newline at end of file
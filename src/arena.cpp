@@ -0,0 +1,95 @@
+#include "arena.hpp"
+
+#include <cstdint>
+
+Arena::Arena(size_t inBlockSize) : blockSize(inBlockSize), current(0), offset(0) {
+}
+
+Arena::~Arena() {
+    for (size_t i = 0 ; i < blocks.size() ; i++) {
+        delete[] blocks[i].data;
+    }
+}
+
+void* Arena::allocate(size_t size, size_t alignment) {
+    if (blocks.empty())
+        blocks.push_back(newBlock(blockSize > size + alignment ? blockSize : size + alignment));
+
+    while (true) {
+        Block &block = blocks[current];
+        uintptr_t address = (uintptr_t) (block.data + offset);
+        size_t padding = (alignment - address % alignment) % alignment;
+        if (offset + padding + size <= block.size) {
+            void* result = block.data + offset + padding;
+            offset += padding + size;
+            return result;
+        }
+
+        // blocks after the current one are free since the last rewind.
+        // otherwise one is added, large enough for the allocation
+        if (current + 1 == blocks.size())
+            blocks.push_back(newBlock(blockSize > size + alignment ? blockSize : size + alignment));
+        current++;
+        offset = 0;
+    }
+}
+
+Arena::Marker Arena::mark() const {
+    Marker marker;
+    marker.block = current;
+    marker.offset = offset;
+    return marker;
+}
+
+void Arena::rewind(const Marker &marker) {
+    current = marker.block;
+    offset = marker.offset;
+}
+
+void Arena::reset() {
+    current = 0;
+    offset = 0;
+    if (blocks.size() <= 1)
+        return;
+
+    size_t total = capacity();
+    for (size_t i = 0 ; i < blocks.size() ; i++) {
+        delete[] blocks[i].data;
+    }
+    blocks.clear();
+    blocks.push_back(newBlock(total));
+}
+
+size_t Arena::capacity() const {
+    size_t total = 0;
+    for (size_t i = 0 ; i < blocks.size() ; i++) {
+        total += blocks[i].size;
+    }
+    return total;
+}
+
+Arena::Block Arena::newBlock(size_t size) {
+    Block block;
+    block.data = new unsigned char[size];
+    block.size = size;
+    return block;
+}
+
+FrameArena &FrameArena::instance() {
+    static FrameArena frameArena;
+    return frameArena;
+}
+
+void FrameArena::beginFrame() {
+    index ^= 1;
+    arenas[index].reset();
+}
+
+Arena &FrameArena::current() {
+    return arenas[index];
+}
+
+Arena &loadArena() {
+    static thread_local Arena arena(1u << 20);
+    return arena;
+}
\ No newline at end of file
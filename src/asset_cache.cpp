@@ -0,0 +1,165 @@
+#include "asset_cache.hpp"
+
+#include "fileutil.hpp"
+
+// pages are faulted in by reading one byte of each
+static const size_t pageSize = 4096;
+
+// keeps the page touching loop from being optimized away
+static volatile unsigned char touchedBytes;
+
+AssetCache &AssetCache::instance() {
+    static AssetCache cache;
+    return cache;
+}
+
+AssetCache::~AssetCache() {
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        stopping = true;
+    }
+    queued.notify_all();
+    if (worker.joinable())
+        worker.join();
+}
+
+std::shared_ptr<const AssetFile> AssetCache::open(const char* path) {
+    std::string key = normalizePath(path);
+    long long modified = fileModifiedTime(path);
+    std::unique_lock<std::mutex> lock(mutex);
+    std::unordered_map<std::string, Entry>::iterator found;
+    while ((found = entries.find(key)) != entries.end() && found->second.loading) {
+        loaded.wait(lock);
+    }
+    if (found != entries.end() && found->second.modified == modified) {
+        found->second.lastUse = ++uses;
+        return found->second.file;
+    }
+    // changed on disk since, holders keep the old contents
+    if (found != entries.end()) {
+        cached -= found->second.file->size();
+        entries.erase(found);
+    }
+
+    Entry &entry = entries[key];
+    entry.loading = true;
+    entry.lastUse = ++uses;
+    entry.modified = modified;
+    return load(key, path, false, lock);
+}
+
+bool AssetCache::contains(const char* path) {
+    std::string key = normalizePath(path);
+    std::lock_guard<std::mutex> guard(mutex);
+    return entries.find(key) != entries.end();
+}
+
+void AssetCache::prefetch(const char* path) {
+    std::string key = normalizePath(path);
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        if (!worker.joinable())
+            worker = std::thread(&AssetCache::prefetchLoop, this);
+        queue.push_back(path);
+        std::unordered_map<std::string, std::vector<std::string>>::iterator recorded = dependencies.find(key);
+        if (recorded != dependencies.end())
+            queue.insert(queue.end(), recorded->second.begin(), recorded->second.end());
+    }
+    queued.notify_one();
+}
+
+void AssetCache::setDependencies(const char* path, const std::vector<std::string> &files) {
+    std::string key = normalizePath(path);
+    std::lock_guard<std::mutex> guard(mutex);
+    dependencies[key] = files;
+}
+
+void AssetCache::setBudget(size_t bytes) {
+    std::lock_guard<std::mutex> guard(mutex);
+    budget = bytes;
+    trim();
+}
+
+void AssetCache::clear() {
+    std::lock_guard<std::mutex> guard(mutex);
+    for (std::unordered_map<std::string, Entry>::iterator i = entries.begin() ; i != entries.end() ; ) {
+        if (!i->second.loading && i->second.file.use_count() == 1) {
+            cached -= i->second.file->size();
+            i = entries.erase(i);
+        } else {
+            ++i;
+        }
+    }
+}
+
+void AssetCache::prefetchLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        while (queue.empty() && !stopping) {
+            queued.wait(lock);
+        }
+        if (stopping)
+            return;
+        std::string path = queue.front();
+        queue.pop_front();
+
+        // stale entries are left to open, which checks them anyway
+        std::string key = normalizePath(path.c_str());
+        if (entries.find(key) != entries.end())
+            continue;
+        lock.unlock();
+        long long modified = fileModifiedTime(path.c_str());
+        lock.lock();
+        if (entries.find(key) != entries.end())
+            continue;
+        Entry &entry = entries[key];
+        entry.loading = true;
+        entry.lastUse = ++uses;
+        entry.modified = modified;
+        load(key, path.c_str(), true, lock);
+    }
+}
+
+std::shared_ptr<AssetFile> AssetCache::load(const std::string &key, const char* path, bool touch,
+        std::unique_lock<std::mutex> &lock) {
+    lock.unlock();
+    std::shared_ptr<AssetFile> file(new AssetFile());
+    bool opened = file->open(path);
+    if (opened && touch) {
+        unsigned char sum = 0;
+        for (size_t i = 0 ; i < file->size() ; i += pageSize) {
+            sum = (unsigned char) (sum ^ file->data()[i]);
+        }
+        touchedBytes = sum;
+    }
+    lock.lock();
+
+    // failures aren't cached, a later open tries again
+    if (opened) {
+        Entry &entry = entries[key];
+        entry.file = file;
+        entry.loading = false;
+        cached += file->size();
+        trim();
+    } else {
+        entries.erase(key);
+        file.reset();
+    }
+    loaded.notify_all();
+    return file;
+}
+
+void AssetCache::trim() {
+    while (cached > budget) {
+        std::unordered_map<std::string, Entry>::iterator victim = entries.end();
+        for (std::unordered_map<std::string, Entry>::iterator i = entries.begin() ; i != entries.end() ; ++i) {
+            if (!i->second.loading && i->second.file.use_count() == 1
+                && (victim == entries.end() || i->second.lastUse < victim->second.lastUse))
+                victim = i;
+        }
+        if (victim == entries.end())
+            break;
+        cached -= victim->second.file->size();
+        entries.erase(victim);
+    }
+}
\ No newline at end of file
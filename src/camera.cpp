@@ -28,10 +28,9 @@ glm::mat4 Camera::GetViewMatrix() {
 }
 
 void Camera::ProcessKeyboard(CameraMovement direction, float deltaTime) {
-    // deltaTime is calculated at main() and stores the time
-    // the last frame took to process. if the hardware
-    // processes less frames per second, every frame will move
-    // the camera more each frame (and vice-versa).
+    // deltaTime is the length of the step being simulated. with a
+    // fixed timestep (see Simulation) every step moves the camera
+    // the same distance, however fast frames are rendered.
     float velocity = movementSpeed * deltaTime;
 
     // uses camera vectors to move in the desired directions.
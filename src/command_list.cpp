@@ -0,0 +1,138 @@
+#include "command_list.hpp"
+
+#include <algorithm>
+
+#include "glad/glad.h"
+
+#include "job_system.hpp"
+#include "mesh.hpp"
+#include "parallel.hpp"
+#include "shader.hpp"
+
+// ranges per thread, so that threads finishing early steal the rest
+static const unsigned int rangesPerThread = 4;
+// no GL object has this name, so the first command binds its own
+static const unsigned int unknownBinding = ~0u;
+
+DrawCommand::DrawCommand()
+        : pipeline(NULL), mesh(NULL), vertexArray(0), texture(0), first(0), count(0), stencilMask(0x00), uniformOffset(0) {
+}
+
+void CommandList::clear() {
+    commands.clear();
+    uniforms.clear();
+}
+
+void CommandList::draw(const DrawCommand &command, const glm::mat4 &model) {
+    commands.push_back(command);
+    commands.back().uniformOffset = (uint32_t) uniforms.size();
+    uniforms.push_back(model);
+}
+
+size_t CommandList::size() const {
+    return commands.size();
+}
+
+void CommandRecorder::clear() {
+    for (unsigned int i = 0 ; i < used ; i++) {
+        lists[i]->clear();
+    }
+    used = 0;
+}
+
+void CommandRecorder::record(unsigned int count, unsigned int grain, const std::function<void(CommandList&, unsigned int, unsigned int)> &body) {
+    if (count == 0)
+        return;
+    grain = std::max(grain, 1u);
+    unsigned int ranges = std::max(std::min(workerCount() * rangesPerThread, (count + grain - 1) / grain), 1u);
+
+    // the lists are created here, before any job can refer to them
+    unsigned int firstList = used;
+    used += ranges;
+    while (lists.size() < used) {
+        lists.push_back(std::unique_ptr<CommandList>(new CommandList()));
+    }
+
+    // the first count % ranges ranges take one extra item. jobs capture
+    // only the split and their range, small enough for std::function to
+    // store without allocating
+    struct Split {
+        const std::function<void(CommandList&, unsigned int, unsigned int)>* body;
+        const std::unique_ptr<CommandList>* lists;
+        unsigned int size;
+        unsigned int extra;
+
+        void operator()(unsigned int range) const {
+            unsigned int begin = range * size + std::min(range, extra);
+            unsigned int end = begin + size + (range < extra ? 1 : 0);
+            (*body)(*lists[range], begin, end);
+        }
+    };
+    Split split = { &body, &lists[firstList], count / ranges, count % ranges };
+    JobSystem &jobs = JobSystem::instance();
+    JobCounter counter;
+    for (unsigned int i = 1 ; i < ranges ; i++) {
+        jobs.run([&split, i]() { split(i); }, &counter);
+    }
+    split(0);
+    jobs.wait(counter);
+}
+
+void CommandRecorder::replay() {
+    Shader* pipeline = NULL;
+    unsigned int vertexArray = unknownBinding;
+    unsigned int texture = unknownBinding;
+    unsigned int stencilMask = unknownBinding;
+    // texture binds go to unit 0, which meshes (and whatever ran before
+    // the replay) may have left inactive
+    unsigned int activeUnit = unknownBinding;
+
+    for (unsigned int i = 0 ; i < used ; i++) {
+        const CommandList &list = *lists[i];
+        for (size_t j = 0 ; j < list.commands.size() ; j++) {
+            const DrawCommand &command = list.commands[j];
+            if (command.pipeline != pipeline) {
+                pipeline = command.pipeline;
+                pipeline->use();
+            }
+            if (command.stencilMask != stencilMask) {
+                stencilMask = command.stencilMask;
+                glStencilMask(stencilMask);
+            }
+            pipeline->setMat4("model", list.uniforms[command.uniformOffset]);
+
+            if (command.mesh != NULL) {
+                // binds its own textures on units of its choice and
+                // unbinds its VAO
+                command.mesh->Draw(*pipeline);
+                vertexArray = 0;
+                texture = unknownBinding;
+                activeUnit = unknownBinding;
+                continue;
+            }
+
+            if (command.texture != texture) {
+                if (activeUnit != 0) {
+                    activeUnit = 0;
+                    glActiveTexture(GL_TEXTURE0);
+                }
+                texture = command.texture;
+                glBindTexture(GL_TEXTURE_2D, texture);
+            }
+            if (command.vertexArray != vertexArray) {
+                vertexArray = command.vertexArray;
+                glBindVertexArray(vertexArray);
+            }
+            glDrawArrays(GL_TRIANGLES, command.first, command.count);
+        }
+    }
+    glBindVertexArray(0);
+}
+
+size_t CommandRecorder::size() const {
+    size_t total = 0;
+    for (unsigned int i = 0 ; i < used ; i++) {
+        total += lists[i]->size();
+    }
+    return total;
+}
\ No newline at end of file
@@ -0,0 +1,104 @@
+#include "cooked_assets.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+
+#include "fileutil.hpp"
+#include "pak.hpp"
+
+bool readManifest(const char* path, std::vector<ManifestEntry> &entries, unsigned int* version) {
+    AssetFile file;
+    if (!file.open(path))
+        return false;
+    if (version != NULL)
+        *version = 0;
+
+    std::istringstream stream(std::string((const char*) file.data(), file.size()));
+    std::string line;
+    while (std::getline(stream, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        std::vector<std::string> fields;
+        size_t start = 0;
+        size_t tab;
+        while ((tab = line.find('\t', start)) != std::string::npos) {
+            fields.push_back(line.substr(start, tab - start));
+            start = tab + 1;
+        }
+        fields.push_back(line.substr(start));
+        if (fields.size() == 2 && fields[0] == "version") {
+            if (version != NULL)
+                *version = (unsigned int) std::strtoul(fields[1].c_str(), NULL, 10);
+            continue;
+        }
+        // kind, output, then at least one dependency and its time
+        if (fields.size() < 4 || fields.size() % 2 != 0)
+            continue;
+
+        ManifestEntry entry;
+        entry.kind = fields[0];
+        entry.output = fields[1];
+        for (unsigned int i = 2 ; i < fields.size() ; i += 2) {
+            entry.dependencies.push_back(std::make_pair(fields[i], std::strtoll(fields[i + 1].c_str(), NULL, 10)));
+        }
+        entries.push_back(entry);
+    }
+    return true;
+}
+
+bool writeManifest(const char* path, const std::vector<ManifestEntry> &entries, unsigned int version) {
+    std::ostringstream stream;
+    stream << "# cooked assets, written by tools/cook\n";
+    stream << "# kind, output, then each file it was cooked from and its modification time\n";
+    stream << "version\t" << version << '\n';
+    for (unsigned int i = 0 ; i < entries.size() ; i++) {
+        stream << entries[i].kind << '\t' << entries[i].output;
+        for (unsigned int j = 0 ; j < entries[i].dependencies.size() ; j++) {
+            stream << '\t' << entries[i].dependencies[j].first << '\t' << entries[i].dependencies[j].second;
+        }
+        stream << '\n';
+    }
+    std::string text = stream.str();
+    return writeFileBytes(path, text.data(), text.size());
+}
+
+CookedAssets &CookedAssets::instance() {
+    static CookedAssets cooked;
+    return cooked;
+}
+
+bool CookedAssets::open(const std::string &cookedDirectory) {
+    directory = cookedDirectory;
+    assets.clear();
+
+    std::vector<ManifestEntry> entries;
+    if (!readManifest((directory + "/manifest.txt").c_str(), entries))
+        return false;
+    for (unsigned int i = 0 ; i < entries.size() ; i++) {
+        Asset asset;
+        asset.output = entries[i].output;
+        asset.dependencies = entries[i].dependencies;
+        assets[canonicalPath(entries[i].dependencies[0].first.c_str())] = asset;
+    }
+    return true;
+}
+
+std::string CookedAssets::find(const char* sourcePath) const {
+    if (assets.empty())
+        return std::string();
+
+    std::unordered_map<std::string, Asset>::const_iterator found = assets.find(canonicalPath(sourcePath));
+    if (found == assets.end())
+        return std::string();
+    // a source edited after cooking loads from the source until recooked.
+    // sources that aren't on disk at all shipped only cooked, in a pak
+    const Asset &asset = found->second;
+    for (unsigned int i = 0 ; i < asset.dependencies.size() ; i++) {
+        long long modified = fileModifiedTime(asset.dependencies[i].first.c_str());
+        if (modified != -1 && modified != asset.dependencies[i].second)
+            return std::string();
+    }
+    return directory + "/" + asset.output;
+}
\ No newline at end of file
@@ -0,0 +1,221 @@
+#include "dds.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "fileutil.hpp"
+#include "pak.hpp"
+
+struct DDSPixelFormat {
+    uint32_t size;
+    uint32_t flags;
+    uint32_t fourCC;
+    uint32_t rgbBitCount;
+    uint32_t redMask;
+    uint32_t greenMask;
+    uint32_t blueMask;
+    uint32_t alphaMask;
+};
+
+struct DDSHeader {
+    uint32_t size;
+    uint32_t flags;
+    uint32_t height;
+    uint32_t width;
+    uint32_t pitchOrLinearSize;
+    uint32_t depth;
+    uint32_t mipMapCount;
+    uint32_t reserved1[11];
+    DDSPixelFormat pixelFormat;
+    uint32_t caps;
+    uint32_t caps2;
+    uint32_t caps3;
+    uint32_t caps4;
+    uint32_t reserved2;
+};
+
+struct DDSHeaderDX10 {
+    uint32_t dxgiFormat;
+    uint32_t resourceDimension;
+    uint32_t miscFlag;
+    uint32_t arraySize;
+    uint32_t miscFlags2;
+};
+
+static const uint32_t ddsMagic = 0x20534444; // "DDS "
+static const uint32_t flagCaps = 0x1;
+static const uint32_t flagHeight = 0x2;
+static const uint32_t flagWidth = 0x4;
+static const uint32_t flagPixelFormat = 0x1000;
+static const uint32_t flagMipMapCount = 0x20000;
+static const uint32_t flagLinearSize = 0x80000;
+static const uint32_t pixelFormatFourCC = 0x4;
+static const uint32_t capsComplex = 0x8;
+static const uint32_t capsTexture = 0x1000;
+static const uint32_t capsMipMap = 0x400000;
+static const uint32_t dxgiBC1 = 71;
+static const uint32_t dxgiBC1sRGB = 72;
+static const uint32_t dxgiBC3 = 77;
+static const uint32_t dxgiBC3sRGB = 78;
+static const uint32_t dxgiBC4 = 80;
+static const uint32_t dxgiBC5 = 83;
+static const uint32_t dxgiBC7 = 98;
+static const uint32_t dxgiBC7sRGB = 99;
+static const uint32_t dimensionTexture2D = 3;
+
+static uint32_t fourCC(char a, char b, char c, char d);
+static bool formatFromFourCC(uint32_t code, TextureFormat &format);
+static bool formatFromDXGI(uint32_t dxgiFormat, TextureFormat &format);
+
+bool loadDDS(const char* path, TextureData &texture) {
+    AssetFile file;
+    if (!file.open(path) || file.size() < 4 + sizeof(DDSHeader))
+        return false;
+    const unsigned char* bytes = file.data();
+
+    uint32_t magic;
+    DDSHeader header;
+    std::memcpy(&magic, &bytes[0], 4);
+    std::memcpy(&header, &bytes[4], sizeof(header));
+    if (magic != ddsMagic || header.size != sizeof(DDSHeader) || !(header.pixelFormat.flags & pixelFormatFourCC)) {
+        printf("DDS load failed, unsupported header\nPath: %s\n", path);
+        return false;
+    }
+
+    size_t offset = 4 + sizeof(DDSHeader);
+    bool supported;
+    if (header.pixelFormat.fourCC == fourCC('D', 'X', '1', '0')) {
+        DDSHeaderDX10 header10;
+        if (file.size() < offset + sizeof(header10))
+            return false;
+        std::memcpy(&header10, &bytes[offset], sizeof(header10));
+        offset += sizeof(header10);
+        supported = header10.resourceDimension == dimensionTexture2D && header10.arraySize <= 1
+            && formatFromDXGI(header10.dxgiFormat, texture.format);
+    } else {
+        supported = formatFromFourCC(header.pixelFormat.fourCC, texture.format);
+    }
+    if (!supported) {
+        printf("DDS load failed, unsupported format\nPath: %s\n", path);
+        return false;
+    }
+
+    unsigned int levels = (header.flags & flagMipMapCount) && header.mipMapCount > 0 ? header.mipMapCount : 1;
+    unsigned int width = header.width;
+    unsigned int height = header.height;
+    texture.levels.clear();
+    for (unsigned int level = 0 ; level < levels ; level++) {
+        size_t size = levelSize(texture.format, width, height);
+        if (file.size() < offset + size) {
+            printf("DDS load failed, file truncated\nPath: %s\n", path);
+            return false;
+        }
+
+        TextureLevel textureLevel;
+        textureLevel.width = width;
+        textureLevel.height = height;
+        textureLevel.data.assign(bytes + offset, bytes + offset + size);
+        texture.levels.push_back(textureLevel);
+
+        offset += size;
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+    return true;
+}
+
+bool saveDDS(const char* path, const TextureData &texture) {
+    if (texture.levels.empty())
+        return false;
+
+    DDSHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.size = sizeof(DDSHeader);
+    header.flags = flagCaps | flagHeight | flagWidth | flagPixelFormat | flagMipMapCount | flagLinearSize;
+    header.width = texture.levels[0].width;
+    header.height = texture.levels[0].height;
+    header.pitchOrLinearSize = (uint32_t) texture.levels[0].data.size();
+    header.depth = 1;
+    header.mipMapCount = (uint32_t) texture.levels.size();
+    header.pixelFormat.size = sizeof(DDSPixelFormat);
+    header.pixelFormat.flags = pixelFormatFourCC;
+    header.caps = capsTexture | (texture.levels.size() > 1 ? capsComplex | capsMipMap : 0);
+
+    DDSHeaderDX10 header10;
+    std::memset(&header10, 0, sizeof(header10));
+    bool extended = false;
+    switch (texture.format) {
+        case TextureFormat::BC1:
+            header.pixelFormat.fourCC = fourCC('D', 'X', 'T', '1');
+            break;
+        case TextureFormat::BC3:
+            header.pixelFormat.fourCC = fourCC('D', 'X', 'T', '5');
+            break;
+        case TextureFormat::BC4:
+            header.pixelFormat.fourCC = fourCC('A', 'T', 'I', '1');
+            break;
+        case TextureFormat::BC5:
+            header.pixelFormat.fourCC = fourCC('A', 'T', 'I', '2');
+            break;
+        case TextureFormat::BC7:
+            header.pixelFormat.fourCC = fourCC('D', 'X', '1', '0');
+            header10.dxgiFormat = dxgiBC7;
+            header10.resourceDimension = dimensionTexture2D;
+            header10.arraySize = 1;
+            extended = true;
+            break;
+        default:
+            printf("DDS save failed, unsupported format\nPath: %s\n", path);
+            return false;
+    }
+
+    std::vector<unsigned char> bytes;
+    bytes.resize(4 + sizeof(header) + (extended ? sizeof(header10) : 0));
+    std::memcpy(&bytes[0], &ddsMagic, 4);
+    std::memcpy(&bytes[4], &header, sizeof(header));
+    if (extended)
+        std::memcpy(&bytes[4 + sizeof(header)], &header10, sizeof(header10));
+    for (unsigned int i = 0 ; i < texture.levels.size() ; i++) {
+        bytes.insert(bytes.end(), texture.levels[i].data.begin(), texture.levels[i].data.end());
+    }
+
+    return writeFileBytes(path, &bytes[0], bytes.size());
+}
+
+static uint32_t fourCC(char a, char b, char c, char d) {
+    return (uint32_t) (unsigned char) a | ((uint32_t) (unsigned char) b << 8)
+        | ((uint32_t) (unsigned char) c << 16) | ((uint32_t) (unsigned char) d << 24);
+}
+
+static bool formatFromFourCC(uint32_t code, TextureFormat &format) {
+    if (code == fourCC('D', 'X', 'T', '1'))
+        format = TextureFormat::BC1;
+    else if (code == fourCC('D', 'X', 'T', '5'))
+        format = TextureFormat::BC3;
+    else if (code == fourCC('A', 'T', 'I', '1') || code == fourCC('B', 'C', '4', 'U'))
+        format = TextureFormat::BC4;
+    else if (code == fourCC('A', 'T', 'I', '2') || code == fourCC('B', 'C', '5', 'U'))
+        format = TextureFormat::BC5;
+    else
+        return false;
+    return true;
+}
+
+static bool formatFromDXGI(uint32_t dxgiFormat, TextureFormat &format) {
+    // sRGB variants are loaded as linear, like every other texture here
+    if (dxgiFormat == dxgiBC1 || dxgiFormat == dxgiBC1sRGB)
+        format = TextureFormat::BC1;
+    else if (dxgiFormat == dxgiBC3 || dxgiFormat == dxgiBC3sRGB)
+        format = TextureFormat::BC3;
+    else if (dxgiFormat == dxgiBC4)
+        format = TextureFormat::BC4;
+    else if (dxgiFormat == dxgiBC5)
+        format = TextureFormat::BC5;
+    else if (dxgiFormat == dxgiBC7 || dxgiFormat == dxgiBC7sRGB)
+        format = TextureFormat::BC7;
+    else
+        return false;
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,124 @@
+#include "depth_prepass.hpp"
+
+#include "glad/glad.h"
+
+DepthPrepass::DepthPrepass(Mode inMode)
+        : mode(inMode), frameIndex(0), framesSinceProbe(0), prepassActive(false), autoEnabled(false), visibleSamples(0.0), smoothedOverdraw(1.0f) {
+    for (unsigned int i = 0 ; i < queryFrames ; i++) {
+        glGenQueries(1, &frames[i].depthQuery);
+        glGenQueries(1, &frames[i].shadingQuery);
+        frames[i].pending = false;
+        frames[i].hadPrepass = false;
+    }
+}
+
+DepthPrepass::~DepthPrepass() {
+    for (unsigned int i = 0 ; i < queryFrames ; i++) {
+        glDeleteQueries(1, &frames[i].depthQuery);
+        glDeleteQueries(1, &frames[i].shadingQuery);
+    }
+}
+
+void DepthPrepass::beginFrame() {
+    // the slot we are about to reuse holds the queries issued queryFrames
+    // frames ago, which should be available by now
+    frameIndex = (frameIndex + 1) % queryFrames;
+    FrameQueries &frame = frames[frameIndex];
+    if (frame.pending)
+        collect(frame);
+
+    if (mode == Mode::ON) {
+        prepassActive = true;
+    } else if (mode == Mode::OFF) {
+        prepassActive = false;
+    } else {
+        // without a visible sample count there is nothing to compare the
+        // shaded fragments against, so probe as soon as possible
+        bool probe = visibleSamples <= 0.0 || framesSinceProbe >= probeInterval;
+        prepassActive = autoEnabled || probe;
+        framesSinceProbe = prepassActive ? 0 : framesSinceProbe + 1;
+    }
+
+    frame.hadPrepass = prepassActive;
+}
+
+bool DepthPrepass::enabled() const {
+    return prepassActive;
+}
+
+void DepthPrepass::beginDepthPass() {
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    // the prepass must not touch the stencil buffer, the shading pass
+    // writes it exactly as it would without a prepass
+    glStencilMask(0x00);
+    glDepthMask(GL_TRUE);
+    glDepthFunc(GL_LESS);
+
+    // in the prepass, samples passed are all the fragments that would have
+    // been shaded without it (for the same draw order)
+    glBeginQuery(GL_SAMPLES_PASSED, frames[frameIndex].depthQuery);
+}
+
+void DepthPrepass::beginShadingPass() {
+    if (prepassActive) {
+        glEndQuery(GL_SAMPLES_PASSED);
+
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        // only the nearest fragment of each pixel matches the depth buffer
+        // filled by the prepass, which is already final, so stop writing it
+        glDepthFunc(GL_EQUAL);
+        glDepthMask(GL_FALSE);
+    }
+
+    // with a prepass, samples passed are the visible fragments. without
+    // it, they are all the fragments shaded this frame
+    glBeginQuery(GL_SAMPLES_PASSED, frames[frameIndex].shadingQuery);
+}
+
+void DepthPrepass::endShadingPass() {
+    glEndQuery(GL_SAMPLES_PASSED);
+    frames[frameIndex].pending = true;
+
+    glDepthFunc(GL_LESS);
+    glDepthMask(GL_TRUE);
+}
+
+float DepthPrepass::overdraw() const {
+    return smoothedOverdraw;
+}
+
+void DepthPrepass::collect(FrameQueries &frame) {
+    frame.pending = false;
+
+    // never wait for a result. if the GPU is running further behind than
+    // expected, this sample is dropped instead
+    GLint available = 0;
+    glGetQueryObjectiv(frame.shadingQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+        return;
+
+    GLuint64 shadingSamples = 0;
+    glGetQueryObjectui64v(frame.shadingQuery, GL_QUERY_RESULT, &shadingSamples);
+
+    if (frame.hadPrepass) {
+        // the depth query ended before the shading query, so it is available
+        GLuint64 depthSamples = 0;
+        glGetQueryObjectui64v(frame.depthQuery, GL_QUERY_RESULT, &depthSamples);
+        if (shadingSamples == 0)
+            return;
+        visibleSamples = (double) shadingSamples;
+        record((double) depthSamples / visibleSamples);
+    } else if (visibleSamples > 0.0) {
+        record((double) shadingSamples / visibleSamples);
+    }
+}
+
+void DepthPrepass::record(double overdrawSample) {
+    // exponential moving average, so a single odd frame does not flip the mode
+    smoothedOverdraw += ((float) overdrawSample - smoothedOverdraw) * 0.25f;
+
+    if (!autoEnabled && smoothedOverdraw > enableThreshold)
+        autoEnabled = true;
+    else if (autoEnabled && smoothedOverdraw < disableThreshold)
+        autoEnabled = false;
+}
\ No newline at end of file
@@ -0,0 +1,111 @@
+#include "file_watcher.hpp"
+
+#include <cstdio>
+
+#ifdef __linux__
+#include <cerrno>
+#include <sys/inotify.h>
+#include <unistd.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef __linux__
+
+FileWatcher::FileWatcher(const char* inDirectory) : directory(inDirectory) {
+    inotifyDescriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyDescriptor < 0) {
+        printf("File watcher initialization failed\nPath: %s\n", inDirectory);
+        return;
+    }
+    // editors either write the file in place (close after write) or write
+    // a temporary file and rename it over the original (moved to)
+    if (inotify_add_watch(inotifyDescriptor, inDirectory, IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+        printf("File watcher initialization failed\nPath: %s\n", inDirectory);
+}
+
+FileWatcher::~FileWatcher() {
+    if (inotifyDescriptor >= 0)
+        close(inotifyDescriptor);
+}
+
+std::vector<std::string> FileWatcher::poll() {
+    std::vector<std::string> changed;
+    if (inotifyDescriptor < 0)
+        return changed;
+
+    // events are variable sized (the name follows the header), aligned
+    // like the event struct
+    alignas(struct inotify_event) char buffer[4096];
+    while (true) {
+        ssize_t length = read(inotifyDescriptor, buffer, sizeof(buffer));
+        if (length <= 0)
+            break;
+
+        for (ssize_t offset = 0 ; offset < length ; ) {
+            const struct inotify_event* event = (const struct inotify_event*) (buffer + offset);
+            if (event->len > 0) {
+                std::string path = directory + '/' + event->name;
+                bool duplicate = false;
+                for (unsigned int i = 0 ; i < changed.size() ; i++) {
+                    duplicate = duplicate || changed[i] == path;
+                }
+                if (!duplicate)
+                    changed.push_back(path);
+            }
+            offset += (ssize_t) (sizeof(struct inotify_event) + event->len);
+        }
+    }
+    return changed;
+}
+
+#else
+
+FileWatcher::FileWatcher(const char* inDirectory) : directory(inDirectory), lastScan(std::chrono::steady_clock::now()) {
+    // the first scan only records the current modification times
+    scan(NULL);
+}
+
+FileWatcher::~FileWatcher() {
+}
+
+std::vector<std::string> FileWatcher::poll() {
+    std::vector<std::string> changed;
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (std::chrono::duration<double>(now - lastScan).count() < scanInterval)
+        return changed;
+
+    lastScan = now;
+    scan(&changed);
+    return changed;
+}
+
+void FileWatcher::scan(std::vector<std::string>* changed) {
+    DIR* dir = opendir(directory.c_str());
+    if (dir == NULL)
+        return;
+
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        scanPath.assign(directory);
+        scanPath += '/';
+        scanPath += entry->d_name;
+        struct stat info;
+        if (stat(scanPath.c_str(), &info) != 0 || !S_ISREG(info.st_mode))
+            continue;
+
+        std::map<std::string, time_t>::iterator found = modifiedTimes.find(scanPath);
+        if (found != modifiedTimes.end() && found->second == info.st_mtime)
+            continue;
+        if (changed != NULL)
+            changed->push_back(scanPath);
+        if (found == modifiedTimes.end())
+            modifiedTimes.insert(std::make_pair(scanPath, info.st_mtime));
+        else
+            found->second = info.st_mtime;
+    }
+    closedir(dir);
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,244 @@
+#include "fileutil.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+
+#include <dirent.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+bool readFileBytes(const char* path, std::vector<unsigned char> &bytes) {
+    FILE* file = std::fopen(path, "rb");
+    if (file == NULL)
+        return false;
+
+    std::fseek(file, 0, SEEK_END);
+    long size = std::ftell(file);
+    std::fseek(file, 0, SEEK_SET);
+    if (size < 0) {
+        std::fclose(file);
+        return false;
+    }
+
+    bytes.resize((size_t) size);
+    size_t read = size > 0 ? std::fread(&bytes[0], 1, (size_t) size, file) : 0;
+    std::fclose(file);
+    return read == (size_t) size;
+}
+
+bool writeFileBytes(const char* path, const void* data, size_t size) {
+    std::string temporaryPath = std::string(path) + ".tmp";
+    FILE* file = std::fopen(temporaryPath.c_str(), "wb");
+    if (file == NULL)
+        return false;
+
+    size_t written = std::fwrite(data, 1, size, file);
+    bool success = std::fclose(file) == 0 && written == size;
+    if (!success) {
+        std::remove(temporaryPath.c_str());
+        return false;
+    }
+
+#ifdef _WIN32
+    // rename does not replace existing files on windows
+    std::remove(path);
+#endif
+    return std::rename(temporaryPath.c_str(), path) == 0;
+}
+
+bool makeDirectories(const std::string &path) {
+    for (size_t i = 1 ; i <= path.size() ; i++) {
+        if (i != path.size() && path[i] != '/' && path[i] != '\\')
+            continue;
+
+        std::string parent = path.substr(0, i);
+#ifdef _WIN32
+        int result = _mkdir(parent.c_str());
+#else
+        int result = mkdir(parent.c_str(), 0755);
+#endif
+        if (result != 0 && errno != EEXIST)
+            return false;
+    }
+    return true;
+}
+
+bool fileExists(const char* path) {
+    struct stat info;
+    return stat(path, &info) == 0;
+}
+
+bool listFiles(const std::string &directory, std::vector<std::string> &files) {
+    DIR* handle = opendir(directory.c_str());
+    if (handle == NULL)
+        return false;
+
+    std::vector<std::string> names;
+    struct dirent* entry;
+    while ((entry = readdir(handle)) != NULL) {
+        std::string name = entry->d_name;
+        if (name != "." && name != "..")
+            names.push_back(name);
+    }
+    closedir(handle);
+
+    // readdir order is arbitrary, sorting keeps results stable across runs
+    std::sort(names.begin(), names.end());
+    for (unsigned int i = 0 ; i < names.size() ; i++) {
+        std::string path = directory + '/' + names[i];
+        struct stat info;
+        if (stat(path.c_str(), &info) != 0)
+            continue;
+        if (S_ISDIR(info.st_mode))
+            listFiles(path, files);
+        else
+            files.push_back(path);
+    }
+    return true;
+}
+
+long long fileModifiedTime(const char* path) {
+    struct stat info;
+    if (stat(path, &info) != 0)
+        return -1;
+    return (long long) info.st_mtime;
+}
+
+std::string canonicalPath(const char* path) {
+#ifdef _WIN32
+    char resolved[_MAX_PATH];
+    if (_fullpath(resolved, path, _MAX_PATH) == NULL || !fileExists(resolved))
+        return path;
+    std::string result = resolved;
+    for (size_t i = 0 ; i < result.size() ; i++) {
+        result[i] = result[i] == '\\' ? '/' : (char) std::tolower((unsigned char) result[i]);
+    }
+    return result;
+#else
+    char resolved[PATH_MAX];
+    if (realpath(path, resolved) == NULL)
+        return path;
+    return resolved;
+#endif
+}
+
+std::string normalizePath(const char* path) {
+    std::vector<std::string> components;
+    std::string component;
+    for (const char* c = path ; ; c++) {
+        if (*c != '/' && *c != '\\' && *c != '\0') {
+#ifdef _WIN32
+            component += (char) (*c >= 'A' && *c <= 'Z' ? *c - 'A' + 'a' : *c);
+#else
+            component += *c;
+#endif
+            continue;
+        }
+        if (component == ".." && !components.empty() && components.back() != "..")
+            components.pop_back();
+        else if (!component.empty() && component != ".")
+            components.push_back(component);
+        component.clear();
+        if (*c == '\0')
+            break;
+    }
+
+    std::string normalized = path[0] == '/' ? "/" : "";
+    for (unsigned int i = 0 ; i < components.size() ; i++) {
+        if (i > 0)
+            normalized += '/';
+        normalized += components[i];
+    }
+    return normalized;
+}
+
+#ifdef _WIN32
+MappedFile::MappedFile() : mapping(NULL), length(0), fileHandle(INVALID_HANDLE_VALUE), mappingHandle(NULL) {}
+#else
+MappedFile::MappedFile() : mapping(NULL), length(0) {}
+#endif
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const char* path) {
+    close();
+
+#ifdef _WIN32
+    fileHandle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (fileHandle == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle, &fileSize)) {
+        close();
+        return false;
+    }
+    length = (size_t) fileSize.QuadPart;
+    // empty files can't be mapped, but are still valid
+    if (length == 0)
+        return true;
+
+    mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mappingHandle != NULL)
+        mapping = (const unsigned char*) MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+#else
+    int descriptor = ::open(path, O_RDONLY);
+    if (descriptor < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(descriptor, &info) != 0) {
+        ::close(descriptor);
+        return false;
+    }
+    length = (size_t) info.st_size;
+    // empty files can't be mapped, but are still valid
+    if (length == 0) {
+        ::close(descriptor);
+        return true;
+    }
+
+    // the mapping stays valid after the descriptor is closed
+    void* address = mmap(NULL, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    ::close(descriptor);
+    if (address != MAP_FAILED)
+        mapping = (const unsigned char*) address;
+#endif
+
+    if (mapping == NULL) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::close() {
+#ifdef _WIN32
+    if (mapping != NULL)
+        UnmapViewOfFile(mapping);
+    if (mappingHandle != NULL)
+        CloseHandle(mappingHandle);
+    if (fileHandle != INVALID_HANDLE_VALUE)
+        CloseHandle(fileHandle);
+    mappingHandle = NULL;
+    fileHandle = INVALID_HANDLE_VALUE;
+#else
+    if (mapping != NULL)
+        munmap(const_cast<unsigned char*>(mapping), length);
+#endif
+    mapping = NULL;
+    length = 0;
+}
\ No newline at end of file
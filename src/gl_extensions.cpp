@@ -0,0 +1,59 @@
+#include "gl_extensions.hpp"
+
+#include "glad/glad.h"
+#include "GLFW/glfw3.h"
+
+static GLExtensions extensions;
+
+void loadGLExtensions() {
+    // ARB_get_program_binary uses the same entry point names as core 4.1
+    extensions.programBinary = GLAD_GL_VERSION_4_1 || glfwExtensionSupported("GL_ARB_get_program_binary");
+    if (extensions.programBinary && glad_glGetProgramBinary == NULL) {
+        glad_glGetProgramBinary = (PFNGLGETPROGRAMBINARYPROC) glfwGetProcAddress("glGetProgramBinary");
+        glad_glProgramBinary = (PFNGLPROGRAMBINARYPROC) glfwGetProcAddress("glProgramBinary");
+        glad_glProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC) glfwGetProcAddress("glProgramParameteri");
+    }
+    if (glad_glGetProgramBinary == NULL || glad_glProgramBinary == NULL || glad_glProgramParameteri == NULL)
+        extensions.programBinary = false;
+
+    // drivers may support the functions but no binary format at all
+    if (extensions.programBinary) {
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        extensions.programBinary = formats > 0;
+    }
+
+    // the KHR and ARB variants share the token, only the suffix differs
+    extensions.maxShaderCompilerThreads = NULL;
+    if (glfwExtensionSupported("GL_KHR_parallel_shader_compile"))
+        extensions.maxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC) glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+    else if (glfwExtensionSupported("GL_ARB_parallel_shader_compile"))
+        extensions.maxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC) glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+    extensions.parallelShaderCompile = extensions.maxShaderCompilerThreads != NULL;
+    enableParallelShaderCompile();
+
+    extensions.textureCompressionS3TC = glfwExtensionSupported("GL_EXT_texture_compression_s3tc") != 0;
+    extensions.textureCompressionBPTC = GLAD_GL_VERSION_4_2 || glfwExtensionSupported("GL_ARB_texture_compression_bptc");
+    extensions.textureCompressionETC2 = GLAD_GL_VERSION_4_3 || glfwExtensionSupported("GL_ARB_ES3_compatibility");
+
+    extensions.getTextureHandle = NULL;
+    extensions.makeTextureHandleResident = NULL;
+    extensions.makeTextureHandleNonResident = NULL;
+    if (glfwExtensionSupported("GL_ARB_bindless_texture")) {
+        extensions.getTextureHandle = (PFNGLGETTEXTUREHANDLEARBPROC) glfwGetProcAddress("glGetTextureHandleARB");
+        extensions.makeTextureHandleResident = (PFNGLMAKETEXTUREHANDLERESIDENTARBPROC) glfwGetProcAddress("glMakeTextureHandleResidentARB");
+        extensions.makeTextureHandleNonResident = (PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC) glfwGetProcAddress("glMakeTextureHandleNonResidentARB");
+    }
+    extensions.bindlessTexture = extensions.getTextureHandle != NULL && extensions.makeTextureHandleResident != NULL
+        && extensions.makeTextureHandleNonResident != NULL;
+}
+
+const GLExtensions &glExtensions() {
+    return extensions;
+}
+
+void enableParallelShaderCompile() {
+    // 0xFFFFFFFF lets the driver pick the number of compiler threads
+    if (extensions.parallelShaderCompile)
+        extensions.maxShaderCompilerThreads(0xFFFFFFFFu);
+}
\ No newline at end of file
@@ -0,0 +1,21 @@
+#include "hash.hpp"
+
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed) {
+    const unsigned char* bytes = (const unsigned char*) data;
+    uint64_t hash = seed;
+    for (size_t i = 0 ; i < size ; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+uint64_t hashString(const std::string &value, uint64_t seed) {
+    // hash the terminating zero too, so ("ab", "c") and ("a", "bc")
+    // chained through the seed produce different hashes
+    return hashBytes(value.c_str(), value.size() + 1, seed);
+}
+
+uint64_t hashCombine(uint64_t seed, uint64_t value) {
+    return hashBytes(&value, sizeof(value), seed);
+}
\ No newline at end of file
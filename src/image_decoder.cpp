@@ -0,0 +1,175 @@
+#include "image_decoder.hpp"
+
+#include <cstring>
+
+#include "stb/stb_image.h"
+#ifdef USE_TURBOJPEG
+#include "turbojpeg.h"
+#endif
+#ifdef USE_SPNG
+#include "spng.h"
+#endif
+
+#include "pak.hpp"
+#include "image_processing.hpp"
+
+static std::vector<ImageDecoder> compiledDecoders();
+static bool decodeWith(const ImageDecoder &decoder, const unsigned char* data, size_t size, bool bottomUp, DecodedImage &image);
+static bool stbAccepts(const unsigned char* data, size_t size);
+static bool stbDecode(const unsigned char* data, size_t size, bool bottomUp, DecodedImage &image, bool &bottomFirst);
+#ifdef USE_TURBOJPEG
+static bool turboJPEGAccepts(const unsigned char* data, size_t size);
+static bool turboJPEGDecode(const unsigned char* data, size_t size, bool bottomUp, DecodedImage &image, bool &bottomFirst);
+#endif
+#ifdef USE_SPNG
+static bool spngAccepts(const unsigned char* data, size_t size);
+static bool spngDecode(const unsigned char* data, size_t size, bool bottomUp, DecodedImage &image, bool &bottomFirst);
+#endif
+
+const std::vector<ImageDecoder> &imageDecoders() {
+    // initialized once, thread-safe since C++11
+    static const std::vector<ImageDecoder> decoders = compiledDecoders();
+    return decoders;
+}
+
+bool decodeImage(const unsigned char* data, size_t size, DecodedImage &image, bool bottomUp, const ImageDecoder* decoder) {
+    if (decoder != NULL)
+        return decodeWith(*decoder, data, size, bottomUp, image);
+
+    // a backend accepting the signature may still not support the file
+    // (turbojpeg and CMYK or some progressive JPEGs), the next one accepting
+    // it gets a try. stb, last, accepts everything
+    const std::vector<ImageDecoder> &decoders = imageDecoders();
+    for (unsigned int i = 0 ; i < decoders.size() ; i++) {
+        if (decoders[i].accepts(data, size) && decodeWith(decoders[i], data, size, bottomUp, image))
+            return true;
+    }
+    return false;
+}
+
+bool decodeImageFile(const char* path, DecodedImage &image, bool bottomUp) {
+    // decoded straight from the mapping (of the file or of the archive
+    // holding it), without reading the file into a buffer first
+    AssetFile file;
+    if (!file.open(path))
+        return false;
+    return decodeImage(file.data(), file.size(), image, bottomUp);
+}
+
+static bool decodeWith(const ImageDecoder &decoder, const unsigned char* data, size_t size, bool bottomUp, DecodedImage &image) {
+    bool bottomFirst = false;
+    if (!decoder.decode(data, size, bottomUp, image, bottomFirst))
+        return false;
+    if (bottomUp && !bottomFirst)
+        flipVertical(&image.pixels[0], image.width, image.height, image.channels);
+    return true;
+}
+
+static std::vector<ImageDecoder> compiledDecoders() {
+    std::vector<ImageDecoder> decoders;
+#ifdef USE_TURBOJPEG
+    decoders.push_back(ImageDecoder { "turbojpeg", turboJPEGAccepts, turboJPEGDecode });
+#endif
+#ifdef USE_SPNG
+    decoders.push_back(ImageDecoder { "spng", spngAccepts, spngDecode });
+#endif
+    decoders.push_back(ImageDecoder { "stb_image", stbAccepts, stbDecode });
+    return decoders;
+}
+
+static bool stbAccepts(const unsigned char* data, size_t size) {
+    (void) data;
+    (void) size;
+    return true;
+}
+
+static bool stbDecode(const unsigned char* data, size_t size, bool bottomUp, DecodedImage &image, bool &bottomFirst) {
+    (void) bottomUp;
+    int width, height, channels;
+    unsigned char* pixels = stbi_load_from_memory(data, (int) size, &width, &height, &channels, 0);
+    if (pixels == NULL)
+        return false;
+
+    image.width = (unsigned int) width;
+    image.height = (unsigned int) height;
+    image.channels = (unsigned int) channels;
+    image.pixels.assign(pixels, pixels + (size_t) width * (size_t) height * (size_t) channels);
+    stbi_image_free(pixels);
+    // the global stbi flip setting is left off, flipVertical is faster
+    bottomFirst = false;
+    return true;
+}
+
+#ifdef USE_TURBOJPEG
+static bool turboJPEGAccepts(const unsigned char* data, size_t size) {
+    return size >= 3 && data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF;
+}
+
+static bool turboJPEGDecode(const unsigned char* data, size_t size, bool bottomUp, DecodedImage &image, bool &bottomFirst) {
+    tjhandle decompressor = tjInitDecompress();
+    if (decompressor == NULL)
+        return false;
+
+    int width, height, subsampling, colorspace;
+    bool decoded = tjDecompressHeader3(decompressor, data, (unsigned long) size, &width, &height, &subsampling, &colorspace) == 0;
+    if (decoded) {
+        // SIMD IDCT and color conversion, and rows written in GL order
+        // directly when asked
+        int pixelFormat = colorspace == TJCS_GRAY ? TJPF_GRAY : TJPF_RGB;
+        image.width = (unsigned int) width;
+        image.height = (unsigned int) height;
+        image.channels = colorspace == TJCS_GRAY ? 1 : 3;
+        image.pixels.resize((size_t) width * (size_t) height * image.channels);
+        decoded = tjDecompress2(decompressor, data, (unsigned long) size, &image.pixels[0], width, 0, height,
+            pixelFormat, bottomUp ? TJFLAG_BOTTOMUP : 0) == 0;
+        bottomFirst = bottomUp;
+    }
+    tjDestroy(decompressor);
+    return decoded;
+}
+#endif
+
+#ifdef USE_SPNG
+static bool spngAccepts(const unsigned char* data, size_t size) {
+    static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    return size >= 8 && std::memcmp(data, signature, 8) == 0;
+}
+
+static bool spngDecode(const unsigned char* data, size_t size, bool bottomUp, DecodedImage &image, bool &bottomFirst) {
+    (void) bottomUp;
+    spng_ctx* context = spng_ctx_new(0);
+    if (context == NULL)
+        return false;
+
+    struct spng_ihdr header;
+    bool decoded = spng_set_png_buffer(context, data, size) == 0 && spng_get_ihdr(context, &header) == 0;
+    if (decoded) {
+        // the same channel counts stb reports. 16-bit grey has no 8-bit
+        // grey output format, so it is expanded
+        int format = SPNG_FMT_RGBA8;
+        image.channels = 4;
+        if (header.color_type == SPNG_COLOR_TYPE_TRUECOLOR) {
+            format = SPNG_FMT_RGB8;
+            image.channels = 3;
+        } else if (header.color_type == SPNG_COLOR_TYPE_GRAYSCALE && header.bit_depth <= 8) {
+            format = SPNG_FMT_G8;
+            image.channels = 1;
+        } else if (header.color_type == SPNG_COLOR_TYPE_GRAYSCALE_ALPHA && header.bit_depth == 8) {
+            format = SPNG_FMT_GA8;
+            image.channels = 2;
+        }
+
+        size_t bytes = 0;
+        decoded = spng_decoded_image_size(context, format, &bytes) == 0;
+        if (decoded) {
+            image.width = header.width;
+            image.height = header.height;
+            image.pixels.resize(bytes);
+            decoded = spng_decode_image(context, &image.pixels[0], bytes, format, SPNG_DECODE_TRNS) == 0;
+        }
+    }
+    spng_ctx_free(context);
+    bottomFirst = false;
+    return decoded;
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,451 @@
+#include "image_processing.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "parallel.hpp"
+
+// output rows filtered together, bounding the intermediate buffer
+static const unsigned int bandRows = 16;
+// Kaiser window radius in output pixels and its shape parameter
+static const float kaiserRadius = 3.0f;
+static const float kaiserAlpha = 4.0f;
+// entries of the linear to sRGB table, fine enough to stay within half a
+// step of 8-bit sRGB
+static const unsigned int linearToSRGBSize = 16384;
+
+// source pixels and weights of every output pixel along one axis, taps
+// entries per pixel
+struct FilterTaps {
+    unsigned int taps;
+    std::vector<unsigned int> indices;
+    std::vector<float> weights;
+};
+
+struct ConversionTables {
+    float srgbToLinear[256];
+    float unormToFloat[256];
+    unsigned char linearToSRGB[linearToSRGBSize];
+};
+
+static const ConversionTables &conversionTables();
+static FilterTaps filterTaps(unsigned int size, unsigned int outSize, MipFilter filter);
+static float kaiserWeight(float x);
+static float besselI0(float x);
+static void filterRows(const unsigned char* rgba, unsigned int width, unsigned int outWidth, const FilterTaps &horizontal,
+    const FilterTaps &vertical, bool srgb, unsigned int begin, unsigned int end, unsigned char* output);
+static void rowToLinear(const unsigned char* row, unsigned int width, bool srgb, float* output);
+static void rowFromLinear(const float* row, unsigned int width, bool srgb, unsigned char* output);
+static void filterPixel(const float* row, const unsigned int* indices, const float* weights, unsigned int taps, float* output);
+static void accumulate(float* sum, const float* values, float weight, size_t count);
+static void swapBytes(unsigned char* a, unsigned char* b, size_t size);
+#if defined(__SSE2__)
+static __m128i premultiplyPixels(__m128i pixels);
+#endif
+#if defined(__AVX2__)
+static __m256i premultiplyPixels(__m256i pixels);
+#endif
+
+void flipVertical(unsigned char* pixels, unsigned int width, unsigned int height, unsigned int channels) {
+    size_t rowBytes = (size_t) width * channels;
+    parallelFor(height / 2, 64, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int y = begin ; y < end ; y++) {
+            swapBytes(pixels + y * rowBytes, pixels + (height - 1 - y) * rowBytes, rowBytes);
+        }
+    });
+}
+
+void expandToRGBA(const unsigned char* source, size_t count, unsigned int channels, unsigned char* rgba) {
+    if (channels == 4) {
+        std::memcpy(rgba, source, count * 4);
+        return;
+    }
+
+    size_t i = 0;
+    if (channels == 3) {
+        // each 4 byte lane gets the 3 bytes of one pixel and an opaque alpha.
+        // loads read up to 16 (32) bytes, so the last pixels go through the
+        // scalar loop instead of reading past the end
+#if defined(__AVX2__)
+        // lane 1 starts at byte 12, where pixel 4 begins
+        const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 3, 4, 5, 6);
+        const __m256i shuffle = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+            0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        const __m256i alpha = _mm256_set1_epi32((int) 0xFF000000u);
+        for ( ; i + 11 <= count ; i += 8) {
+            __m256i pixels = _mm256_loadu_si256((const __m256i*) (source + i * 3));
+            pixels = _mm256_shuffle_epi8(_mm256_permutevar8x32_epi32(pixels, lanes), shuffle);
+            _mm256_storeu_si256((__m256i*) (rgba + i * 4), _mm256_or_si256(pixels, alpha));
+        }
+#endif
+#if defined(__SSSE3__)
+        const __m128i shuffle4 = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        const __m128i alpha4 = _mm_set1_epi32((int) 0xFF000000u);
+        for ( ; i + 6 <= count ; i += 4) {
+            __m128i pixels = _mm_loadu_si128((const __m128i*) (source + i * 3));
+            pixels = _mm_shuffle_epi8(pixels, shuffle4);
+            _mm_storeu_si128((__m128i*) (rgba + i * 4), _mm_or_si128(pixels, alpha4));
+        }
+#endif
+        for ( ; i < count ; i++) {
+            rgba[i * 4] = source[i * 3];
+            rgba[i * 4 + 1] = source[i * 3 + 1];
+            rgba[i * 4 + 2] = source[i * 3 + 2];
+            rgba[i * 4 + 3] = 255;
+        }
+        return;
+    }
+
+    // grey, with or without alpha
+    for ( ; i < count ; i++) {
+        unsigned char grey = source[i * channels];
+        rgba[i * 4] = grey;
+        rgba[i * 4 + 1] = grey;
+        rgba[i * 4 + 2] = grey;
+        rgba[i * 4 + 3] = channels == 2 ? source[i * 2 + 1] : 255;
+    }
+}
+
+void premultiplyAlpha(unsigned char* rgba, size_t count) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    for ( ; i + 8 <= count ; i += 8) {
+        __m256i pixels = _mm256_loadu_si256((const __m256i*) (rgba + i * 4));
+        _mm256_storeu_si256((__m256i*) (rgba + i * 4), premultiplyPixels(pixels));
+    }
+#endif
+#if defined(__SSE2__)
+    for ( ; i + 4 <= count ; i += 4) {
+        __m128i pixels = _mm_loadu_si128((const __m128i*) (rgba + i * 4));
+        _mm_storeu_si128((__m128i*) (rgba + i * 4), premultiplyPixels(pixels));
+    }
+#endif
+    for ( ; i < count ; i++) {
+        unsigned int alpha = rgba[i * 4 + 3];
+        for (unsigned int c = 0 ; c < 3 ; c++) {
+            // exact round(color * alpha / 255)
+            unsigned int product = rgba[i * 4 + c] * alpha + 128;
+            rgba[i * 4 + c] = (unsigned char) ((product + (product >> 8)) >> 8);
+        }
+    }
+}
+
+void renormalizeNormals(unsigned char* rgba, size_t count) {
+    for (size_t i = 0 ; i < count ; i++) {
+        unsigned char* pixel = rgba + i * 4;
+#if defined(__SSE2__)
+        // xyz in the low lanes, w zeroed so it drops out of the dot product
+        __m128 normal = _mm_setr_ps((float) pixel[0], (float) pixel[1], (float) pixel[2], 127.5f);
+        normal = _mm_sub_ps(_mm_mul_ps(normal, _mm_set1_ps(1.0f / 127.5f)), _mm_set1_ps(1.0f));
+        __m128 squares = _mm_mul_ps(normal, normal);
+        squares = _mm_add_ps(squares, _mm_shuffle_ps(squares, squares, _MM_SHUFFLE(2, 3, 0, 1)));
+        squares = _mm_add_ps(squares, _mm_shuffle_ps(squares, squares, _MM_SHUFFLE(1, 0, 3, 2)));
+        normal = _mm_div_ps(normal, _mm_sqrt_ps(_mm_max_ps(squares, _mm_set1_ps(1e-12f))));
+        normal = _mm_add_ps(_mm_mul_ps(_mm_add_ps(normal, _mm_set1_ps(1.0f)), _mm_set1_ps(127.5f)), _mm_set1_ps(0.5f));
+        float values[4];
+        _mm_storeu_ps(values, normal);
+#else
+        float values[3];
+        float length = 0.0f;
+        for (unsigned int c = 0 ; c < 3 ; c++) {
+            values[c] = pixel[c] / 127.5f - 1.0f;
+            length += values[c] * values[c];
+        }
+        length = std::sqrt(std::max(length, 1e-12f));
+        for (unsigned int c = 0 ; c < 3 ; c++) {
+            values[c] = (values[c] / length + 1.0f) * 127.5f + 0.5f;
+        }
+#endif
+        for (unsigned int c = 0 ; c < 3 ; c++) {
+            pixel[c] = (unsigned char) std::min(std::max(values[c], 0.0f), 255.0f);
+        }
+    }
+}
+
+void downsampleImage(const unsigned char* rgba, unsigned int width, unsigned int height, unsigned char* output,
+        const MipOptions &options) {
+    unsigned int outWidth = std::max(width / 2, 1u);
+    unsigned int outHeight = std::max(height / 2, 1u);
+    FilterTaps horizontal = filterTaps(width, outWidth, options.filter);
+    FilterTaps vertical = filterTaps(height, outHeight, options.filter);
+    bool srgb = options.srgb && !options.normalMap;
+
+    parallelFor(outHeight, bandRows, [&](unsigned int begin, unsigned int end) {
+        filterRows(rgba, width, outWidth, horizontal, vertical, srgb, begin, end, output);
+        if (options.normalMap)
+            renormalizeNormals(output + (size_t) begin * outWidth * 4, (size_t) (end - begin) * outWidth);
+    });
+}
+
+TextureData generateMips(const unsigned char* rgba, unsigned int width, unsigned int height, const MipOptions &options) {
+    TextureData texture;
+    texture.format = TextureFormat::RGBA8;
+    texture.levels.resize(mipLevelCount(width, height));
+
+    TextureLevel &base = texture.levels[0];
+    base.width = width;
+    base.height = height;
+    base.data.assign(rgba, rgba + (size_t) width * height * 4);
+    if (options.normalMap)
+        renormalizeNormals(&base.data[0], (size_t) width * height);
+
+    // every level is filtered from the one above it
+    for (unsigned int level = 1 ; level < texture.levels.size() ; level++) {
+        const TextureLevel &previous = texture.levels[level - 1];
+        TextureLevel &current = texture.levels[level];
+        current.width = std::max(previous.width / 2, 1u);
+        current.height = std::max(previous.height / 2, 1u);
+        current.data.resize((size_t) current.width * current.height * 4);
+        downsampleImage(&previous.data[0], previous.width, previous.height, &current.data[0], options);
+    }
+    return texture;
+}
+
+static const ConversionTables &conversionTables() {
+    struct Builder {
+        ConversionTables tables;
+        Builder() {
+            for (unsigned int i = 0 ; i < 256 ; i++) {
+                float value = i / 255.0f;
+                tables.unormToFloat[i] = value;
+                tables.srgbToLinear[i] = value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+            }
+            for (unsigned int i = 0 ; i < linearToSRGBSize ; i++) {
+                float value = i / (float) (linearToSRGBSize - 1);
+                float srgb = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+                tables.linearToSRGB[i] = (unsigned char) (srgb * 255.0f + 0.5f);
+            }
+        }
+    };
+    // built once, thread-safe since C++11
+    static const Builder builder;
+    return builder.tables;
+}
+
+static FilterTaps filterTaps(unsigned int size, unsigned int outSize, MipFilter filter) {
+    FilterTaps taps;
+    if (filter == MipFilter::BOX) {
+        taps.taps = 2;
+        for (unsigned int i = 0 ; i < outSize ; i++) {
+            taps.indices.push_back(std::min(i * 2, size - 1));
+            taps.indices.push_back(std::min(i * 2 + 1, size - 1));
+            taps.weights.push_back(0.5f);
+            taps.weights.push_back(0.5f);
+        }
+        return taps;
+    }
+
+    // pixel i covers [i, i + 1) in source coordinates, and each output
+    // pixel samples the windowed sinc over its radius, stretched by scale
+    float scale = (float) size / (float) outSize;
+    float reach = kaiserRadius * scale;
+    taps.taps = (unsigned int) std::ceil(2.0f * reach) + 1;
+    for (unsigned int i = 0 ; i < outSize ; i++) {
+        float center = ((float) i + 0.5f) * scale;
+        int first = (int) std::ceil(center - reach - 0.5f);
+        float total = 0.0f;
+        size_t start = taps.weights.size();
+        for (unsigned int tap = 0 ; tap < taps.taps ; tap++) {
+            int source = first + (int) tap;
+            float x = ((float) source + 0.5f - center) / scale;
+            float weight = std::fabs(x) < kaiserRadius ? kaiserWeight(x) : 0.0f;
+            // the edge pixel stands in for pixels past it
+            taps.indices.push_back((unsigned int) std::min(std::max(source, 0), (int) size - 1));
+            taps.weights.push_back(weight);
+            total += weight;
+        }
+        for (unsigned int tap = 0 ; tap < taps.taps ; tap++) {
+            taps.weights[start + tap] /= total;
+        }
+    }
+    return taps;
+}
+
+static float kaiserWeight(float x) {
+    const float pi = 3.14159265358979f;
+    float sinc = x == 0.0f ? 1.0f : std::sin(pi * x) / (pi * x);
+    float window = x / kaiserRadius;
+    return sinc * besselI0(kaiserAlpha * std::sqrt(std::max(1.0f - window * window, 0.0f))) / besselI0(kaiserAlpha);
+}
+
+// zeroth order modified Bessel function of the first kind, by its series
+static float besselI0(float x) {
+    float sum = 1.0f;
+    float term = 1.0f;
+    for (unsigned int k = 1 ; k < 32 ; k++) {
+        term *= (x / (2.0f * (float) k)) * (x / (2.0f * (float) k));
+        sum += term;
+        if (term < sum * 1e-8f)
+            break;
+    }
+    return sum;
+}
+
+// filters output rows [begin, end) band by band: the source rows a band
+// needs are filtered horizontally into linear floats first, then combined
+// vertically
+static void filterRows(const unsigned char* rgba, unsigned int width, unsigned int outWidth, const FilterTaps &horizontal,
+        const FilterTaps &vertical, bool srgb, unsigned int begin, unsigned int end, unsigned char* output) {
+    std::vector<float> sourceRow((size_t) width * 4);
+    std::vector<float> filtered;
+    std::vector<float> sum((size_t) outWidth * 4);
+    for (unsigned int bandBegin = begin ; bandBegin < end ; bandBegin += bandRows) {
+        unsigned int bandEnd = std::min(bandBegin + bandRows, end);
+        unsigned int first = vertical.indices[bandBegin * vertical.taps];
+        unsigned int last = first;
+        for (size_t i = (size_t) bandBegin * vertical.taps ; i < (size_t) bandEnd * vertical.taps ; i++) {
+            first = std::min(first, vertical.indices[i]);
+            last = std::max(last, vertical.indices[i]);
+        }
+
+        filtered.resize((size_t) (last - first + 1) * outWidth * 4);
+        for (unsigned int y = first ; y <= last ; y++) {
+            rowToLinear(rgba + (size_t) y * width * 4, width, srgb, &sourceRow[0]);
+            float* row = &filtered[(size_t) (y - first) * outWidth * 4];
+            for (unsigned int x = 0 ; x < outWidth ; x++) {
+                size_t tap = (size_t) x * horizontal.taps;
+                filterPixel(&sourceRow[0], &horizontal.indices[tap], &horizontal.weights[tap], horizontal.taps, row + x * 4);
+            }
+        }
+
+        for (unsigned int y = bandBegin ; y < bandEnd ; y++) {
+            std::fill(sum.begin(), sum.end(), 0.0f);
+            for (unsigned int tap = 0 ; tap < vertical.taps ; tap++) {
+                size_t i = (size_t) y * vertical.taps + tap;
+                const float* row = &filtered[(size_t) (vertical.indices[i] - first) * outWidth * 4];
+                accumulate(&sum[0], row, vertical.weights[i], sum.size());
+            }
+            rowFromLinear(&sum[0], outWidth, srgb, output + (size_t) y * outWidth * 4);
+        }
+    }
+}
+
+static void rowToLinear(const unsigned char* row, unsigned int width, bool srgb, float* output) {
+    const ConversionTables &tables = conversionTables();
+    const float* color = srgb ? tables.srgbToLinear : tables.unormToFloat;
+    for (unsigned int x = 0 ; x < width ; x++) {
+        output[x * 4] = color[row[x * 4]];
+        output[x * 4 + 1] = color[row[x * 4 + 1]];
+        output[x * 4 + 2] = color[row[x * 4 + 2]];
+        output[x * 4 + 3] = tables.unormToFloat[row[x * 4 + 3]];
+    }
+}
+
+static void rowFromLinear(const float* row, unsigned int width, bool srgb, unsigned char* output) {
+    const ConversionTables &tables = conversionTables();
+    for (unsigned int x = 0 ; x < width ; x++) {
+        // the sinc's negative lobes overshoot around edges
+        for (unsigned int c = 0 ; c < 4 ; c++) {
+            float value = std::min(std::max(row[x * 4 + c], 0.0f), 1.0f);
+            if (srgb && c < 3)
+                output[x * 4 + c] = tables.linearToSRGB[(unsigned int) (value * (float) (linearToSRGBSize - 1) + 0.5f)];
+            else
+                output[x * 4 + c] = (unsigned char) (value * 255.0f + 0.5f);
+        }
+    }
+}
+
+static void filterPixel(const float* row, const unsigned int* indices, const float* weights, unsigned int taps, float* output) {
+#if defined(__SSE2__)
+    // the whole RGBA pixel in one register
+    __m128 sum = _mm_setzero_ps();
+    for (unsigned int tap = 0 ; tap < taps ; tap++) {
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[tap]), _mm_loadu_ps(row + indices[tap] * 4)));
+    }
+    _mm_storeu_ps(output, sum);
+#else
+    output[0] = output[1] = output[2] = output[3] = 0.0f;
+    for (unsigned int tap = 0 ; tap < taps ; tap++) {
+        for (unsigned int c = 0 ; c < 4 ; c++) {
+            output[c] += weights[tap] * row[indices[tap] * 4 + c];
+        }
+    }
+#endif
+}
+
+static void accumulate(float* sum, const float* values, float weight, size_t count) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    __m256 weight8 = _mm256_set1_ps(weight);
+    for ( ; i + 8 <= count ; i += 8) {
+        _mm256_storeu_ps(sum + i, _mm256_add_ps(_mm256_loadu_ps(sum + i), _mm256_mul_ps(weight8, _mm256_loadu_ps(values + i))));
+    }
+#endif
+#if defined(__SSE2__)
+    __m128 weight4 = _mm_set1_ps(weight);
+    for ( ; i + 4 <= count ; i += 4) {
+        _mm_storeu_ps(sum + i, _mm_add_ps(_mm_loadu_ps(sum + i), _mm_mul_ps(weight4, _mm_loadu_ps(values + i))));
+    }
+#endif
+    for ( ; i < count ; i++) {
+        sum[i] += weight * values[i];
+    }
+}
+
+static void swapBytes(unsigned char* a, unsigned char* b, size_t size) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    for ( ; i + 32 <= size ; i += 32) {
+        __m256i first = _mm256_loadu_si256((const __m256i*) (a + i));
+        __m256i second = _mm256_loadu_si256((const __m256i*) (b + i));
+        _mm256_storeu_si256((__m256i*) (a + i), second);
+        _mm256_storeu_si256((__m256i*) (b + i), first);
+    }
+#endif
+#if defined(__SSE2__)
+    for ( ; i + 16 <= size ; i += 16) {
+        __m128i first = _mm_loadu_si128((const __m128i*) (a + i));
+        __m128i second = _mm_loadu_si128((const __m128i*) (b + i));
+        _mm_storeu_si128((__m128i*) (a + i), second);
+        _mm_storeu_si128((__m128i*) (b + i), first);
+    }
+#endif
+    for ( ; i < size ; i++) {
+        std::swap(a[i], b[i]);
+    }
+}
+
+#if defined(__SSE2__)
+// four RGBA8 pixels, widened to 16 bits two pixels at a time
+static __m128i premultiplyPixels(__m128i pixels) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alphaLanes = _mm_setr_epi16(0, 0, 0, -1, 0, 0, 0, -1);
+    const __m128i half = _mm_set1_epi16(128);
+    __m128i halves[2] = { _mm_unpacklo_epi8(pixels, zero), _mm_unpackhi_epi8(pixels, zero) };
+    for (unsigned int i = 0 ; i < 2 ; i++) {
+        __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(halves[i], 0xFF), 0xFF);
+        __m128i product = _mm_add_epi16(_mm_mullo_epi16(halves[i], alpha), half);
+        product = _mm_srli_epi16(_mm_add_epi16(product, _mm_srli_epi16(product, 8)), 8);
+        halves[i] = _mm_or_si128(_mm_andnot_si128(alphaLanes, product), _mm_and_si128(alphaLanes, halves[i]));
+    }
+    return _mm_packus_epi16(halves[0], halves[1]);
+}
+#endif
+
+#if defined(__AVX2__)
+// the same on eight pixels. unpacking and packing stay within 128-bit
+// lanes, so pixel order is kept
+static __m256i premultiplyPixels(__m256i pixels) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i alphaLanes = _mm256_setr_epi16(0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0, -1);
+    const __m256i half = _mm256_set1_epi16(128);
+    __m256i halves[2] = { _mm256_unpacklo_epi8(pixels, zero), _mm256_unpackhi_epi8(pixels, zero) };
+    for (unsigned int i = 0 ; i < 2 ; i++) {
+        __m256i alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(halves[i], 0xFF), 0xFF);
+        __m256i product = _mm256_add_epi16(_mm256_mullo_epi16(halves[i], alpha), half);
+        product = _mm256_srli_epi16(_mm256_add_epi16(product, _mm256_srli_epi16(product, 8)), 8);
+        halves[i] = _mm256_or_si256(_mm256_andnot_si256(alphaLanes, product), _mm256_and_si256(alphaLanes, halves[i]));
+    }
+    return _mm256_packus_epi16(halves[0], halves[1]);
+}
+#endif
\ No newline at end of file
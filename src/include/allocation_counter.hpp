@@ -0,0 +1,8 @@
+#pragma once
+
+// Heap allocations made through operator new, on any thread, since the
+// program started. Counting replaces the global operator new and delete,
+// at the cost of an atomic increment per allocation. The difference
+// between two calls tells whether the code in between allocated, e.g.
+// that a steady state frame doesn't.
+unsigned long long allocationCount();
\ No newline at end of file
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Linear (bump) allocator for short lived data. Allocating moves a cursor
+// through large blocks, and nothing is freed on its own: rewind() or
+// reset() frees everything allocated after a point at once. Blocks are
+// kept for reuse, so once an arena has grown to fit a workload, running
+// it again does not touch the heap. Not thread safe: every thread
+// allocating needs its own arena.
+class Arena {
+public:
+    // position of the cursor, to rewind to
+    struct Marker {
+        size_t block;
+        size_t offset;
+    };
+
+    explicit Arena(size_t inBlockSize = 64u << 10);
+    ~Arena();
+
+    void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+    Marker mark() const;
+    // frees what was allocated since marker was taken
+    void rewind(const Marker &marker);
+    // frees everything. an arena that needed several blocks replaces them
+    // with a single one as large as all of them, so the same allocations
+    // fit in one block next time
+    void reset();
+    // bytes held in blocks, used or not
+    size_t capacity() const;
+
+private:
+    struct Block {
+        unsigned char* data;
+        size_t size;
+    };
+
+    size_t blockSize;
+    std::vector<Block> blocks;
+    // block and offset the next allocation is tried at
+    size_t current;
+    size_t offset;
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    static Block newBlock(size_t size);
+};
+
+// Rewinds an arena to where it was when the scope was created.
+class ArenaScope {
+public:
+    explicit ArenaScope(Arena &inArena) : arena(inArena), marker(inArena.mark()) {}
+    ~ArenaScope() { arena.rewind(marker); }
+
+private:
+    Arena &arena;
+    Arena::Marker marker;
+
+    ArenaScope(const ArenaScope &) = delete;
+    ArenaScope &operator=(const ArenaScope &) = delete;
+};
+
+// Lets standard containers allocate from an arena. Deallocating is a
+// no-op, so containers that grow leave their old storage behind until
+// the arena is rewound: reserve the final size when it is known.
+template <typename T>
+class ArenaAllocator {
+public:
+    typedef T value_type;
+
+    Arena* arena;
+
+    explicit ArenaAllocator(Arena &inArena) : arena(&inArena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena) {}
+
+    T* allocate(size_t count) {
+        return (T*) arena->allocate(count * sizeof(T), alignof(T));
+    }
+    void deallocate(T*, size_t) {}
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) {
+    return a.arena == b.arena;
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) {
+    return a.arena != b.arena;
+}
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+// Transient data of the current frame. There are two arenas used on
+// alternate frames, so data allocated during a frame stays valid until
+// the end of the next one (e.g. for work that finishes a frame late).
+// Main thread only.
+class FrameArena {
+public:
+    static FrameArena &instance();
+
+    // resets the arena used two frames ago and makes it current. called
+    // once at the start of every frame
+    void beginFrame();
+    Arena &current();
+
+private:
+    Arena arenas[2];
+    unsigned int index;
+
+    FrameArena() : index(0) {}
+    FrameArena(const FrameArena &) = delete;
+    FrameArena &operator=(const FrameArena &) = delete;
+};
+
+// Scratch memory for importing assets, one arena per thread, so that
+// loaders running as jobs don't contend. Users rewind it when done (see
+// ArenaScope); its blocks stay around for the next import.
+Arena &loadArena();
\ No newline at end of file
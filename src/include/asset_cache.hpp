@@ -0,0 +1,78 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "pak.hpp"
+
+// Asset files kept open and resident between reads, for importers that
+// open the same files again and again (Assimp opens a model several
+// times while probing its format, and re-imports read the same .mtl
+// libraries). Files are shared: opening a cached file costs a hash
+// lookup of its normalized path (see normalizePath) and a stat, which
+// reopens files modified since they were cached.
+//
+// prefetch() opens files on a background thread and touches every page,
+// so that they are in RAM by the time the importer asks for them. The
+// files an import read can be recorded against the model (see
+// setDependencies): prefetching it later reads those ahead as well.
+//
+// Files nobody holds are evicted least recently used first once the
+// cache is over its budget. Every member is thread safe.
+class AssetCache {
+public:
+    static AssetCache &instance();
+
+    ~AssetCache();
+
+    // the cached file for path, opened now if it isn't cached, or waited
+    // for if a prefetch is opening it. NULL if it can't be opened
+    std::shared_ptr<const AssetFile> open(const char* path);
+    bool contains(const char* path);
+    // queues path and its recorded dependencies for reading ahead
+    void prefetch(const char* path);
+    void setDependencies(const char* path, const std::vector<std::string> &files);
+    void setBudget(size_t bytes);
+    // drops every file nobody holds
+    void clear();
+
+private:
+    struct Entry {
+        std::shared_ptr<AssetFile> file;
+        bool loading;
+        unsigned long long lastUse;
+        // of the loose file when it was opened, -1 if there is none
+        long long modified;
+    };
+
+    std::mutex mutex;
+    // signalled when an entry finishes loading, and when work is queued
+    std::condition_variable loaded;
+    std::condition_variable queued;
+    // keyed by normalized path
+    std::unordered_map<std::string, Entry> entries;
+    std::unordered_map<std::string, std::vector<std::string>> dependencies;
+    // paths to prefetch, as given
+    std::deque<std::string> queue;
+    std::thread worker;
+    bool stopping;
+    size_t budget;
+    size_t cached;
+    unsigned long long uses;
+
+    AssetCache() : stopping(false), budget(64u << 20), cached(0), uses(0) {}
+    AssetCache(const AssetCache &) = delete;
+    AssetCache &operator=(const AssetCache &) = delete;
+
+    void prefetchLoop();
+    // loads an entry inserted as loading, with the mutex unlocked
+    std::shared_ptr<AssetFile> load(const std::string &key, const char* path, bool touch, std::unique_lock<std::mutex> &lock);
+    void trim();
+};
\ No newline at end of file
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+class Mesh;
+class Shader;
+
+// A draw recorded into a CommandList. Like DrawItem, either mesh is set
+// and the draw goes through Mesh::Draw, or vertexArray/first/count
+// describe a non-indexed draw using a single texture.
+struct DrawCommand {
+    // program the draw uses, made current on replay when it changes
+    Shader* pipeline;
+    Mesh* mesh;
+    unsigned int vertexArray;
+    unsigned int texture;
+    int first;
+    int count;
+    unsigned int stencilMask;
+    // index of the draw's model matrix in its list's uniform data, set by
+    // CommandList::draw
+    uint32_t uniformOffset;
+
+    DrawCommand();
+};
+
+// Draws recorded by one job, without any GL call, so that recording can
+// run on any thread. Commands and their uniform data are appended to
+// storage that is kept when the list is cleared, so a list recording
+// about as many draws as in the previous frame does not allocate.
+class CommandList {
+public:
+    void clear();
+    // appends command, copying model into the list's uniform data
+    void draw(const DrawCommand &command, const glm::mat4 &model);
+    size_t size() const;
+
+private:
+    friend class CommandRecorder;
+
+    std::vector<DrawCommand> commands;
+    std::vector<glm::mat4> uniforms;
+};
+
+// Records draws on the job system's threads and replays them on the GL
+// thread. record() splits the work into ranges like parallelFor, and
+// every range records into its own CommandList, so recording never
+// synchronizes. Lists replay in the order of their ranges, which is the
+// order a single thread recording everything would have produced.
+//
+// Replaying only changes the program, texture, VAO and stencil mask when
+// consecutive commands use different ones.
+class CommandRecorder {
+public:
+    CommandRecorder() : used(0) {}
+
+    // drops the recorded commands, keeping the lists' storage
+    void clear();
+    // runs body(list, begin, end) over [0, count) in ranges of at least
+    // grain items and waits for all of them. later calls append after
+    // the commands recorded by earlier ones
+    void record(unsigned int count, unsigned int grain, const std::function<void(CommandList&, unsigned int, unsigned int)> &body);
+    // issues the recorded draws. must be called on the thread owning the
+    // GL context
+    void replay();
+    size_t size() const;
+
+private:
+    // kept between frames, only the first used hold this frame's commands
+    std::vector<std::unique_ptr<CommandList>> lists;
+    unsigned int used;
+};
\ No newline at end of file
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// One line of a cooked asset manifest: what was cooked into output, and
+// the files it was cooked from with their modification times, the
+// source itself first. Outputs are named by a hash of their inputs'
+// contents, so identical sources share one cooked file.
+struct ManifestEntry {
+    // "texture", "normal_map" or "height_map" (KTX2, compressed as
+    // TextureUsage says) or "model" (see saveCookedModel)
+    std::string kind;
+    // file name within the cooked directory
+    std::string output;
+    std::vector<std::pair<std::string, long long>> dependencies;
+};
+
+// tab separated text, one entry per line, after a line with the version
+// of the cooker that wrote them (0 if missing)
+bool readManifest(const char* path, std::vector<ManifestEntry> &entries, unsigned int* version = NULL);
+bool writeManifest(const char* path, const std::vector<ManifestEntry> &entries, unsigned int version);
+
+// The assets tools/cook wrote (make cook), looked up by source path.
+// TextureManager and Model load the cooked file instead of decoding or
+// importing the source whenever there is one that is up to date.
+class CookedAssets {
+public:
+    static CookedAssets &instance();
+
+    // reads directory/manifest.txt. returns false without one, in which
+    // case every asset loads from its source
+    bool open(const std::string &cookedDirectory);
+    // path of the cooked file for a source, or an empty string if it
+    // wasn't cooked or it or one of its dependencies was modified since
+    std::string find(const char* sourcePath) const;
+
+private:
+    struct Asset {
+        std::string output;
+        std::vector<std::pair<std::string, long long>> dependencies;
+    };
+
+    std::string directory;
+    // keyed by canonical source path
+    std::unordered_map<std::string, Asset> assets;
+
+    CookedAssets() {}
+    CookedAssets(const CookedAssets &) = delete;
+    CookedAssets &operator=(const CookedAssets &) = delete;
+};
\ No newline at end of file
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "texture_data.hpp"
+
+// Reads and writes DirectDraw Surface files holding BC1, BC3, BC4, BC5
+// (legacy FourCC headers) or BC7 (DX10 extended header) textures with
+// their mip chains.
+//
+// Levels are stored as they are uploaded, bottom row first (images are
+// decoded flipped, see decodeImage), unlike most DDS files which start at the top row.
+// Flipping block compressed data is only exact for heights that are a
+// multiple of 4, so DDS files made by other tools must be exported
+// flipped (texconv -vflip) rather than flipped here.
+bool loadDDS(const char* path, TextureData &texture);
+bool saveDDS(const char* path, const TextureData &texture);
\ No newline at end of file
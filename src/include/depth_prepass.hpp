@@ -0,0 +1,71 @@
+#pragma once
+
+// Controls an optional depth-only prepass. When enabled, the scene is first
+// drawn with color writes disabled and a position-only vertex stream, filling
+// the depth buffer. The shading pass then runs with GL_EQUAL and depth writes
+// disabled, so every pixel runs the (expensive) fragment shader only once.
+//
+// In AUTO mode the prepass is toggled per scene based on measured overdraw:
+// GL_SAMPLES_PASSED queries count how many fragments the scene generates
+// versus how many of them end up visible. Query results are read a few
+// frames late so measuring never stalls the pipeline.
+class DepthPrepass {
+public:
+    enum class Mode {
+        OFF,
+        ON,
+        AUTO
+    };
+
+    Mode mode;
+
+    DepthPrepass(Mode inMode = Mode::AUTO);
+    // deletes the queries, so the context must still be current
+    ~DepthPrepass();
+
+    // collects finished query results and decides if this frame runs a prepass
+    void beginFrame();
+    // whether the current frame renders the depth prepass
+    bool enabled() const;
+    // disables color writes and starts counting generated fragments
+    void beginDepthPass();
+    // sets the depth state for shading and starts counting shaded fragments
+    void beginShadingPass();
+    // restores the default depth state (GL_LESS, depth writes enabled)
+    void endShadingPass();
+
+    // smoothed ratio of generated fragments to visible fragments
+    float overdraw() const;
+
+private:
+    // number of frames a query result is expected to take to be available
+    constexpr static unsigned int queryFrames = 4;
+    // in AUTO mode, a prepass frame is forced this often to re-measure the
+    // number of visible fragments while the prepass is off
+    constexpr static unsigned int probeInterval = 60;
+    // hysteresis thresholds, so the mode does not flicker around one value
+    constexpr static float enableThreshold = 1.5f;
+    constexpr static float disableThreshold = 1.2f;
+
+    struct FrameQueries {
+        unsigned int depthQuery;
+        unsigned int shadingQuery;
+        bool pending;
+        bool hadPrepass;
+    };
+
+    FrameQueries frames[queryFrames];
+    unsigned int frameIndex;
+    unsigned int framesSinceProbe;
+    bool prepassActive;
+    bool autoEnabled;
+    // last known number of visible samples, measured in a prepass frame
+    double visibleSamples;
+    float smoothedOverdraw;
+
+    void collect(FrameQueries &frame);
+    void record(double overdrawSample);
+
+    DepthPrepass(const DepthPrepass &) = delete;
+    DepthPrepass &operator=(const DepthPrepass &) = delete;
+};
\ No newline at end of file
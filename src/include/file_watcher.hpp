@@ -0,0 +1,38 @@
+#pragma once
+
+#include <chrono>
+#include <ctime>
+#include <map>
+#include <string>
+#include <vector>
+
+// Reports files created or modified inside a directory (not recursive).
+// Uses inotify on Linux. Elsewhere it falls back to comparing modification
+// times, rescanning the directory at most every scanInterval seconds.
+class FileWatcher {
+public:
+    FileWatcher(const char* inDirectory);
+    ~FileWatcher();
+
+    // returns the paths (directory + '/' + filename) changed since the
+    // last call. never blocks
+    std::vector<std::string> poll();
+
+private:
+    std::string directory;
+#ifdef __linux__
+    int inotifyDescriptor;
+#else
+    constexpr static double scanInterval = 0.5;
+    std::map<std::string, time_t> modifiedTimes;
+    std::chrono::steady_clock::time_point lastScan;
+    // reused for every entry, so that rescanning an unchanged directory
+    // doesn't allocate
+    std::string scanPath;
+
+    void scan(std::vector<std::string>* changed);
+#endif
+
+    FileWatcher(const FileWatcher &) = delete;
+    FileWatcher &operator=(const FileWatcher &) = delete;
+};
\ No newline at end of file
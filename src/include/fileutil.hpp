@@ -0,0 +1,61 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Small portable file helpers (the project builds with -std=c++11, so
+// there is no <filesystem>).
+
+// reads a whole file into bytes. returns false if it can't be opened
+bool readFileBytes(const char* path, std::vector<unsigned char> &bytes);
+// writes bytes to a temporary file and renames it over path, so readers
+// never see a partially written file
+bool writeFileBytes(const char* path, const void* data, size_t size);
+// creates a directory and all its missing parents
+bool makeDirectories(const std::string &path);
+bool fileExists(const char* path);
+// appends the paths of all files under directory and its subdirectories,
+// as directory + '/' + relative path, sorted within each directory.
+// returns false if directory can't be opened
+bool listFiles(const std::string &directory, std::vector<std::string> &files);
+// last modification time in seconds since the epoch, or -1 if the file
+// does not exist
+long long fileModifiedTime(const char* path);
+// absolute path with "." and ".." resolved and '/' separators, so that
+// different spellings of the same file compare equal. on windows it is
+// also lowercased, since paths there are case insensitive. returns the
+// path unchanged if it can't be resolved (e.g. the file does not exist)
+std::string canonicalPath(const char* path);
+// path with '\' separators replaced by '/' and "." and ".." components
+// resolved without touching the disk, lowercased on windows. no syscalls
+// unlike canonicalPath, but a relative and an absolute spelling of the
+// same file still differ
+std::string normalizePath(const char* path);
+
+// A whole file mapped read-only into memory. Pages are loaded by the OS
+// on first access and shared with its file cache, so nothing is copied
+// until the data is actually used.
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    // maps path, replacing any previous mapping. returns false if the
+    // file can't be opened or mapped
+    bool open(const char* path);
+    void close();
+
+    const unsigned char* data() const { return mapping; }
+    size_t size() const { return length; }
+
+private:
+    const unsigned char* mapping;
+    size_t length;
+#ifdef _WIN32
+    void* fileHandle;
+    void* mappingHandle;
+#endif
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+};
\ No newline at end of file
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "glad/glad.h"
+
+// ARB_bindless_texture entry points, glad was not generated with it
+typedef GLuint64 (APIENTRYP PFNGLGETTEXTUREHANDLEARBPROC)(GLuint texture);
+typedef void (APIENTRYP PFNGLMAKETEXTUREHANDLERESIDENTARBPROC)(GLuint64 handle);
+typedef void (APIENTRYP PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC)(GLuint64 handle);
+// KHR/ARB_parallel_shader_compile
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+// Optional OpenGL features used when the driver exposes them. The window
+// asks for a 3.3 core context, so glad only loads 3.3 entry points; the
+// functions of later core versions that are also available as extensions
+// on 3.3 drivers are loaded here.
+struct GLExtensions {
+    // GL 4.1 / ARB_get_program_binary: glGetProgramBinary, glProgramBinary
+    bool programBinary;
+    // KHR/ARB_parallel_shader_compile: the driver compiles on its own
+    // threads and GL_COMPLETION_STATUS_KHR can be polled without blocking
+    bool parallelShaderCompile;
+    PFNGLMAXSHADERCOMPILERTHREADSKHRPROC maxShaderCompilerThreads;
+    // EXT_texture_compression_s3tc: BC1/BC3 (never core, but universal on desktop)
+    bool textureCompressionS3TC;
+    // GL 4.2 / ARB_texture_compression_bptc: BC7
+    bool textureCompressionBPTC;
+    // GL 4.3 / ARB_ES3_compatibility: ETC2
+    bool textureCompressionETC2;
+    // ARB_bindless_texture: shaders sample textures through 64-bit handles
+    // read from buffers, with no texture unit binding. the texture can't
+    // be respecified once it has a handle
+    bool bindlessTexture;
+    PFNGLGETTEXTUREHANDLEARBPROC getTextureHandle;
+    PFNGLMAKETEXTUREHANDLERESIDENTARBPROC makeTextureHandleResident;
+    PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC makeTextureHandleNonResident;
+};
+
+// tokens of extensions glad was not generated with
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+// must be called after gladLoadGLLoader, with the context current
+void loadGLExtensions();
+const GLExtensions &glExtensions();
+// lets the driver pick how many threads compile shaders for the current
+// context. the setting is per context, so shared contexts that compile
+// (see ShaderCompiler) call it too. does nothing without the extension
+void enableParallelShaderCompile();
\ No newline at end of file
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// 64 bit FNV-1a. Not cryptographic, but fast and stable across runs and
+// platforms, so hashes can be used as cache keys on disk.
+const uint64_t hashSeed = 0xcbf29ce484222325ull;
+
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed = hashSeed);
+uint64_t hashString(const std::string &value, uint64_t seed = hashSeed);
+// mixes two hashes into one, order dependent
+uint64_t hashCombine(uint64_t seed, uint64_t value);
\ No newline at end of file
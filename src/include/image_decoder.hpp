@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// 8-bit pixels of a decoded image at the file's own channel count: 1
+// (grey), 2 (grey, alpha), 3 (RGB) or 4 (RGBA)
+struct DecodedImage {
+    unsigned int width;
+    unsigned int height;
+    unsigned int channels;
+    std::vector<unsigned char> pixels;
+};
+
+// One image decoding backend. Backends are tried in the order of
+// imageDecoders(): the first one accepting the file's signature decodes
+// it, and if it fails the next one accepting it tries. stb_image is always available and accepts everything; faster
+// backends are compiled in with make decoders="turbojpeg spng" (see
+// Makefile decoder_flags), given the libraries are installed.
+struct ImageDecoder {
+    const char* name;
+    // whether the backend handles a file starting with these bytes
+    bool (*accepts)(const unsigned char* data, size_t size);
+    // decodes the file in data. bottomUp asks for the bottom row first,
+    // as GL expects. returns whether it did so in bottomFirst, backends
+    // that can't leave the rows top first
+    bool (*decode)(const unsigned char* data, size_t size, bool bottomUp, DecodedImage &image, bool &bottomFirst);
+};
+
+// compiled in backends, fastest first, stb last
+const std::vector<ImageDecoder> &imageDecoders();
+// decodes with the first backend accepting data that succeeds (or only
+// with decoder when given), flipping the rows afterwards if the backend
+// couldn't
+bool decodeImage(const unsigned char* data, size_t size, DecodedImage &image, bool bottomUp = true,
+    const ImageDecoder* decoder = NULL);
+// maps path and decodes it, see decodeImage
+bool decodeImageFile(const char* path, DecodedImage &image, bool bottomUp = true);
\ No newline at end of file
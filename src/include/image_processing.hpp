@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+
+#include "texture_data.hpp"
+
+// CPU preprocessing of decoded images before they are compressed and
+// uploaded, on tightly packed 8-bit pixels. The byte kernels (flip,
+// expansion, premultiplication) use AVX2 when built with it (make
+// simd=avx2) and SSE2 otherwise; mip filtering and renormalization work
+// on one RGBA pixel per SSE register. Mip levels are filtered by bands of
+// rows on all hardware threads (see parallelFor).
+
+enum class MipFilter {
+    // 2x2 average, odd sizes clamp the edge
+    BOX,
+    // Kaiser windowed sinc, sharper mips with less aliasing
+    KAISER
+};
+
+struct MipOptions {
+    MipFilter filter;
+    // RGB are sRGB encoded colors, filtered in linear space. alpha is
+    // always linear
+    bool srgb;
+    // RGB is a tangent-space normal, renormalized in every level. implies
+    // linear filtering
+    bool normalMap;
+
+    MipOptions() : filter(MipFilter::KAISER), srgb(true), normalMap(false) {}
+};
+
+// reverses the row order in place. images decode top row first, GL
+// expects the bottom row first
+void flipVertical(unsigned char* pixels, unsigned int width, unsigned int height, unsigned int channels);
+// expands count pixels of 1 (grey), 2 (grey, alpha) or 3 (RGB) channels
+// to RGBA, alpha 255 when missing. 4 channels are copied
+void expandToRGBA(const unsigned char* source, size_t count, unsigned int channels, unsigned char* rgba);
+// multiplies RGB by alpha, rounding to nearest
+void premultiplyAlpha(unsigned char* rgba, size_t count);
+// rescales RGB, read as a [-1, 1] vector, to unit length
+void renormalizeNormals(unsigned char* rgba, size_t count);
+
+// halves an RGBA8 image to max(width / 2, 1) x max(height / 2, 1)
+void downsampleImage(const unsigned char* rgba, unsigned int width, unsigned int height, unsigned char* output,
+    const MipOptions &options);
+// the full RGBA8 mip chain of an image, level 0 being the image itself
+TextureData generateMips(const unsigned char* rgba, unsigned int width, unsigned int height,
+    const MipOptions &options = MipOptions());
\ No newline at end of file
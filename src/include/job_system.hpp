@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct Job;
+class WorkStealingDeque;
+
+// Counts unfinished jobs: every job run with a counter increments it, and
+// decrements it once it has run. Jobs can also wait for a counter to
+// reach zero before they start (see JobSystem::run).
+class JobCounter {
+public:
+    JobCounter() : pending(0) {}
+
+private:
+    friend class JobSystem;
+
+    std::atomic<unsigned int> pending;
+    // guards waiting, and the last decrement, so that wait() can't return
+    // while the job finishing last still uses the counter
+    std::mutex mutex;
+    // jobs to start once pending reaches zero
+    std::vector<Job*> waiting;
+
+    JobCounter(const JobCounter &) = delete;
+    JobCounter &operator=(const JobCounter &) = delete;
+};
+
+// Work-stealing scheduler. Each worker thread owns a deque of jobs: it
+// pushes and pops jobs at one end, lock free, while idle workers steal
+// from the other end. Jobs queued from other threads (the main thread)
+// go to a shared queue every worker also takes from. Waiting for a
+// counter runs queued jobs meanwhile, so jobs may wait for jobs they
+// started without tying up a thread.
+//
+// There is one worker per hardware thread but one: the thread that waits
+// is the last. Workers, and threads waiting for a counter, sleep when
+// there is nothing to run. Jobs are recycled, so once enough have been
+// allocated running more doesn't allocate, as long as the work's
+// captures fit in std::function's inline storage (two pointers).
+class JobSystem {
+public:
+    static JobSystem &instance();
+
+    ~JobSystem();
+
+    // queues work. counter, when given, counts it until it has run.
+    // dependency, when given, holds it back until dependency reaches zero
+    void run(std::function<void()> work, JobCounter* counter = NULL, JobCounter* dependency = NULL);
+    // runs queued jobs until counter reaches zero
+    void wait(JobCounter &counter);
+    // workers plus the waiting thread
+    unsigned int threadCount() const;
+
+private:
+    std::vector<std::unique_ptr<WorkStealingDeque>> deques;
+    std::vector<std::thread> workers;
+    // jobs queued from threads that aren't workers, or from a worker
+    // whose deque is full
+    std::deque<Job*> shared;
+    std::mutex sharedMutex;
+    // shared.size(), readable without the mutex
+    std::atomic<unsigned int> sharedCount;
+    // jobs queued and not yet taken, and threads asleep waiting for one
+    std::atomic<unsigned int> queued;
+    std::atomic<unsigned int> sleeping;
+    std::mutex sleepMutex;
+    // signalled when a job is queued, and when a counter reaches zero
+    // while a thread sleeps in wait()
+    std::condition_variable wake;
+    std::atomic<bool> stopping;
+    // finished jobs, reused by run()
+    std::vector<Job*> freeJobs;
+    std::mutex freeMutex;
+
+    JobSystem();
+    JobSystem(const JobSystem &) = delete;
+    JobSystem &operator=(const JobSystem &) = delete;
+
+    void workerLoop(unsigned int index);
+    void schedule(Job* job);
+    // takes a job from the calling worker's deque, the shared queue or
+    // another worker's deque. NULL if there is none
+    Job* take();
+    void execute(Job* job);
+    Job* allocateJob();
+    void freeJob(Job* job);
+};
\ No newline at end of file
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+
+#include "pak.hpp"
+#include "texture_data.hpp"
+
+// Khronos KTX2 containers for 2D textures with their mip chains, in any
+// TextureFormat. Files are written with a KTXorientation of "ru" since
+// levels are stored bottom row first, as they are uploaded (images are
+// decoded flipped, see decodeImage).
+//
+// Supercompressed files (Basis Universal ETC1S/UASTC, zstd, zlib) are
+// rejected: they need a transcoder this project does not ship.
+bool saveKTX2(const char* path, const TextureData &texture);
+
+// A KTX2 file mapped into memory, on its own or from a pak archive (see
+// AssetFile). Nothing is decoded or copied on the CPU: each level is
+// handed to GL straight from the mapping.
+class KTX2File {
+public:
+    KTX2File() : textureFormat(TextureFormat::RGBA8) {}
+
+    // maps and validates path. returns false if it is not a KTX2 file
+    // this loader supports
+    bool open(const char* path);
+
+    TextureFormat format() const { return textureFormat; }
+    unsigned int levelCount() const { return (unsigned int) levels.size(); }
+    unsigned int width() const { return levels.empty() ? 0 : levels[0].width; }
+    unsigned int height() const { return levels.empty() ? 0 : levels[0].height; }
+
+    // uploads levels firstLevel and up to the texture bound to
+    // GL_TEXTURE_2D, and sets its base and max level to them
+    void upload(unsigned int firstLevel = 0) const;
+    // uploads a single level, without touching the base level
+    void uploadLevel(unsigned int level) const;
+    // copies every level out of the mapping
+    void read(TextureData &texture) const;
+
+private:
+    struct Level {
+        unsigned int width;
+        unsigned int height;
+        size_t offset;
+        size_t size;
+    };
+
+    AssetFile file;
+    TextureFormat textureFormat;
+    std::vector<Level> levels;
+};
\ No newline at end of file
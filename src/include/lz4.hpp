@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// LZ4 block format (no frame header or checksums, the sizes are stored by
+// whoever stores the block). Decompression is a few bytes of work per
+// literal run or match, fast enough to beat reading the uncompressed
+// bytes from most disks.
+
+// greedy compression with a single hash table probe per position. ratios
+// are a bit below the reference compressor's fast mode. replaces output
+void compressLZ4(const unsigned char* data, size_t size, std::vector<unsigned char> &output);
+// decompresses exactly size bytes into output. returns false if the
+// block is malformed or doesn't decompress to size bytes, without ever
+// reading or writing out of bounds
+bool decompressLZ4(const unsigned char* data, size_t dataSize, unsigned char* output, size_t size);
\ No newline at end of file
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Parameters of one material, as stored in the MaterialTable
+struct Material {
+    // GL textures sampled through bindless handles, 0 if none
+    unsigned int diffuseTexture;
+    unsigned int specularTexture;
+    // texture array layers, for draws sampling arrays (see MeshBatch)
+    unsigned int diffuseLayer;
+    unsigned int specularLayer;
+    float shininess;
+};
+
+// Every material's parameters in one uniform buffer, bound once as the
+// "Materials" block of lighting.fs. Draws select their material by index,
+// a uniform int (materialIndex) or a vertex attribute in batches, instead
+// of setting each parameter and binding each texture by name.
+//
+// With ARB_bindless_texture the table also holds 64-bit texture handles,
+// so a mesh draw sets nothing but its index. Without it, materials keep
+// their texture array layers and textures come from the arrays bound per
+// MeshBatch. A uniform buffer rather than a storage buffer, since the
+// context is GL 3.3.
+class MaterialTable {
+public:
+    // 16 KB, the minimum GL_MAX_UNIFORM_BLOCK_SIZE, of 32 byte materials
+    constexpr static unsigned int maxMaterials = 512;
+    // uniform block binding point of the table
+    constexpr static unsigned int binding = 1;
+    // returned by add when the table is full
+    constexpr static unsigned int invalidIndex = ~0u;
+
+    static MaterialTable &instance();
+
+    // returns the material's index, or invalidIndex if the table is full.
+    // the textures must stay alive until remove, and are pinned by
+    // TextureManager when bindless
+    unsigned int add(const Material &material);
+    // ignores invalidIndex
+    void remove(unsigned int index);
+    // whether materials sample through bindless handles
+    bool bindless() const;
+    // uploads changed materials and binds the buffer to binding
+    void bind();
+
+private:
+    // std140 layout of lighting.fs's MaterialEntry
+    struct GPUMaterial {
+        // diffuse handle in xy, specular handle in zw
+        uint32_t handles[4];
+        // diffuse layer, specular layer, shininess, unused
+        float parameters[4];
+    };
+
+    std::vector<GPUMaterial> materials;
+    std::vector<unsigned int> freeIndices;
+    // references to each resident handle, materials can share textures
+    std::unordered_map<uint64_t, unsigned int> handleReferences;
+    unsigned int buffer;
+    // range of materials changed since the last bind
+    unsigned int dirtyBegin;
+    unsigned int dirtyEnd;
+
+    MaterialTable() : buffer(0), dirtyBegin(0), dirtyEnd(0) {}
+    MaterialTable(const MaterialTable &) = delete;
+    MaterialTable &operator=(const MaterialTable &) = delete;
+
+    uint64_t acquireHandle(unsigned int texture);
+    void releaseHandle(uint64_t handle);
+};
\ No newline at end of file
@@ -5,12 +5,15 @@
 
 #include "glm/glm.hpp"
 
-class Shader;
+#include "shader.hpp"
 
 struct Vertex {
     glm::vec3 position;
     glm::vec3 normal;
     glm::vec2 texCoords;
+    // direction of increasing u, orthogonal to the normal. w is the
+    // handedness: the bitangent is cross(normal, tangent) * w
+    glm::vec4 tangent;
 };
 
 struct Texture {
@@ -18,8 +21,7 @@ struct Texture {
     // used to index textures to texture units. in our case,
     // can only be "texture_diffuse" or "texture_specular"
     std::string type;
-    // used to skip texture loading if a texture with the same
-    // path and name is already loaded
+    // path as referenced by the material, relative to the model
     std::string path;
 };
 
@@ -28,10 +30,41 @@ public:
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
     std::vector<Texture> textures;
+    // shader permutation defines this mesh's material needs, e.g.
+    // "NO_SPECULAR_MAP" when it has no specular texture
+    ShaderDefines defines;
+    float shininess;
+    // index into MaterialTable, drawn with only a materialIndex uniform
+    // (BINDLESS_TEXTURES). -1 binds the textures by name instead
+    int material;
+    // bounding sphere in object space, computed with the mesh data (see
+    // MeshData) and set by Model
+    glm::vec3 boundsCenter;
+    float boundsRadius;
 
-    Mesh(std::vector<Vertex> inVertices, std::vector<unsigned int> inIndices, std::vector<Texture> inTextures);
+    // createBuffers false leaves the mesh CPU-only, e.g. when its vertices
+    // are merged into a MeshBatch instead
+    Mesh(std::vector<Vertex> inVertices, std::vector<unsigned int> inIndices, std::vector<Texture> inTextures, bool createBuffers = true);
+    // deletes the GL buffers. meshes are move-only, a copy would delete
+    // them a second time
+    ~Mesh();
+    Mesh(Mesh &&other) noexcept;
+    Mesh &operator=(Mesh &&other) noexcept;
+    Mesh(const Mesh &) = delete;
+    Mesh &operator=(const Mesh &) = delete;
+    // creates the GL buffers, called by the constructor unless deferred
+    void setup();
     void Draw(Shader &shader);
+    // draws only the position stream, for depth-only passes
+    void DrawDepth();
 private:
     unsigned int VAO, VBO, EBO;
-    void setup();
+    // "material." + type + number of every texture, built once so that
+    // drawing doesn't allocate strings
+    std::vector<std::string> textureUniforms;
+    // position-only vertex stream sharing the EBO. depth-only passes fetch
+    // a third of the vertex data compared to the interleaved VBO
+    unsigned int depthVAO, depthVBO;
+
+    void release();
 };
\ No newline at end of file
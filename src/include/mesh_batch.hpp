@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "shader.hpp"
+
+class Mesh;
+
+// Meshes whose textures were packed into the same texture arrays (see
+// TextureArrayPacker), merged into one vertex and index buffer and drawn
+// with a single glDrawElements. Every vertex carries the MaterialTable
+// index of its mesh's material, which the TEXTURE_ARRAYS permutation of
+// lighting.fs reads the array layers to sample from.
+class MeshBatch {
+public:
+    // TEXTURE_ARRAYS, plus NO_SPECULAR_MAP without a specular array
+    ShaderDefines defines;
+    glm::vec3 boundsCenter;
+    float boundsRadius;
+
+    // meshMaterials[i] is the MaterialTable index of meshes[i]
+    MeshBatch(const std::vector<const Mesh*> &meshes, const std::vector<unsigned int> &meshMaterials,
+        unsigned int inDiffuseArray, unsigned int inSpecularArray);
+    // deletes the merged buffers, the texture arrays belong to the Model.
+    // move-only like Mesh
+    ~MeshBatch();
+    MeshBatch(MeshBatch &&other) noexcept;
+    MeshBatch &operator=(MeshBatch &&other) noexcept;
+    MeshBatch(const MeshBatch &) = delete;
+    MeshBatch &operator=(const MeshBatch &) = delete;
+    void Draw(Shader &shader);
+    void DrawDepth();
+
+private:
+    unsigned int VAO, VBO, EBO;
+    unsigned int depthVAO, depthVBO;
+    unsigned int indexCount;
+    unsigned int diffuseArray;
+    unsigned int specularArray;
+
+    void release();
+};
\ No newline at end of file
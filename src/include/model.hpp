@@ -1,27 +1,69 @@
 #pragma once
 
+#include <memory>
 #include <string>
 #include <vector>
 
-#include "assimp/scene.h"
+#include "shader.hpp"
 
-class Shader;
+class ShaderCache;
 class Texture;
 class Mesh;
+class MeshBatch;
+struct ModelData;
 
 class Model {
 public:
-    Model(std::string path);
-    void Draw(Shader &shader);
+    // batched packs the model's textures into texture arrays and merges
+    // its meshes into as few MeshBatch draws as the arrays allow. otherwise
+    // meshes are drawn one by one, selecting their material by index when
+    // the context has bindless textures (see MaterialTable)
+    Model(std::string path, bool inBatched = false);
+    // loads several models at once: files are read and imported (or their
+    // cooked versions loaded) and textures decoded on worker threads, and
+    // only the GL textures and buffers are created on the calling thread,
+    // which owns the context
+    static std::vector<std::unique_ptr<Model>> loadAll(const std::vector<std::string> &paths, bool batched = false);
+    // releases this model's references to its textures
+    ~Model();
+    // picks, once, the permutation of the given shader matching each
+    // mesh's material on top of the scene-wide defines. call again when
+    // those change
+    void selectShaders(ShaderCache &cache, const char* vertexPath, const char* fragmentPath,
+        const ShaderDefines &defines = ShaderDefines());
+    // draws every mesh with the permutation selectShaders picked for it
+    void Draw();
+    // draws only the meshes' position streams, for depth-only passes
+    void DrawDepth();
 private:
     std::vector<Mesh> meshes;
+    std::vector<MeshBatch> batches;
+    // permutations picked by selectShaders, per batch and per mesh
+    std::vector<Shader*> batchShaders;
+    std::vector<Shader*> meshShaders;
+    // texture arrays created for batches, owned by the model
+    std::vector<unsigned int> textureArrays;
+    // MaterialTable entries added for this model
+    std::vector<unsigned int> materials;
     std::string directory;
-    std::vector<Texture> textures_loaded;
+    bool batched;
 
-    void loadModel(std::string path);
-    void processNode(aiNode* node, const aiScene* scene);
-    Mesh processMesh(aiMesh* mesh, const aiScene* scene);
-    std::vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName);
-    // stb image loading function (the same as in other chapters)
-    unsigned int textureFromFile(const char* path);
+    // textures are shared through TextureManager, copies would release
+    // them twice
+    Model(const Model &) = delete;
+    Model &operator=(const Model &) = delete;
+
+    Model(const std::string &path, ModelData &data, bool inBatched);
+
+    // the thread safe part of loading: cooked model or Assimp import
+    static bool loadModelData(const std::string &path, ModelData &data);
+    // decodes and compresses the textures of data[i], the model at
+    // paths[i], on worker threads (see TextureManager::decode). each file
+    // is decoded once, for the first model referencing it. batched models
+    // pack their own copies, so later ones get the decoded image copied
+    static void decodeTextures(const std::vector<std::string> &paths, std::vector<ModelData> &data, bool batched);
+    // creates the meshes from data, moving its vertices and indices
+    void create(const std::string &path, ModelData &data);
+    void buildBatches(ModelData &data);
+    void addBindlessMaterials();
 };
\ No newline at end of file
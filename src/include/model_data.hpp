@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "mesh.hpp"
+#include "texture_data.hpp"
+
+// CPU side of a model: what Model builds its meshes and GL buffers from,
+// either imported from the source file through Assimp or loaded from a
+// file cooked by tools/cook. Texture ids are 0, paths are relative to the
+// model's directory.
+struct MeshData {
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    std::vector<Texture> textures;
+    float shininess;
+    // bounding sphere in object space
+    glm::vec3 boundsCenter;
+    float boundsRadius;
+};
+
+struct ModelData {
+    std::vector<MeshData> meshes;
+    // normal and height maps of the materials, typed "texture_normal" and
+    // "texture_height". nothing samples them yet, but the cooker compresses
+    // them as data rather than color. not stored in cooked models
+    std::vector<Texture> dataTextures;
+    // images of the meshes' textures decoded on worker threads (see
+    // TextureManager::decode), by path. empty for textures that load
+    // without decoding
+    std::unordered_map<std::string, TextureData> textures;
+};
+
+// imports path through Assimp, converting meshes (vertex copies,
+// tangents, bounds) on parallelFor threads. optimize welds identical
+// vertices and reorders triangles and vertices for the post-transform
+// cache and vertex fetch, which takes a while: the cooker does it,
+// runtime imports of uncooked models don't. dependencies, when given,
+// receives every file Assimp read (the model, .mtl libraries, ...).
+// Thread safe, so several models can be imported at once
+bool importModel(const char* path, ModelData &model, bool optimize = false,
+    std::vector<std::string>* dependencies = NULL);
+// renumbers vertices in the order the indices first use them, dropping
+// unused ones, so vertex fetches walk the buffer forwards
+void optimizeVertexFetch(MeshData &mesh);
+// fills the vertices' tangents from their positions, normals and texture
+// coordinates
+void generateTangents(MeshData &mesh);
+
+// binary cooked model files: the vertex and index buffers as they are
+// uploaded, plus each mesh's material
+bool saveCookedModel(const char* path, const ModelData &model);
+bool loadCookedModel(const char* path, ModelData &model);
\ No newline at end of file
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "fileutil.hpp"
+
+// Pak archives: many asset files in one, so loading them costs one open
+// and one mapping instead of an open per file. A header and a table of
+// contents sorted by path hash are followed by the file names and then
+// the files' contents, every one of them aligned to pakAlignment bytes
+// within the archive. Contents are stored as is, or compressed with LZ4
+// (see lz4.hpp) or Zstandard (builds with USE_ZSTD) when that saves at
+// least an eighth of their size; tools/pack writes them.
+//
+// Paths are looked up normalized (see normalizePath): '\' separators and
+// "." and ".." components are resolved, and on windows they are
+// lowercased.
+
+enum class PakCompression : uint32_t {
+    NONE = 0,
+    LZ4 = 1,
+    ZSTD = 2
+};
+
+const size_t pakAlignment = 64;
+
+// a file to write to an archive
+struct PakSource {
+    std::string path;
+    std::vector<unsigned char> contents;
+    // stored uncompressed anyway if compressing doesn't save enough
+    PakCompression compression;
+};
+
+bool writePak(const char* path, const std::vector<PakSource> &files);
+
+struct PakEntry;
+
+// A mapped archive. Lookups only read the mapping, so any number of
+// threads can use one archive at once.
+class PakArchive {
+public:
+    PakArchive() : entries(NULL), entryCount(0), modified(-1) {}
+
+    bool open(const char* path);
+
+    // finds path in the archive. stored files point straight into the
+    // mapping, compressed ones are decompressed into decompressed, which
+    // data then points into. returns false if path isn't in the archive or
+    // fails to decompress
+    bool read(const char* path, const unsigned char* &data, size_t &size,
+        std::vector<unsigned char> &decompressed) const;
+    bool contains(const char* path) const;
+    size_t size() const;
+    // modification time of the archive file when it was opened
+    long long modifiedTime() const { return modified; }
+
+private:
+    MappedFile file;
+    // the table of contents, in the mapping
+    const PakEntry* entries;
+    unsigned int entryCount;
+    long long modified;
+
+    PakArchive(const PakArchive &) = delete;
+    PakArchive &operator=(const PakArchive &) = delete;
+
+    const PakEntry* find(const std::string &normalizedPath) const;
+};
+
+// mounts an archive for AssetFile: its files are then read from it rather
+// than from disk. archives mounted later take precedence. mount before
+// loading assets, mounting is not synchronized with reads
+bool mountPak(const char* path);
+
+// for development: loose files modified after the archive was written are
+// read instead of their archived copies, so edited sources and hot reload
+// aren't shadowed by stale ones. off by default, since it costs a stat of
+// the loose file for every asset read from an archive
+void setLooseFileOverrides(bool enabled);
+
+// The bytes of an asset: from a mounted archive if one has it (and with
+// loose file overrides, the loose file isn't newer), otherwise the loose
+// file, mapped. Either way nothing is read into memory up front unless the
+// archive stores the file compressed.
+class AssetFile {
+public:
+    AssetFile() : bytes(NULL), length(0) {}
+
+    // replaces any previously opened file. returns false if no archive has
+    // path and it can't be mapped from disk either
+    bool open(const char* path);
+    void close();
+
+    const unsigned char* data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    MappedFile file;
+    std::vector<unsigned char> decompressed;
+    const unsigned char* bytes;
+    size_t length;
+
+    AssetFile(const AssetFile &) = delete;
+    AssetFile &operator=(const AssetFile &) = delete;
+};
+
+// whether a mounted archive or the disk has path
+bool assetExists(const char* path);
\ No newline at end of file
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <functional>
+
+// Splits [0, count) into contiguous ranges of at least grain items, a few
+// per hardware thread, and runs body(begin, end) on every range as a job
+// (see JobSystem). The calling thread runs the first range itself, then
+// helps with the others and returns once all of them are done. Counts of
+// at most grain run inline. Calls from within a range nest: the outer
+// and inner ranges share the same workers.
+void parallelFor(unsigned int count, unsigned int grain, const std::function<void(unsigned int, unsigned int)> &body);
+// threads parallelFor spreads work over, the calling thread included.
+// the job system starts one worker less
+unsigned int workerCount();
\ No newline at end of file
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Time spent in the scopes of one name per frame, averaged over frames
+struct PassTiming {
+    const char* name;
+    // exponential moving averages, in milliseconds
+    double cpuMilliseconds;
+    double gpuMilliseconds;
+};
+
+// CPU and GPU timer for the passes of a frame. PROFILE_SCOPE("name")
+// measures the rest of the enclosing scope: the CPU side with a steady
+// clock, the GPU side with timestamp queries (glQueryCounter) issued when
+// the scope starts and ends. Unlike GL_TIME_ELAPSED queries, timestamps
+// let scopes nest.
+//
+// Every frame uses its own pool of queries, read queryFrames frames
+// later and only if the GPU is done with them, so profiling never waits
+// for the GPU. Frames whose results aren't ready by then are dropped.
+//
+// capture() also records every scope of the next frames, and writes them
+// as a Chrome trace (for chrome://tracing or Perfetto) with the CPU and
+// GPU on separate tracks. Main thread only, since the GPU side needs the
+// GL context.
+class Profiler {
+public:
+    static Profiler &instance();
+
+    // reads back the oldest frame in flight and starts a new one. called
+    // once at the start of every frame
+    void beginFrame();
+    // scope names must be string literals (or outlive the profiler), and
+    // are written to traces unescaped
+    void begin(const char* name);
+    void end();
+
+    // one entry per scope name seen so far, in order of first use
+    const std::vector<PassTiming> &passes() const;
+    // prints passes()
+    void print() const;
+    // records the scopes of the next frameCount frames, then writes them
+    // to path once their GPU times have been read
+    void capture(unsigned int frameCount, const char* path);
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    constexpr static unsigned int queryFrames = 4;
+
+    struct Scope {
+        const char* name;
+        Clock::time_point cpuBegin;
+        Clock::time_point cpuEnd;
+        // indices into the frame's queries
+        unsigned int gpuBegin;
+        unsigned int gpuEnd;
+    };
+
+    struct Frame {
+        std::vector<Scope> scopes;
+        // generated as needed and kept, only the first used are issued
+        std::vector<unsigned int> queries;
+        unsigned int used;
+        bool pending;
+        bool captured;
+    };
+
+    struct TraceEvent {
+        const char* name;
+        bool gpu;
+        // microseconds since the profiler started
+        double begin;
+        double duration;
+    };
+
+    Frame frames[queryFrames];
+    unsigned int frameIndex;
+    // scopes begun and not ended yet, innermost last
+    std::vector<unsigned int> open;
+    std::vector<PassTiming> timings;
+    // time of each name in the frame being read back
+    std::vector<double> frameCpu;
+    std::vector<double> frameGpu;
+    Clock::time_point start;
+    // GL_TIMESTAMP nanoseconds to add to get nanoseconds since start
+    long long gpuOffset;
+    bool calibrated;
+
+    std::vector<TraceEvent> trace;
+    std::string capturePath;
+    // frames still to record, and recorded frames still to read back
+    unsigned int captureFrames;
+    unsigned int captureInFlight;
+
+    Profiler();
+    Profiler(const Profiler &) = delete;
+    Profiler &operator=(const Profiler &) = delete;
+
+    // issues a timestamp query, returning its index in the frame's pool
+    unsigned int timestamp(Frame &frame);
+    void calibrate();
+    void collect(Frame &frame);
+    unsigned int timingIndex(const char* name);
+    void writeTrace();
+};
+
+// Profiles the scope it is declared in (see Profiler)
+class ProfileScope {
+public:
+    explicit ProfileScope(const char* name) { Profiler::instance().begin(name); }
+    ~ProfileScope() { Profiler::instance().end(); }
+
+private:
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope &operator=(const ProfileScope &) = delete;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
\ No newline at end of file
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Disk cache of linked program binaries (glGetProgramBinary/glProgramBinary).
+// Entries are keyed by the hash of the final shader sources (defines
+// included) combined with the driver's vendor, renderer and version
+// strings, so a driver update or a different GPU simply misses the cache.
+// A binary the driver rejects anyway is treated as a miss and the program
+// is compiled from source again.
+class ProgramBinaryCache {
+public:
+    // must be created with the GL context current
+    ProgramBinaryCache(const char* inDirectory);
+
+    // whether the driver supports program binaries at all
+    bool enabled() const;
+    // combines a source hash with the driver identification
+    uint64_t key(uint64_t sourceHash) const;
+    // loads the binary for key into program. returns false on a miss
+    // or when the driver refuses the binary
+    bool load(uint64_t cacheKey, unsigned int program);
+    // stores the binary of a successfully linked program
+    void save(uint64_t cacheKey, unsigned int program);
+
+private:
+    std::string directory;
+    uint64_t driverHash;
+    bool supported;
+
+    std::string pathFor(uint64_t cacheKey) const;
+};
\ No newline at end of file
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+class CommandRecorder;
+class Shader;
+class Mesh;
+
+// A single draw submitted to the RenderQueue. Either mesh is set and the
+// draw goes through Mesh::Draw, or VAO/first/count describe a non-indexed
+// glDrawArrays call using a single texture.
+struct DrawItem {
+    glm::mat4 model;
+    // object space point whose view-space depth is used as the sort key,
+    // usually the center of the object's bounds
+    glm::vec3 center;
+    // object space radius around center enclosing the draw, used to
+    // estimate its size on screen and to cull it. mesh draws use the mesh
+    // bounds instead. 0 means unknown bounds, which are never culled
+    float radius;
+    Mesh* mesh;
+    unsigned int VAO;
+    // position-only VAO used by depth-only passes
+    unsigned int depthVAO;
+    unsigned int texture;
+    int first;
+    int count;
+    // stencil write mask used while drawing this item
+    unsigned int stencilMask;
+
+    DrawItem();
+};
+
+// Collects the draws of a frame and orders them by view-space depth:
+// opaques front-to-back, so early depth testing rejects as many hidden
+// fragments as possible, and transparents back-to-front, so blending
+// composites them correctly. Depths are quantized to 16 bit keys and sorted
+// with an LSD radix sort, which is linear in the number of draws.
+class RenderQueue {
+public:
+    void clear();
+    void push(const DrawItem &item, bool transparent = false);
+    // computes the view-space depth of every draw and sorts both lists
+    void sort(const glm::mat4 &view);
+    // requests each draw's textures from the TextureManager at the
+    // resolution of the draw's projected size, assuming a texture spans
+    // its object once
+    void requestTextures(const glm::mat4 &view, const glm::mat4 &projection, int screenHeight) const;
+
+    void drawOpaque(Shader &shader);
+    // culls the opaque draws against the view frustum and records the
+    // rest with shader, in sorted order, on the job system's threads
+    void recordOpaque(CommandRecorder &recorder, Shader &shader, const glm::mat4 &viewProjection) const;
+    void drawOpaqueDepth(Shader &depthShader);
+    void drawTransparent(Shader &shader);
+
+private:
+    std::vector<DrawItem> opaque;
+    std::vector<DrawItem> transparent;
+    // sorted indices into the item lists
+    std::vector<uint32_t> opaqueOrder;
+    std::vector<uint32_t> transparentOrder;
+    // scratch buffers kept between frames so sorting does not allocate
+    std::vector<float> depths;
+    std::vector<uint32_t> keys;
+    std::vector<uint32_t> keysScratch;
+    std::vector<uint32_t> indicesScratch;
+
+    void sortItems(const std::vector<DrawItem> &items, std::vector<uint32_t> &order, const glm::mat4 &view, bool backToFront);
+    void drawItem(const DrawItem &item, Shader &shader);
+};
\ No newline at end of file
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdio>
+
+// GL work submitted during one frame
+struct FrameStats {
+    unsigned long long drawCalls;
+    unsigned long long triangles;
+    unsigned long long vertices;
+    unsigned long long programBinds;
+    unsigned long long textureBinds;
+    unsigned long long vertexArrayBinds;
+    unsigned long long uniformUpdates;
+    unsigned long long bufferUploadBytes;
+};
+
+// Counts draw calls and state changes per frame, to catch batching
+// regressions. install() replaces the glad function pointers of the
+// counted calls (draws, glUseProgram, glBindTexture, glBindVertexArray,
+// glUniform*, glBufferData and glBufferSubData) with wrappers that count
+// and forward to the driver, so every caller is covered without changes.
+//
+// Only calls made on the thread that called install() are counted, so
+// that contexts on worker threads (e.g. ShaderCompiler) don't add to the
+// frame.
+class RenderStats {
+public:
+    static RenderStats &instance();
+
+    // after gladLoadGLLoader, on the thread owning the rendering context
+    void install();
+    // the counts so far become the last frame's, and counting starts over
+    void endFrame();
+    // counts of the frame in progress
+    const FrameStats &current() const;
+    // counts of the last frame ended
+    const FrameStats &last() const;
+    // writes stats as one line of text or one JSON object
+    static void print(const FrameStats &stats, bool json, FILE* file = stdout);
+
+private:
+    FrameStats counts;
+    FrameStats lastCounts;
+
+    RenderStats();
+    RenderStats(const RenderStats &) = delete;
+    RenderStats &operator=(const RenderStats &) = delete;
+};
\ No newline at end of file
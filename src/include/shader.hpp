@@ -1,14 +1,51 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "glm/glm.hpp"
 
+// Preprocessor defines selecting a shader permutation. Every entry is
+// either "NAME" or "NAME VALUE" and becomes a "#define" line injected
+// right after the source's "#version" line.
+typedef std::vector<std::string> ShaderDefines;
+
+// IMMEDIATE compiles and links in the constructor. DEFERRED only stores
+// the paths, leaving the build to a ShaderCompiler batch.
+enum class ShaderBuild {
+    IMMEDIATE,
+    DEFERRED
+};
+
+class ProgramBinaryCache;
+
 class Shader {
 public:
     unsigned int ID;
 
-    Shader(const char* vertexPath, const char* fragmentPath);
+    Shader(const char* vertexPath, const char* fragmentPath, const ShaderDefines &inDefines = ShaderDefines(),
+        ShaderBuild build = ShaderBuild::IMMEDIATE);
+    // vertex-only program, used by depth-only passes
+    Shader(const char* vertexPath, const ShaderDefines &inDefines = ShaderDefines(),
+        ShaderBuild build = ShaderBuild::IMMEDIATE);
+
+    // the build is split in two, so a batch can submit every program to
+    // the driver before querying any status (which waits for compilation).
+    // submit() compiles and links without checking anything, isComplete()
+    // polls without blocking when KHR_parallel_shader_compile is present,
+    // and finish() checks for errors, returning whether linking succeeded.
+    void submit();
+    bool isComplete() const;
+    bool finish();
+    bool isLinked() const;
+
+    // whether path is one of this program's source files
+    bool dependsOn(const std::string &path) const;
+    // takes over the program of built (a rebuilt copy of this shader),
+    // deleting the current one and restoring every uniform value set so far
+    void replaceProgram(Shader &built);
 
     void use();
     void setBool(const char* name, bool value) const;
@@ -23,11 +60,60 @@ public:
     void setMat2(const char* name, const glm::mat2 &mat) const;
     void setMat3(const char* name, const glm::mat3 &mat) const;
     void setMat4(const char* name, const glm::mat4 &mat) const;
+
+    // reads a whole file, returning an empty string on failure
+    static std::string stringFromFile(const char* path);
+    // programs built after this call are loaded from / stored to the cache
+    static void setBinaryCache(ProgramBinaryCache* cache);
+    // binds the uniform block named block, in every program linked after
+    // this call that declares it, to the given binding point. GLSL 3.30
+    // has no layout(binding) qualifier for blocks
+    static void setUniformBlockBinding(const std::string &block, unsigned int binding);
 private:
-    const char* vertexSourcePath;
-    const char* fragmentSourcePath;
+    enum class UniformType {
+        INT,
+        FLOAT,
+        VEC2,
+        VEC3,
+        VEC4,
+        MAT2,
+        MAT3,
+        MAT4
+    };
+
+    // last value set for a uniform, so locations are only looked up once,
+    // redundant updates are skipped, and values survive program reloads
+    struct Uniform {
+        std::string name;
+        int location;
+        UniformType type;
+        size_t size;
+        unsigned char value[sizeof(glm::mat4)];
+    };
+
+    std::string vertexSourcePath;
+    // empty for vertex-only programs
+    std::string fragmentSourcePath;
+    ShaderDefines defines;
+
+    // state between submit() and finish()
+    unsigned int vertexShader;
+    unsigned int fragmentShader;
+    uint64_t binaryCacheKey;
+    bool fromBinaryCache;
+    bool linked;
+
+    // set* are const, but caching what they set is not observable state
+    mutable std::unordered_map<uint64_t, Uniform> uniforms;
+
+    static ProgramBinaryCache* binaryCache;
+    static std::unordered_map<std::string, unsigned int> uniformBlockBindings;
 
-    std::string stringFromFile(const char* path);
+    void setUniform(const char* name, UniformType type, const void* value, size_t size) const;
+    void uploadUniform(const Uniform &uniform) const;
+    void bindUniformBlocks() const;
+    unsigned int compileShader(unsigned int type, const std::string &code);
+    std::string injectDefines(const std::string &source);
     void checkShaderCompileErrors(unsigned int shader, const char* path);
-    void checkProgramLinkErrors(unsigned int program);
+    bool checkProgramLinkErrors(unsigned int program);
 };
\ No newline at end of file
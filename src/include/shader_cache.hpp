@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "shader.hpp"
+
+// Compiles shader permutations on demand and keeps them around. Programs
+// are keyed by the hash of both source files' contents plus the define
+// set, in any order, so requesting the same permutation twice returns the
+// same program, and the compiler strips the branches a permutation
+// disables.
+class ShaderCache {
+public:
+    ShaderCache() {}
+    // deletes every program, references returned by get() dangle after
+    ~ShaderCache();
+
+    // returns the program for this file pair and define set, compiling it
+    // the first time it is requested. meant for load time rather than per
+    // draw: it hashes the defines every call
+    Shader &get(const char* vertexPath, const char* fragmentPath, const ShaderDefines &defines = ShaderDefines());
+
+    // every compiled permutation, e.g. to set per-frame uniforms on all of them
+    std::vector<Shader*> &programs();
+
+private:
+    std::unordered_map<uint64_t, Shader*> programsByKey;
+    std::vector<Shader*> programList;
+    // content hash of every source file read so far, by hash of its path
+    std::unordered_map<uint64_t, uint64_t> fileHashes;
+
+    ShaderCache(const ShaderCache &) = delete;
+    ShaderCache &operator=(const ShaderCache &) = delete;
+
+    uint64_t fileHash(const char* path);
+};
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+struct GLFWwindow;
+class Shader;
+
+// Builds a batch of programs (created with ShaderBuild::DEFERRED)
+// concurrently. Every program is submitted to the driver before any status
+// is queried, so drivers that compile in the background can work on all
+// of them at once, and with KHR_parallel_shader_compile the results are
+// polled instead of waited on one by one.
+//
+// When created with the application window, the batch can also run on a
+// worker thread owning a hidden window whose context shares objects with
+// the main one, so the main thread keeps loading other assets meanwhile.
+// The window is created by the first start() and kept for later batches,
+// so a compiler can be reused for any number of them.
+class ShaderCompiler {
+public:
+    // sharedWindow is needed for start(), it may be NULL for compile()
+    ShaderCompiler(GLFWwindow* inSharedWindow = NULL);
+    // waits for a running batch and destroys the hidden window, so it
+    // must run on the main thread
+    ~ShaderCompiler();
+
+    // the shader must stay alive (and in place) until the batch finishes
+    void add(Shader &shader);
+    // builds the whole batch on the calling thread. returns false if any
+    // program failed to link
+    bool compile();
+    // builds the whole batch on a worker thread. must be called from the
+    // main thread, since it creates the worker's hidden window
+    void start();
+    // whether the batch started by start() has finished, without blocking
+    bool done() const;
+    // waits for start() to finish. returns false if any program failed to link
+    bool wait();
+
+private:
+    GLFWwindow* sharedWindow;
+    GLFWwindow* workerWindow;
+    std::thread worker;
+    std::vector<Shader*> shaders;
+    bool success;
+    std::atomic<bool> finished;
+
+    void run();
+
+    ShaderCompiler(const ShaderCompiler &) = delete;
+    ShaderCompiler &operator=(const ShaderCompiler &) = delete;
+};
\ No newline at end of file
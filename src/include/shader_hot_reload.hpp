@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vector>
+
+#include "file_watcher.hpp"
+#include "shader_compiler.hpp"
+
+struct GLFWwindow;
+class Shader;
+
+// Watches a shader directory and rebuilds the programs whose sources
+// change, without stalling the render loop: rebuilds run in a
+// ShaderCompiler batch on a worker context and update() only polls for
+// them. A rebuilt program replaces the live one only if it linked, so a
+// typo leaves the last working version on screen. Uniform values set on
+// the old program carry over (see Shader::replaceProgram).
+class ShaderHotReload {
+public:
+    ShaderHotReload(const char* directory, GLFWwindow* inSharedWindow);
+    ~ShaderHotReload();
+
+    // the shader must outlive the hot reload
+    void add(Shader &shader);
+    // call once per frame from the main thread
+    void update();
+
+private:
+    struct Rebuild {
+        Shader* live;
+        Shader* staging;
+    };
+
+    FileWatcher watcher;
+    std::vector<Shader*> shaders;
+    // shaders waiting for the running batch to finish
+    std::vector<Shader*> queued;
+    // the running batch, empty when there is none
+    std::vector<Rebuild> building;
+    // reused for every batch, with its worker context
+    ShaderCompiler compiler;
+
+    void startBatch();
+    void finishBatch();
+
+    ShaderHotReload(const ShaderHotReload &) = delete;
+    ShaderHotReload &operator=(const ShaderHotReload &) = delete;
+};
\ No newline at end of file
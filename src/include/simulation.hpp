@@ -0,0 +1,78 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "camera.hpp"
+
+// The state the renderer needs from one simulation step. Snapshots are
+// published whole and never modified afterwards, so the render thread
+// reads them without holding anything the simulation waits on.
+struct FrameSnapshot {
+    unsigned long long step;
+    glm::vec3 cameraPosition;
+    glm::vec3 cameraWorldUp;
+    float cameraYaw;
+    float cameraPitch;
+    float cameraZoom;
+
+    // a camera at the snapshot's position and orientation
+    Camera camera() const;
+};
+
+// Runs the scene update (for now the camera) on its own thread, at a
+// fixed timestep that doesn't depend on how long frames take to render.
+//
+// Input is still polled by the main thread (GLFW requires it) and handed
+// over through the set*/add* members; held keys are sampled every step,
+// mouse and scroll offsets accumulate until the next step consumes them.
+// The render thread calls interpolate() once per frame, which blends the
+// two latest snapshots by how far the clock is into the current step, so
+// movement stays smooth at any frame rate, one step behind the simulation.
+class Simulation {
+public:
+    Simulation(const Camera &inCamera, double stepSeconds = 1.0 / 120.0);
+    ~Simulation();
+
+    void start();
+    void stop();
+
+    void setKey(CameraMovement movement, bool pressed);
+    void addMouseMovement(float xOffset, float yOffset);
+    void addMouseScroll(float yOffset);
+
+    // the scene as of now, between the two latest snapshots
+    FrameSnapshot interpolate();
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Input {
+        bool keys[(int) CameraMovement::SIZE];
+        float mouseX;
+        float mouseY;
+        float scroll;
+    };
+
+    Camera camera;
+    Clock::duration step;
+    std::thread worker;
+    std::mutex mutex;
+    // signalled by stop(), so a sleeping worker wakes up immediately
+    std::condition_variable stopped;
+    bool running;
+    Input input;
+    FrameSnapshot previous;
+    FrameSnapshot current;
+    // when current was produced
+    Clock::time_point currentTime;
+
+    Simulation(const Simulation &) = delete;
+    Simulation &operator=(const Simulation &) = delete;
+
+    void run();
+    void update(const Input &stepInput);
+    FrameSnapshot capture(unsigned long long stepIndex) const;
+};
\ No newline at end of file
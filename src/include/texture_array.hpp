@@ -0,0 +1,58 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "texture_data.hpp"
+
+// Packs textures into GL_TEXTURE_2D_ARRAY layers at import time. Textures
+// sharing format, size and mip count end up in the same array, so draws
+// using any of them can sample the array with a layer index instead of
+// binding a different texture each.
+class TextureArrayPacker {
+public:
+    // arrays are split beyond this many layers, the minimum GL 3.3
+    // guarantees for GL_MAX_ARRAY_TEXTURE_LAYERS
+    constexpr static unsigned int maxLayers = 256;
+
+    // loads path through TextureManager::loadData, once however often it
+    // is added, or takes decoded (see TextureManager::decode) when it
+    // holds the image already. returns a handle for array() and layer(),
+    // -1 on failure
+    int add(const std::string &path, TextureData* decoded = NULL);
+    // a 1x1 RGBA8 layer of a single color, for meshes missing a texture.
+    // added once per color
+    int addColor(unsigned char r, unsigned char g, unsigned char b, unsigned char a);
+    // creates and uploads the arrays and frees the CPU copies
+    void build();
+
+    // GL texture array of a handle, valid after build()
+    unsigned int array(int handle) const;
+    unsigned int layer(int handle) const;
+    // every array created by build(), owned by the caller
+    const std::vector<unsigned int> &arrays() const { return arrayIds; }
+
+private:
+    struct Group {
+        TextureFormat format;
+        unsigned int width;
+        unsigned int height;
+        unsigned int levels;
+        std::vector<TextureData> layers;
+    };
+
+    struct Slot {
+        unsigned int group;
+        unsigned int layer;
+    };
+
+    std::vector<Group> groups;
+    std::vector<Slot> slots;
+    std::unordered_map<std::string, int> handles;
+    std::vector<unsigned int> arrayIds;
+
+    // places texture in a group of matching format and size, taking its
+    // levels
+    int insert(const std::string &key, TextureData &texture);
+};
\ No newline at end of file
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "image_processing.hpp"
+#include "texture_data.hpp"
+
+// CPU block compression. The encoders fit each 4x4 block's endpoints to
+// the (slightly inset) bounding box of its colors and pick the nearest
+// palette entry per pixel. Where SSE2 is available, the bounds are taken a
+// row of the block at a time and the nearest entries are found for a row
+// of pixels (BC1) or the whole block (BC4) at once; endpoint fitting
+// stays scalar. Input is always tightly packed RGBA8; partial blocks at
+// the right and bottom edges repeat the last row/column.
+
+// BC1: RGB, alpha ignored. 8 bytes per block
+void compressBC1(const unsigned char* rgba, unsigned int width, unsigned int height, unsigned char* output);
+// BC3: BC1 color plus a BC4 encoded alpha channel. 16 bytes per block
+void compressBC3(const unsigned char* rgba, unsigned int width, unsigned int height, unsigned char* output);
+// BC4: red channel only. 8 bytes per block
+void compressBC4(const unsigned char* rgba, unsigned int width, unsigned int height, unsigned char* output);
+// BC5: red and green channels as two BC4 blocks, for tangent-space normal
+// maps (the shader reconstructs z). 16 bytes per block
+void compressBC5(const unsigned char* rgba, unsigned int width, unsigned int height, unsigned char* output);
+
+// builds the full mip chain of an RGBA8 image (see generateMips) and
+// compresses every level to format (BC1, BC3, BC4, BC5), bands of block
+// rows on all hardware threads. RGBA8 keeps it uncompressed, and R8 keeps
+// only the red channel
+TextureData compressTexture(const unsigned char* rgba, unsigned int width, unsigned int height, TextureFormat format,
+    const MipOptions &options = MipOptions());
+// what an image holds, which decides how its mips are filtered and how it
+// is compressed
+enum class TextureUsage {
+    // sRGB colors: BC1 (RGB), BC3 (RGBA), or BC4 for single channel images
+    // (masks), which are linear. uncompressed, single channel images stay
+    // R8 and the others are RGBA8
+    COLOR,
+    // tangent-space normals: linear, renormalized in every mip, BC5
+    NORMAL_MAP,
+    // heights: linear, BC4 (R8 uncompressed). images with color channels
+    // are taken for normal maps, since OBJ materials reference those as
+    // bump maps too
+    HEIGHT_MAP
+};
+
+// decodes an image file (see decodeImageFile) and builds its mip chain,
+// compressed as usage says if compress is set
+bool importTexture(const char* path, bool compress, TextureData &texture, TextureUsage usage = TextureUsage::COLOR);
\ No newline at end of file
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Pixel formats textures can be stored and uploaded in. The block
+// compressed formats encode 4x4 pixel blocks in 8 or 16 bytes:
+// BC1 (RGB, 8 bytes), BC3 (RGBA, 16), BC4 (R, 8), BC5 (RG, 16, for
+// normal maps), BC7 (RGBA, 16, high quality) and ETC2 (RGB 8 / RGBA 16).
+enum class TextureFormat {
+    R8,
+    RGB8,
+    RGBA8,
+    BC1,
+    BC3,
+    BC4,
+    BC5,
+    BC7,
+    ETC2_RGB,
+    ETC2_RGBA
+};
+
+struct TextureLevel {
+    unsigned int width;
+    unsigned int height;
+    std::vector<unsigned char> data;
+};
+
+// A texture with its complete (or partial) mip chain, level 0 first.
+struct TextureData {
+    TextureFormat format;
+    std::vector<TextureLevel> levels;
+};
+
+bool isCompressed(TextureFormat format);
+// bytes per 4x4 block for compressed formats, bytes per pixel otherwise
+unsigned int formatBlockBytes(TextureFormat format);
+size_t levelSize(TextureFormat format, unsigned int width, unsigned int height);
+// number of levels in a full mip chain down to 1x1
+unsigned int mipLevelCount(unsigned int width, unsigned int height);
+// GL internal format enum for glTexImage2D / glCompressedTexImage2D
+unsigned int glInternalFormat(TextureFormat format);
+// whether the current context can sample this format
+bool isFormatSupported(TextureFormat format);
+// uploads one level of the texture bound to GL_TEXTURE_2D from data
+void uploadTextureLevel(TextureFormat format, unsigned int level, unsigned int width, unsigned int height,
+    const unsigned char* data, size_t size);
+// allocates the texture array bound to GL_TEXTURE_2D_ARRAY with one layer
+// per texture and uploads them. all layers must share format, size and
+// level count
+void uploadTextureArray(const std::vector<const TextureData*> &layers);
+// uploads every level to the texture bound to GL_TEXTURE_2D and limits
+// GL_TEXTURE_MAX_LEVEL to the levels present, so a partial chain is
+// still mipmap complete
+void uploadTexture(const TextureData &texture);
\ No newline at end of file
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+
+#include "texture_data.hpp"
+
+class KTX2File;
+
+// Owns every texture loaded from disk. Each file is decoded and uploaded
+// once, no matter how many models or materials reference it: entries are
+// keyed by canonical absolute path in a hash map and reference counted,
+// and the GL texture is deleted when the last reference is released.
+//
+// A .dds next to an image (container.dds for container.jpg) is used
+// instead of it when the context supports its format; these are written
+// offline by tools/compress_textures. Otherwise images can be compressed
+// at load time (see setCompression), which costs load time but cuts
+// VRAM and sampling bandwidth 4-8x.
+//
+// With a cache directory, decoded images are stored there as KTX2 with
+// their whole mip chain (compressed or not), keyed by path and
+// modification time. Later runs map the KTX2 file and upload it level by
+// level: no JPEG/PNG decoding, mip filtering or block compression.
+// Textures cooked offline (make cook, see CookedAssets) are used the same
+// way, ahead of the cache.
+//
+// Textures backed by a cached KTX2 file are also streamed: they start
+// with only their small levels resident, and each frame update() uploads
+// the finer levels draws asked for (see request) while the total stays
+// under the memory budget. Levels of textures that are far away or were
+// not drawn recently are released again to make room; GL_TEXTURE_BASE_LEVEL
+// keeps sampling to the levels actually present. Other textures (.dds,
+// no cache) are counted against the budget but always fully resident.
+class TextureManager {
+public:
+    static TextureManager &instance();
+
+    // returns the texture for path, loading it on first use. every
+    // acquire must be paired with a release of the returned id. decoded,
+    // when given, is what decode() produced for path, and is uploaded
+    // (and taken) instead of decoding path again
+    unsigned int acquire(const char* path, TextureData* decoded = NULL);
+    void release(unsigned int id);
+    // whether path is loaded, so acquiring it wouldn't decode anything
+    bool loaded(const char* path) const;
+    // loads path with its whole mip chain, the way acquire would (.dds,
+    // cache, compression) but without creating a GL texture. used to pack
+    // textures into arrays
+    bool loadData(const char* path, TextureData &texture);
+    // the CPU side of a first load, for worker threads: decodes path,
+    // builds its mips, compresses them and writes the cache, so that only
+    // the upload is left to acquire. leaves texture empty if path loads
+    // without decoding (.dds, cooked or cached). unlike everything else
+    // here it is thread safe, as long as the settings don't change
+    void decode(const char* path, TextureData &texture) const;
+
+    // uploads every level of a streamed texture and stops streaming it,
+    // for textures that must not be respecified anymore (bindless handles)
+    void pin(unsigned int id);
+
+    // number of distinct textures currently loaded
+    size_t size() const;
+
+    // compress decoded images to BC1 (RGB), BC3 (RGBA) or BC4 (R) at load
+    // time. ignored when the context lacks S3TC. off by default
+    void setCompression(bool enabled);
+    // where decoded textures are cached, created on first write. empty
+    // (the default) disables the cache
+    void setCacheDirectory(const std::string &directory);
+
+    // asks for the mip level that gives texture id about pixels texels
+    // across, e.g. the size of the object it is drawn on in pixels
+    void request(unsigned int id, float pixels);
+    // streams levels in and out based on this frame's requests. call once
+    // per frame, after the requests
+    void update();
+    // texture memory to stay under, in bytes. 256 MB by default
+    void setBudget(size_t bytes);
+    // estimated video memory used by all textures, in bytes
+    size_t residentBytes() const;
+
+private:
+    // levels of at most this size are always resident
+    constexpr static unsigned int minimumResidentSize = 64;
+    // at most this many levels are uploaded per update
+    constexpr static unsigned int uploadsPerFrame = 4;
+
+    struct Entry {
+        unsigned int id;
+        unsigned int references;
+        TextureFormat format;
+        unsigned int width;
+        unsigned int height;
+        unsigned int levels;
+        // finest resident level, the ones above it are released
+        unsigned int baseLevel;
+        // level the draws of the last update asked for
+        unsigned int targetLevel;
+        // finest level requested since the last update, levels if none
+        unsigned int requestedLevel;
+        unsigned int lastRequested;
+        // mapped KTX2 file levels stream from. NULL if always resident
+        KTX2File* source;
+    };
+
+    std::unordered_map<std::string, Entry> entries;
+    // reverse lookup for release()
+    std::unordered_map<unsigned int, std::string> pathsById;
+    bool compression;
+    std::string cacheDirectory;
+    size_t budget;
+    size_t resident;
+    unsigned int frame;
+
+    TextureManager() : compression(false), budget(256u << 20), resident(0), frame(0) {}
+    TextureManager(const TextureManager &) = delete;
+    TextureManager &operator=(const TextureManager &) = delete;
+
+    void load(const char* path, Entry &entry, TextureData* decoded);
+    bool loadPrecompressed(const char* path, TextureData &texture);
+    // the .dds loadPrecompressed looks for
+    static std::string precompressedPath(const char* path);
+    std::string cacheFilePath(const char* path) const;
+    // opens the up to date cooked file for path, see CookedAssets
+    bool openCooked(const char* path, KTX2File &file) const;
+    bool compressing() const;
+
+    size_t levelBytes(const Entry &entry, unsigned int level) const;
+    size_t entryBytes(const Entry &entry) const;
+    // coarsest level that is still streamed, see minimumResidentSize
+    unsigned int streamingFloor(const Entry &entry) const;
+    Entry* evictionCandidate(const Entry* except);
+    Entry* largestStreamed();
+    void raiseLevel(Entry &entry);
+    void dropLevel(Entry &entry);
+};
\ No newline at end of file
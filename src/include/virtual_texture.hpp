@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "glad/glad.h"
+
+#include "arena.hpp"
+#include "fileutil.hpp"
+
+class Shader;
+
+// Virtual texturing: textures far larger than the VRAM they may use.
+//
+// Every image is cut once into pages (pageSize texels plus a border, for
+// every mip level) stored in a page file on disk. Only the pages the
+// camera actually samples are kept on the GPU, in one fixed size page
+// cache texture. Which pages those are is measured by a feedback pass
+// that renders the virtually textured objects into a small buffer, each
+// fragment writing the page and level it needs, and is read back
+// asynchronously a few frames later. Missing pages are streamed in from
+// the mapped page files (coarsest first, a few per frame) replacing the
+// least recently used ones, and each texture's indirection table maps
+// its pages to cache slots, pointing at the nearest resident coarser
+// page while a page is still missing. The coarsest level of every
+// texture fits in one page and is always resident.
+//
+// Shaders sample with virtual_texture.fs (VT_FEEDBACK defined for the
+// feedback pass). Pages are addressed with 8 bits per axis, which limits
+// textures to 256 pages, 32768 texels, per side.
+class VirtualTextureSystem {
+public:
+    constexpr static unsigned int pageSize = 128;
+    constexpr static unsigned int pageBorder = 4;
+    // feedback is rendered at 1/feedbackDivisor of the screen resolution
+    constexpr static unsigned int feedbackDivisor = 8;
+
+    // cacheSlots: pages per side of the page cache, which holds
+    // cacheSlots² pages and is all the VRAM page data ever uses.
+    // pageFileDirectory: where page files are built, created on first use
+    VirtualTextureSystem(const std::string &pageFileDirectory, unsigned int cacheSlots = 16,
+        unsigned int uploadsPerFrame = 16);
+    ~VirtualTextureSystem();
+
+    // registers an image, building its page file on first use. returns
+    // the id passed to bind, 0 if the image can't be loaded
+    unsigned int add(const char* imagePath);
+
+    // reads back the newest finished feedback, streams the missing pages
+    // in and updates the indirection tables
+    void update();
+
+    // renders into the feedback buffer until endFeedback. every virtually
+    // textured object must be drawn in between with the VT_FEEDBACK shader,
+    // after the other opaque objects were drawn depth only so that pages
+    // they hide aren't requested
+    void beginFeedback(int screenWidth, int screenHeight);
+    // starts the asynchronous read back and restores the default framebuffer
+    void endFeedback();
+
+    // binds the page cache (unit 0) and the indirection table of texture
+    // (unit 1), and sets the uniforms of virtual_texture.fs
+    void bind(Shader &shader, unsigned int texture, bool feedback = false) const;
+
+    unsigned int cacheTexture() const { return cache; }
+    size_t residentPages() const { return residents.size(); }
+
+private:
+    // frames between a feedback pass and its read back
+    constexpr static unsigned int feedbackFrames = 3;
+
+    struct VirtualTexture {
+        MappedFile pages;
+        unsigned int width;
+        unsigned int height;
+        unsigned int levels;
+        // index of the first page of each level in the page file
+        std::vector<size_t> firstPage;
+        std::vector<unsigned int> pagesX;
+        std::vector<unsigned int> pagesY;
+        unsigned int indirection;
+        unsigned int indirectionWidth;
+        unsigned int indirectionHeight;
+        bool dirty;
+    };
+
+    struct Resident {
+        unsigned int slot;
+        unsigned int lastUsed;
+        // the coarsest page of each texture is never evicted
+        bool pinned;
+        std::list<uint32_t>::iterator position;
+    };
+
+    struct FeedbackFrame {
+        unsigned int buffer;
+        GLsync fence;
+        unsigned int sequence;
+        int width;
+        int height;
+    };
+
+    std::string directory;
+    unsigned int slots;
+    unsigned int uploadsPerFrame;
+    unsigned int cache;
+    std::vector<VirtualTexture*> textures;
+
+    // page key (see pageKey) -> cache slot. lru holds the keys of the
+    // evictable pages, most recently used first
+    std::unordered_map<uint32_t, Resident> residents;
+    std::list<uint32_t> lru;
+    std::vector<unsigned int> freeSlots;
+    unsigned int frame;
+
+    unsigned int feedbackFramebuffer;
+    unsigned int feedbackColor;
+    unsigned int feedbackDepth;
+    int feedbackWidth;
+    int feedbackHeight;
+    int screenWidth;
+    int screenHeight;
+    FeedbackFrame feedback[feedbackFrames];
+    unsigned int feedbackIndex;
+    unsigned int feedbackSequence;
+
+    VirtualTextureSystem(const VirtualTextureSystem &) = delete;
+    VirtualTextureSystem &operator=(const VirtualTextureSystem &) = delete;
+
+    static uint32_t pageKey(unsigned int texture, unsigned int level, unsigned int x, unsigned int y);
+    bool readFeedback(ArenaVector<uint32_t> &requests);
+    void touch(uint32_t key);
+    bool makeResident(uint32_t key, bool pinned);
+    void updateIndirection(unsigned int texture);
+};
\ No newline at end of file
@@ -0,0 +1,262 @@
+#include "job_system.hpp"
+
+#include <algorithm>
+
+#include "parallel.hpp"
+
+struct Job {
+    std::function<void()> work;
+    JobCounter* counter;
+};
+
+// Chase-Lev deque (Le, Pop, Cohen and Zappa Nardelli, "Correct and
+// Efficient Work-Stealing for Weak Memory Models"), with a fixed capacity.
+// The owner pushes and pops at the bottom, thieves take from the top, and
+// only taking the last job needs a compare and swap.
+class WorkStealingDeque {
+public:
+    WorkStealingDeque() : top(0), bottom(0) {
+        for (unsigned int i = 0 ; i < capacity ; i++) {
+            jobs[i].store(NULL, std::memory_order_relaxed);
+        }
+    }
+
+    // owner only. false if the deque is full
+    bool push(Job* job) {
+        long long b = bottom.load(std::memory_order_relaxed);
+        long long t = top.load(std::memory_order_acquire);
+        if (b - t >= (long long) capacity)
+            return false;
+        jobs[b & mask].store(job, std::memory_order_relaxed);
+        bottom.store(b + 1, std::memory_order_release);
+        return true;
+    }
+
+    // owner only
+    Job* pop() {
+        long long b = bottom.load(std::memory_order_relaxed) - 1;
+        // seq_cst store then load: a thief can't miss the reservation
+        // while this misses its steal
+        bottom.store(b, std::memory_order_seq_cst);
+        long long t = top.load(std::memory_order_seq_cst);
+        if (t > b) {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return NULL;
+        }
+        Job* job = jobs[b & mask].load(std::memory_order_relaxed);
+        if (t == b) {
+            // the last job, which a thief may be taking too
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                job = NULL;
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return job;
+    }
+
+    // any thread
+    Job* steal() {
+        long long t = top.load(std::memory_order_seq_cst);
+        long long b = bottom.load(std::memory_order_seq_cst);
+        if (t >= b)
+            return NULL;
+        Job* job = jobs[t & mask].load(std::memory_order_relaxed);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return NULL;
+        return job;
+    }
+
+private:
+    static const unsigned int capacity = 4096;
+    static const long long mask = capacity - 1;
+
+    std::atomic<long long> top;
+    std::atomic<long long> bottom;
+    std::atomic<Job*> jobs[capacity];
+};
+
+// index of the calling thread's deque, -1 on threads that aren't workers
+static thread_local int workerIndex = -1;
+
+JobSystem &JobSystem::instance() {
+    static JobSystem system;
+    return system;
+}
+
+JobSystem::JobSystem() : sharedCount(0), queued(0), sleeping(0), stopping(false) {
+    unsigned int count = workerCount() - 1;
+    for (unsigned int i = 0 ; i < count ; i++) {
+        deques.push_back(std::unique_ptr<WorkStealingDeque>(new WorkStealingDeque()));
+    }
+    for (unsigned int i = 0 ; i < count ; i++) {
+        workers.push_back(std::thread(&JobSystem::workerLoop, this, i));
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> guard(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (unsigned int i = 0 ; i < workers.size() ; i++) {
+        workers[i].join();
+    }
+
+    // jobs nobody ran. the workers are gone, so stealing is safe from here
+    Job* job;
+    while ((job = take()) != NULL) {
+        delete job;
+    }
+    for (unsigned int i = 0 ; i < freeJobs.size() ; i++) {
+        delete freeJobs[i];
+    }
+}
+
+void JobSystem::run(std::function<void()> work, JobCounter* counter, JobCounter* dependency) {
+    Job* job = allocateJob();
+    job->work = std::move(work);
+    job->counter = counter;
+    if (counter != NULL)
+        counter->pending++;
+
+    if (dependency != NULL) {
+        std::lock_guard<std::mutex> guard(dependency->mutex);
+        if (dependency->pending > 0) {
+            dependency->waiting.push_back(job);
+            return;
+        }
+    }
+    schedule(job);
+}
+
+void JobSystem::wait(JobCounter &counter) {
+    while (counter.pending > 0) {
+        Job* job = take();
+        if (job != NULL) {
+            execute(job);
+            continue;
+        }
+
+        // nothing left to help with: sleep until the counter's last job
+        // finishes, or another job is queued. counted as sleeping like
+        // workers, so execute() can't miss notifying either
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleeping++;
+        wake.wait(lock, [&]() { return counter.pending == 0 || queued > 0 || stopping; });
+        sleeping--;
+    }
+    // the job that finished last may still hold the mutex
+    std::lock_guard<std::mutex> guard(counter.mutex);
+}
+
+unsigned int JobSystem::threadCount() const {
+    return (unsigned int) workers.size() + 1;
+}
+
+void JobSystem::workerLoop(unsigned int index) {
+    workerIndex = (int) index;
+    while (true) {
+        Job* job = take();
+        if (job != NULL) {
+            execute(job);
+            continue;
+        }
+
+        // sleeping is counted before queued is checked, and run() checks
+        // sleeping after counting a job, so a wake up can't be missed
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleeping++;
+        wake.wait(lock, [&]() { return queued > 0 || stopping; });
+        sleeping--;
+        if (stopping)
+            return;
+    }
+}
+
+void JobSystem::schedule(Job* job) {
+    queued++;
+    if (workerIndex < 0 || !deques[(unsigned int) workerIndex]->push(job)) {
+        std::lock_guard<std::mutex> guard(sharedMutex);
+        shared.push_back(job);
+        sharedCount++;
+    }
+    if (sleeping > 0) {
+        // taking the mutex orders this after a worker about to sleep
+        // started waiting
+        { std::lock_guard<std::mutex> guard(sleepMutex); }
+        wake.notify_one();
+    }
+}
+
+Job* JobSystem::take() {
+    if (queued == 0)
+        return NULL;
+
+    Job* job = NULL;
+    if (workerIndex >= 0)
+        job = deques[(unsigned int) workerIndex]->pop();
+    if (job == NULL && sharedCount > 0) {
+        std::lock_guard<std::mutex> guard(sharedMutex);
+        if (!shared.empty()) {
+            job = shared.front();
+            shared.pop_front();
+            sharedCount--;
+        }
+    }
+    // other workers, starting from the next one so that thieves spread out
+    unsigned int start = workerIndex >= 0 ? (unsigned int) workerIndex + 1 : 0;
+    for (unsigned int i = 0 ; job == NULL && i < deques.size() ; i++) {
+        unsigned int victim = (start + i) % (unsigned int) deques.size();
+        if ((int) victim != workerIndex)
+            job = deques[victim]->steal();
+    }
+    if (job != NULL)
+        queued--;
+    return job;
+}
+
+void JobSystem::execute(Job* job) {
+    job->work();
+
+    JobCounter* counter = job->counter;
+    freeJob(job);
+    if (counter == NULL)
+        return;
+    // swapping an empty list would only take away the counter's buffer
+    std::vector<Job*> released;
+    bool finished;
+    {
+        std::lock_guard<std::mutex> guard(counter->mutex);
+        finished = --counter->pending == 0;
+        if (finished && !counter->waiting.empty())
+            released.swap(counter->waiting);
+    }
+    for (unsigned int i = 0 ; i < released.size() ; i++) {
+        schedule(released[i]);
+    }
+    // wakes a thread sleeping in wait() for the counter, which must not be
+    // touched anymore. workers woken too go back to sleep
+    if (finished && sleeping > 0) {
+        { std::lock_guard<std::mutex> guard(sleepMutex); }
+        wake.notify_all();
+    }
+}
+
+Job* JobSystem::allocateJob() {
+    {
+        std::lock_guard<std::mutex> guard(freeMutex);
+        if (!freeJobs.empty()) {
+            Job* job = freeJobs.back();
+            freeJobs.pop_back();
+            return job;
+        }
+    }
+    return new Job();
+}
+
+void JobSystem::freeJob(Job* job) {
+    // drops the captures now rather than when the job is reused
+    job->work = nullptr;
+    std::lock_guard<std::mutex> guard(freeMutex);
+    freeJobs.push_back(job);
+}
\ No newline at end of file
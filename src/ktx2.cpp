@@ -0,0 +1,379 @@
+#include "ktx2.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "glad/glad.h"
+
+struct KTX2Header {
+    unsigned char identifier[12];
+    uint32_t vkFormat;
+    uint32_t typeSize;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t layerCount;
+    uint32_t faceCount;
+    uint32_t levelCount;
+    uint32_t supercompressionScheme;
+    uint32_t dfdByteOffset;
+    uint32_t dfdByteLength;
+    uint32_t kvdByteOffset;
+    uint32_t kvdByteLength;
+    uint64_t sgdByteOffset;
+    uint64_t sgdByteLength;
+};
+
+struct KTX2LevelIndex {
+    uint64_t byteOffset;
+    uint64_t byteLength;
+    uint64_t uncompressedByteLength;
+};
+
+static const unsigned char ktx2Identifier[12] = {
+    0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'
+};
+
+// VkFormat values
+static const uint32_t vkFormatR8 = 9;
+static const uint32_t vkFormatRGB8 = 23;
+static const uint32_t vkFormatRGBA8 = 37;
+static const uint32_t vkFormatRGBA8sRGB = 43;
+static const uint32_t vkFormatBC1 = 131;
+static const uint32_t vkFormatBC1sRGB = 132;
+static const uint32_t vkFormatBC3 = 137;
+static const uint32_t vkFormatBC3sRGB = 138;
+static const uint32_t vkFormatBC4 = 139;
+static const uint32_t vkFormatBC5 = 141;
+static const uint32_t vkFormatBC7 = 145;
+static const uint32_t vkFormatBC7sRGB = 146;
+static const uint32_t vkFormatETC2RGB = 147;
+static const uint32_t vkFormatETC2RGBsRGB = 148;
+static const uint32_t vkFormatETC2RGBA = 151;
+static const uint32_t vkFormatETC2RGBAsRGB = 152;
+
+// Khronos data format descriptor color models and channels
+static const unsigned char colorModelRGBSDA = 1;
+static const unsigned char colorModelBC1A = 128;
+static const unsigned char colorModelBC3 = 130;
+static const unsigned char colorModelBC4 = 131;
+static const unsigned char colorModelBC5 = 132;
+static const unsigned char colorModelBC7 = 134;
+static const unsigned char colorModelETC2 = 161;
+static const unsigned char channelRed = 0;
+static const unsigned char channelGreen = 1;
+static const unsigned char channelBlue = 2;
+static const unsigned char channelETC2Color = 2;
+static const unsigned char channelAlpha = 15;
+
+static uint32_t vkFormat(TextureFormat format);
+static bool formatFromVkFormat(uint32_t vkFormat, TextureFormat &format);
+static std::vector<unsigned char> dataFormatDescriptor(TextureFormat format);
+static void appendSample(std::vector<unsigned char> &block, unsigned int bitOffset, unsigned int bitLength,
+    unsigned char channel, uint32_t upper);
+static void appendKeyValue(std::vector<unsigned char> &data, const char* key, const char* value);
+static size_t alignUp(size_t value, size_t alignment);
+
+bool saveKTX2(const char* path, const TextureData &texture) {
+    if (texture.levels.empty())
+        return false;
+
+    std::vector<unsigned char> dfd = dataFormatDescriptor(texture.format);
+    std::vector<unsigned char> kvd;
+    appendKeyValue(kvd, "KTXorientation", "ru");
+    appendKeyValue(kvd, "KTXwriter", "learnopengl");
+
+    KTX2Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.identifier, ktx2Identifier, sizeof(ktx2Identifier));
+    header.vkFormat = vkFormat(texture.format);
+    header.typeSize = 1;
+    header.pixelWidth = texture.levels[0].width;
+    header.pixelHeight = texture.levels[0].height;
+    header.faceCount = 1;
+    header.levelCount = (uint32_t) texture.levels.size();
+    size_t levelIndexOffset = sizeof(KTX2Header);
+    header.dfdByteOffset = (uint32_t) (levelIndexOffset + texture.levels.size() * sizeof(KTX2LevelIndex));
+    header.dfdByteLength = (uint32_t) dfd.size();
+    header.kvdByteOffset = (uint32_t) (header.dfdByteOffset + dfd.size());
+    header.kvdByteLength = (uint32_t) kvd.size();
+
+    // level data is stored smallest level first, each level aligned to
+    // lcm(texel block size, 4)
+    size_t blockBytes = formatBlockBytes(texture.format);
+    size_t alignment = blockBytes % 4 == 0 ? blockBytes : blockBytes % 2 == 0 ? blockBytes * 2 : blockBytes * 4;
+    std::vector<KTX2LevelIndex> levelIndex(texture.levels.size());
+    size_t offset = header.kvdByteOffset + kvd.size();
+    for (size_t i = texture.levels.size() ; i-- > 0 ; ) {
+        offset = alignUp(offset, alignment);
+        levelIndex[i].byteOffset = offset;
+        levelIndex[i].byteLength = texture.levels[i].data.size();
+        levelIndex[i].uncompressedByteLength = texture.levels[i].data.size();
+        offset += texture.levels[i].data.size();
+    }
+
+    std::vector<unsigned char> bytes(offset, 0);
+    std::memcpy(&bytes[0], &header, sizeof(header));
+    std::memcpy(&bytes[levelIndexOffset], &levelIndex[0], levelIndex.size() * sizeof(KTX2LevelIndex));
+    std::memcpy(&bytes[header.dfdByteOffset], &dfd[0], dfd.size());
+    std::memcpy(&bytes[header.kvdByteOffset], &kvd[0], kvd.size());
+    for (size_t i = 0 ; i < texture.levels.size() ; i++) {
+        std::memcpy(&bytes[levelIndex[i].byteOffset], &texture.levels[i].data[0], texture.levels[i].data.size());
+    }
+
+    return writeFileBytes(path, &bytes[0], bytes.size());
+}
+
+bool KTX2File::open(const char* path) {
+    levels.clear();
+    if (!file.open(path))
+        return false;
+
+    KTX2Header header;
+    if (file.size() < sizeof(header)) {
+        file.close();
+        return false;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.identifier, ktx2Identifier, sizeof(ktx2Identifier)) != 0) {
+        printf("KTX2 load failed, not a KTX2 file\nPath: %s\n", path);
+        file.close();
+        return false;
+    }
+    if (header.supercompressionScheme != 0) {
+        printf("KTX2 load failed, supercompressed files are not supported\nPath: %s\n", path);
+        file.close();
+        return false;
+    }
+    if (!formatFromVkFormat(header.vkFormat, textureFormat) || header.pixelDepth > 1 || header.layerCount > 1
+        || header.faceCount != 1) {
+        printf("KTX2 load failed, only 2D textures in BC, ETC2 or 8 bit formats are supported\nPath: %s\n", path);
+        file.close();
+        return false;
+    }
+
+    unsigned int levelCount = header.levelCount > 0 ? header.levelCount : 1;
+    if (file.size() < sizeof(header) + levelCount * sizeof(KTX2LevelIndex)) {
+        file.close();
+        return false;
+    }
+
+    unsigned int width = header.pixelWidth;
+    unsigned int height = header.pixelHeight > 0 ? header.pixelHeight : 1;
+    for (unsigned int i = 0 ; i < levelCount ; i++) {
+        KTX2LevelIndex index;
+        std::memcpy(&index, file.data() + sizeof(header) + i * sizeof(KTX2LevelIndex), sizeof(index));
+        if (index.byteOffset + index.byteLength > file.size()
+            || index.byteLength != levelSize(textureFormat, width, height)) {
+            printf("KTX2 load failed, level %u is truncated\nPath: %s\n", i, path);
+            levels.clear();
+            file.close();
+            return false;
+        }
+
+        Level level;
+        level.width = width;
+        level.height = height;
+        level.offset = (size_t) index.byteOffset;
+        level.size = (size_t) index.byteLength;
+        levels.push_back(level);
+
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+    return true;
+}
+
+void KTX2File::upload(unsigned int firstLevel) const {
+    for (unsigned int i = firstLevel ; i < levels.size() ; i++) {
+        uploadLevel(i);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, (GLint) firstLevel);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint) levels.size() - 1);
+}
+
+void KTX2File::uploadLevel(unsigned int index) const {
+    const Level &level = levels[index];
+    uploadTextureLevel(textureFormat, index, level.width, level.height, file.data() + level.offset, level.size);
+}
+
+void KTX2File::read(TextureData &texture) const {
+    texture.format = textureFormat;
+    texture.levels.resize(levels.size());
+    for (unsigned int i = 0 ; i < levels.size() ; i++) {
+        texture.levels[i].width = levels[i].width;
+        texture.levels[i].height = levels[i].height;
+        texture.levels[i].data.assign(file.data() + levels[i].offset, file.data() + levels[i].offset + levels[i].size);
+    }
+}
+
+static uint32_t vkFormat(TextureFormat format) {
+    switch (format) {
+        case TextureFormat::R8:
+            return vkFormatR8;
+        case TextureFormat::RGB8:
+            return vkFormatRGB8;
+        case TextureFormat::RGBA8:
+            return vkFormatRGBA8;
+        case TextureFormat::BC1:
+            return vkFormatBC1;
+        case TextureFormat::BC3:
+            return vkFormatBC3;
+        case TextureFormat::BC4:
+            return vkFormatBC4;
+        case TextureFormat::BC5:
+            return vkFormatBC5;
+        case TextureFormat::BC7:
+            return vkFormatBC7;
+        case TextureFormat::ETC2_RGB:
+            return vkFormatETC2RGB;
+        case TextureFormat::ETC2_RGBA:
+            return vkFormatETC2RGBA;
+        default:
+            return 0;
+    }
+}
+
+static bool formatFromVkFormat(uint32_t vkFormat, TextureFormat &format) {
+    // sRGB variants are loaded as linear, like every other texture here
+    switch (vkFormat) {
+        case vkFormatR8:
+            format = TextureFormat::R8;
+            return true;
+        case vkFormatRGB8:
+            format = TextureFormat::RGB8;
+            return true;
+        case vkFormatRGBA8:
+        case vkFormatRGBA8sRGB:
+            format = TextureFormat::RGBA8;
+            return true;
+        case vkFormatBC1:
+        case vkFormatBC1sRGB:
+            format = TextureFormat::BC1;
+            return true;
+        case vkFormatBC3:
+        case vkFormatBC3sRGB:
+            format = TextureFormat::BC3;
+            return true;
+        case vkFormatBC4:
+            format = TextureFormat::BC4;
+            return true;
+        case vkFormatBC5:
+            format = TextureFormat::BC5;
+            return true;
+        case vkFormatBC7:
+        case vkFormatBC7sRGB:
+            format = TextureFormat::BC7;
+            return true;
+        case vkFormatETC2RGB:
+        case vkFormatETC2RGBsRGB:
+            format = TextureFormat::ETC2_RGB;
+            return true;
+        case vkFormatETC2RGBA:
+        case vkFormatETC2RGBAsRGB:
+            format = TextureFormat::ETC2_RGBA;
+            return true;
+        default:
+            // includes VK_FORMAT_UNDEFINED, used by Basis Universal
+            return false;
+    }
+}
+
+// builds the basic data format descriptor KTX2 requires next to vkFormat
+static std::vector<unsigned char> dataFormatDescriptor(TextureFormat format) {
+    unsigned char colorModel = colorModelRGBSDA;
+    bool compressed = isCompressed(format);
+    std::vector<unsigned char> samples;
+    switch (format) {
+        case TextureFormat::R8:
+            appendSample(samples, 0, 8, channelRed, 255);
+            break;
+        case TextureFormat::RGB8:
+        case TextureFormat::RGBA8:
+            appendSample(samples, 0, 8, channelRed, 255);
+            appendSample(samples, 8, 8, channelGreen, 255);
+            appendSample(samples, 16, 8, channelBlue, 255);
+            if (format == TextureFormat::RGBA8)
+                appendSample(samples, 24, 8, channelAlpha, 255);
+            break;
+        case TextureFormat::BC1:
+            colorModel = colorModelBC1A;
+            appendSample(samples, 0, 64, channelRed, 0xFFFFFFFF);
+            break;
+        case TextureFormat::BC3:
+            colorModel = colorModelBC3;
+            appendSample(samples, 0, 64, channelAlpha, 0xFFFFFFFF);
+            appendSample(samples, 64, 64, channelRed, 0xFFFFFFFF);
+            break;
+        case TextureFormat::BC4:
+            colorModel = colorModelBC4;
+            appendSample(samples, 0, 64, channelRed, 0xFFFFFFFF);
+            break;
+        case TextureFormat::BC5:
+            colorModel = colorModelBC5;
+            appendSample(samples, 0, 64, channelRed, 0xFFFFFFFF);
+            appendSample(samples, 64, 64, channelGreen, 0xFFFFFFFF);
+            break;
+        case TextureFormat::BC7:
+            colorModel = colorModelBC7;
+            appendSample(samples, 0, 128, channelRed, 0xFFFFFFFF);
+            break;
+        case TextureFormat::ETC2_RGB:
+            colorModel = colorModelETC2;
+            appendSample(samples, 0, 64, channelETC2Color, 0xFFFFFFFF);
+            break;
+        case TextureFormat::ETC2_RGBA:
+            colorModel = colorModelETC2;
+            appendSample(samples, 0, 64, channelAlpha, 0xFFFFFFFF);
+            appendSample(samples, 64, 64, channelETC2Color, 0xFFFFFFFF);
+            break;
+        default:
+            break;
+    }
+
+    unsigned int blockSize = 24 + (unsigned int) samples.size();
+    uint32_t totalSize = 4 + blockSize;
+    std::vector<unsigned char> dfd(28, 0);
+    std::memcpy(&dfd[0], &totalSize, 4);
+    // vendor id and descriptor type (Khronos basic) are both 0
+    dfd[8] = 2; // version
+    dfd[10] = (unsigned char) (blockSize & 0xFF);
+    dfd[11] = (unsigned char) (blockSize >> 8);
+    dfd[12] = colorModel;
+    dfd[13] = 1; // BT.709 primaries
+    dfd[14] = 1; // linear transfer, see formatFromVkFormat
+    dfd[15] = 0; // straight alpha
+    // texel block dimensions minus one
+    dfd[16] = compressed ? 3 : 0;
+    dfd[17] = compressed ? 3 : 0;
+    dfd[20] = (unsigned char) formatBlockBytes(format);
+    dfd.insert(dfd.end(), samples.begin(), samples.end());
+    return dfd;
+}
+
+static void appendSample(std::vector<unsigned char> &block, unsigned int bitOffset, unsigned int bitLength,
+    unsigned char channel, uint32_t upper) {
+    unsigned char sample[16] = {};
+    sample[0] = (unsigned char) (bitOffset & 0xFF);
+    sample[1] = (unsigned char) (bitOffset >> 8);
+    sample[2] = (unsigned char) (bitLength - 1);
+    sample[3] = channel;
+    // sample position 0, lower bound 0
+    std::memcpy(&sample[12], &upper, 4);
+    block.insert(block.end(), sample, sample + 16);
+}
+
+static void appendKeyValue(std::vector<unsigned char> &data, const char* key, const char* value) {
+    uint32_t length = (uint32_t) (std::strlen(key) + 1 + std::strlen(value) + 1);
+    unsigned char lengthBytes[4];
+    std::memcpy(lengthBytes, &length, 4);
+    data.insert(data.end(), lengthBytes, lengthBytes + 4);
+    data.insert(data.end(), key, key + std::strlen(key) + 1);
+    data.insert(data.end(), value, value + std::strlen(value) + 1);
+    data.resize(alignUp(data.size(), 4), 0);
+}
+
+static size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
\ No newline at end of file
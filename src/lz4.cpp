@@ -0,0 +1,142 @@
+#include "lz4.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+// matches are at least 4 bytes, the last match starts at least 12 bytes
+// before the end and the last 5 bytes are always literals
+static const size_t minMatch = 4;
+static const size_t matchStartLimit = 12;
+static const size_t lastLiterals = 5;
+static const size_t maxOffset = 65535;
+static const unsigned int hashBits = 16;
+
+static uint32_t read32(const unsigned char* data);
+static void writeLength(std::vector<unsigned char> &output, size_t length);
+static bool readLength(const unsigned char* &input, const unsigned char* end, size_t &length);
+static void appendSequence(std::vector<unsigned char> &output, const unsigned char* literals, size_t literalCount,
+    size_t offset, size_t matchLength);
+
+void compressLZ4(const unsigned char* data, size_t size, std::vector<unsigned char> &output) {
+    output.clear();
+    output.reserve(size + size / 255 + 16);
+
+    // position of the last 4 bytes that hashed to each slot
+    std::vector<uint32_t> table((size_t) 1 << hashBits, 0);
+    size_t anchor = 0;
+    size_t position = 0;
+    while (size > matchStartLimit && position < size - matchStartLimit) {
+        uint32_t sequence = read32(data + position);
+        uint32_t slot = (sequence * 2654435761u) >> (32 - hashBits);
+        size_t candidate = table[slot];
+        table[slot] = (uint32_t) position;
+        if (candidate >= position || position - candidate > maxOffset || read32(data + candidate) != sequence) {
+            position++;
+            continue;
+        }
+
+        size_t length = minMatch;
+        while (position + length < size - lastLiterals && data[candidate + length] == data[position + length]) {
+            length++;
+        }
+        // a match often starts before the bytes that found it
+        while (position > anchor && candidate > 0 && data[position - 1] == data[candidate - 1]) {
+            position--;
+            candidate--;
+            length++;
+        }
+        appendSequence(output, data + anchor, position - anchor, position - candidate, length);
+        position += length;
+        anchor = position;
+    }
+    appendSequence(output, data + anchor, size - anchor, 0, 0);
+}
+
+bool decompressLZ4(const unsigned char* data, size_t dataSize, unsigned char* output, size_t size) {
+    const unsigned char* input = data;
+    const unsigned char* inputEnd = data + dataSize;
+    unsigned char* out = output;
+    unsigned char* outputEnd = output + size;
+    while (input < inputEnd) {
+        unsigned int token = *input++;
+
+        size_t literals = token >> 4;
+        if (literals == 15 && !readLength(input, inputEnd, literals))
+            return false;
+        if (literals > (size_t) (inputEnd - input) || literals > (size_t) (outputEnd - out))
+            return false;
+        std::memcpy(out, input, literals);
+        input += literals;
+        out += literals;
+        // the last sequence has no match
+        if (input == inputEnd)
+            break;
+
+        if (inputEnd - input < 2)
+            return false;
+        size_t offset = input[0] | (size_t) input[1] << 8;
+        input += 2;
+        size_t length = token & 15;
+        if (length == 15 && !readLength(input, inputEnd, length))
+            return false;
+        length += minMatch;
+        if (offset == 0 || offset > (size_t) (out - output) || length > (size_t) (outputEnd - out))
+            return false;
+
+        // overlapping matches repeat their first offset bytes, and must be
+        // copied forwards one byte at a time
+        const unsigned char* match = out - offset;
+        if (offset >= length) {
+            std::memcpy(out, match, length);
+        } else {
+            for (size_t i = 0 ; i < length ; i++) {
+                out[i] = match[i];
+            }
+        }
+        out += length;
+    }
+    return out == outputEnd;
+}
+
+static uint32_t read32(const unsigned char* data) {
+    uint32_t value;
+    std::memcpy(&value, data, 4);
+    return value;
+}
+
+static void writeLength(std::vector<unsigned char> &output, size_t length) {
+    // the part of a length that doesn't fit its 4 bits of the token
+    while (length >= 255) {
+        output.push_back(255);
+        length -= 255;
+    }
+    output.push_back((unsigned char) length);
+}
+
+static bool readLength(const unsigned char* &input, const unsigned char* end, size_t &length) {
+    unsigned char byte;
+    do {
+        if (input == end)
+            return false;
+        byte = *input++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+static void appendSequence(std::vector<unsigned char> &output, const unsigned char* literals, size_t literalCount,
+        size_t offset, size_t matchLength) {
+    size_t matchCode = matchLength > 0 ? matchLength - minMatch : 0;
+    output.push_back((unsigned char) ((literalCount < 15 ? literalCount : 15) << 4 | (matchCode < 15 ? matchCode : 15)));
+    if (literalCount >= 15)
+        writeLength(output, literalCount - 15);
+    output.insert(output.end(), literals, literals + literalCount);
+    // a match length of 0 marks the last sequence, which only has literals
+    if (matchLength == 0)
+        return;
+
+    output.push_back((unsigned char) (offset & 0xff));
+    output.push_back((unsigned char) (offset >> 8));
+    if (matchCode >= 15)
+        writeLength(output, matchCode - 15);
+}
\ No newline at end of file
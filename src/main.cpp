@@ -5,27 +5,47 @@
 #include "glm/glm.hpp"
 #include "glm/gtc/matrix_transform.hpp"
 #include "glm/gtc/type_ptr.hpp"
-#include "stb/stb_image.h"
 
 #include "shader.hpp"
+#include "allocation_counter.hpp"
+#include "arena.hpp"
 #include "camera.hpp"
+#include "command_list.hpp"
+#include "cooked_assets.hpp"
+#include "depth_prepass.hpp"
+#include "gl_extensions.hpp"
+#include "material_table.hpp"
+#include "pak.hpp"
+#include "profiler.hpp"
+#include "program_binary_cache.hpp"
+#include "shader_compiler.hpp"
+#include "shader_hot_reload.hpp"
+#include "texture_manager.hpp"
+#include "render_queue.hpp"
+#include "render_stats.hpp"
+#include "simulation.hpp"
+#include "virtual_texture.hpp"
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow* window);
-unsigned int loadTexture(const char* path);
+void run(GLFWwindow* window);
+unsigned int createPositionVAO(const float* vertices, unsigned int vertexCount, unsigned int stride);
 
 int screenWidth;
 int screenHeight;
 
-Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
+// the camera is updated on the simulation thread, at a fixed timestep
+Simulation simulation(Camera(glm::vec3(0.0f, 0.0f, 3.0f)));
 float lastX;
 float lastY;
 bool firstMouse = true;
-
-float deltaTime = 0.0f;
-float lastFrame = 0.0f;
+bool captureKeyDown = false;
+bool statsKeyDown = false;
+bool printStats = false;
+bool allocationsKeyDown = false;
+bool printAllocations = false;
 
 int main() {
     glfwInit();
@@ -58,8 +78,41 @@ int main() {
         return -1;
     }
 
-    stbi_set_flip_vertically_on_load(true);
+    loadGLExtensions();
+    // counts the draws and state changes of every frame (F11 prints them)
+    RenderStats::instance().install();
+
+    // linked programs are cached on disk, skipping compilation on later runs
+    ProgramBinaryCache programBinaryCache("cache/shaders");
+    Shader::setBinaryCache(&programBinaryCache);
+    // set before any program links, which is when blocks get bound
+    Shader::setUniformBlockBinding("Materials", MaterialTable::binding);
+
+    // make pak bundles resources/ and cooked/ into one archive, which is
+    // then read instead of the loose files. those edited since still win,
+    // like the shaders the hot reload below picks up
+    if (fileExists("assets.pak"))
+        mountPak("assets.pak");
+    setLooseFileOverrides(true);
+    // assets cooked by make cook load instead of their sources. images
+    // without a cooked or offline compressed .dds version are compressed
+    // on first load, and cached with their mips for later runs
+    CookedAssets::instance().open("cooked");
+    TextureManager::instance().setCompression(true);
+    TextureManager::instance().setCacheDirectory("cache/textures");
+    // cached textures stream their mips in as they get closer, within this budget
+    TextureManager::instance().setBudget(128u << 20);
+
+    run(window);
+
+    simulation.stop();
+    glfwTerminate();
+    return 0;
+}
 
+// everything owning GL objects lives in here, so that it is destroyed
+// while the context is still current
+void run(GLFWwindow* window) {
     glEnable(GL_DEPTH_TEST);
     glDepthFunc(GL_LESS);
 
@@ -67,13 +120,37 @@ int main() {
     // if stencil & depth tests succeed, GL_REPLACE with ref value (1). otherwise, GL_KEEP
     glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
 
-    Shader textureShader = Shader(
+    Shader textureShader(
         "resources/shaders/texture.vs",
-        "resources/shaders/texture.fs");
+        "resources/shaders/texture.fs",
+        ShaderDefines(), ShaderBuild::DEFERRED);
 
-    Shader colorShader = Shader(
+    Shader colorShader(
         "resources/shaders/color.vs",
-        "resources/shaders/color.fs");
+        "resources/shaders/color.fs",
+        ShaderDefines(), ShaderBuild::DEFERRED);
+
+    Shader depthShader("resources/shaders/depth.vs", ShaderDefines(), ShaderBuild::DEFERRED);
+
+    Shader virtualTextureShader(
+        "resources/shaders/texture.vs",
+        "resources/shaders/virtual_texture.fs",
+        ShaderDefines(), ShaderBuild::DEFERRED);
+
+    Shader feedbackShader(
+        "resources/shaders/texture.vs",
+        "resources/shaders/virtual_texture.fs",
+        ShaderDefines { "VT_FEEDBACK" }, ShaderBuild::DEFERRED);
+
+    // compile all programs on a worker thread while the geometry and
+    // textures below are loaded
+    ShaderCompiler shaderCompiler(window);
+    shaderCompiler.add(textureShader);
+    shaderCompiler.add(colorShader);
+    shaderCompiler.add(depthShader);
+    shaderCompiler.add(virtualTextureShader);
+    shaderCompiler.add(feedbackShader);
+    shaderCompiler.start();
 
     float cubeVertices[] = {
         // positions          // texture Coords
@@ -157,18 +234,60 @@ int main() {
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
     glBindVertexArray(0);
 
-    unsigned int marbleTexture = loadTexture("resources/textures/marble.jpg");
-    unsigned int metalTexture = loadTexture("resources/textures/metal.png");
+    // position-only copies of the vertex data for the depth prepass
+    unsigned int cubeDepthVAO = createPositionVAO(cubeVertices, 36, 5);
+    unsigned int planeDepthVAO = createPositionVAO(planeVertices, 6, 5);
+
+    DepthPrepass depthPrepass(DepthPrepass::Mode::AUTO);
+    RenderQueue renderQueue;
+    // draws sampling virtual textures, which use their own shaders
+    RenderQueue virtualQueue;
+    // the opaque draws are culled and recorded on worker threads, then
+    // replayed here
+    CommandRecorder commandRecorder;
+
+    glm::vec3 boxPositions[] = {
+        glm::vec3(0.0f, 0.0f, 0.0f),
+        glm::vec3(1.25f, 0.0f, -0.75f)
+    };
+
+    unsigned int marbleTexture = TextureManager::instance().acquire("resources/textures/marble.jpg");
+
+    // the floor streams its texture in pages, through a 16x16 page cache
+    VirtualTextureSystem virtualTextures("cache/virtual");
+    unsigned int floorTexture = virtualTextures.add("resources/textures/metal.png");
+
+    shaderCompiler.wait();
+
+    // edits to the shader sources are picked up while the program runs
+    ShaderHotReload shaderHotReload("resources/shaders", window);
+    shaderHotReload.add(textureShader);
+    shaderHotReload.add(colorShader);
+    shaderHotReload.add(depthShader);
+    shaderHotReload.add(virtualTextureShader);
+    shaderHotReload.add(feedbackShader);
 
     textureShader.use();
     textureShader.setInt("texture0", 0);
 
+    simulation.start();
+
+    // the steady state frame shouldn't allocate: while F10 is toggled on,
+    // how often each frame does is printed whenever it changes
+    unsigned long long frameAllocations = 0;
+
     while (!glfwWindowShouldClose(window)) {
-        float currentFrame = (float) glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
+        unsigned long long allocationsBefore = allocationCount();
+        FrameArena::instance().beginFrame();
+        Profiler::instance().beginFrame();
 
         processInput(window);
+        shaderHotReload.update();
+
+        // the scene as the simulation last left it, blended towards its
+        // latest step so that movement is smooth at any frame rate
+        FrameSnapshot frame = simulation.interpolate();
+        Camera camera = frame.camera();
 
         glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
@@ -185,39 +304,103 @@ int main() {
         colorShader.setMat4("projection", projection);
         colorShader.setMat4("view", view);
         colorShader.setVec3("color", glm::vec3(1.0f, 0.0f, 0.0f));
-
+        virtualTextureShader.use();
+        virtualTextureShader.setMat4("projection", projection);
+        virtualTextureShader.setMat4("view", view);
+        feedbackShader.use();
+        feedbackShader.setMat4("projection", projection);
+        feedbackShader.setMat4("view", view);
+        depthShader.use();
+        depthShader.setMat4("projection", projection);
+        depthShader.setMat4("view", view);
+
+        // queue the opaque draws and sort them front-to-back, so the
+        // nearest boxes fill the depth buffer before the floor behind them
+        renderQueue.clear();
+        virtualQueue.clear();
+        DrawItem floor;
+        floor.center = glm::vec3(0.0f, -0.5f, 0.0f);
+        floor.VAO = planeVAO;
+        floor.depthVAO = planeDepthVAO;
+        floor.texture = virtualTextures.cacheTexture();
+        floor.count = 6;
         // make sure to not update the stencil buffer while drawing the floor
-        glStencilMask(0x00);
+        floor.stencilMask = 0x00;
+        virtualQueue.push(floor);
+        for (unsigned int i = 0 ; i < 2 ; i++) {
+            DrawItem box;
+            box.model = glm::translate(glm::mat4(1.0f), boxPositions[i]);
+            // half the diagonal of the unit cube
+            box.radius = 0.87f;
+            box.VAO = cubeVAO;
+            box.depthVAO = cubeDepthVAO;
+            box.texture = marbleTexture;
+            box.count = 36;
+            // boxes write to the stencil buffer for the outline pass
+            box.stencilMask = 0xFF;
+            renderQueue.push(box);
+        }
+        renderQueue.sort(view);
+        virtualQueue.sort(view);
+
+        // stream texture mips in (or out) for the size the draws have on screen
+        renderQueue.requestTextures(view, projection, screenHeight);
+        TextureManager::instance().update();
+
+        // feedback pass: stream in the virtual texture pages requested by
+        // an earlier frame, then record the ones this frame samples
+        // -----------------------------------------------------------------------------------------
+        {
+            PROFILE_SCOPE("feedback");
+            virtualTextures.update();
+            virtualTextures.beginFeedback(screenWidth, screenHeight);
+            // the boxes occlude the floor, drawn depth only so that pages
+            // hidden behind them aren't requested
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            depthShader.use();
+            renderQueue.drawOpaqueDepth(depthShader);
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+            feedbackShader.use();
+            virtualTextures.bind(feedbackShader, floorTexture, true);
+            virtualQueue.drawOpaque(feedbackShader);
+            virtualTextures.endFeedback();
+        }
+
+        depthPrepass.beginFrame();
+
+        // depth prepass: fill the depth buffer with the same geometry drawn
+        // below, so the shading pass only shades the visible fragments
+        // -----------------------------------------------------------------------------------------
+        if (depthPrepass.enabled()) {
+            PROFILE_SCOPE("depth prepass");
+            depthPrepass.beginDepthPass();
+            depthShader.use();
+            renderQueue.drawOpaqueDepth(depthShader);
+            virtualQueue.drawOpaqueDepth(depthShader);
+        }
 
-        // draw floor
-        glBindVertexArray(planeVAO);
-        textureShader.use();
-        glBindTexture(GL_TEXTURE_2D, metalTexture);
-        model = glm::mat4(1.0f);
-        textureShader.setMat4("model", model);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        glBindVertexArray(0);
+        depthPrepass.beginShadingPass();
 
-        // 1st render pass: draw boxes as normal, writing to the stencil buffer
+        // 1st render pass: draw floor and boxes as normal, the boxes writing to the stencil buffer
         // -----------------------------------------------------------------------------------------
 
         // all fragments should GL_ALWAYS pass the stencil test
         glStencilFunc(GL_ALWAYS, 1, 0xFF);
-        glStencilMask(0xFF); // enable writing to the stencil buffer
-
-        // draw boxes
-        glBindVertexArray(cubeVAO);
-        glBindTexture(GL_TEXTURE_2D, marbleTexture);
-        // first box
-        model = glm::mat4(1.0f);
-        textureShader.setMat4("model", model);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        // second box
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(1.25f, 0.0f, -0.75f));
-        textureShader.setMat4("model", model);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
+
+        {
+            PROFILE_SCOPE("boxes");
+            commandRecorder.clear();
+            renderQueue.recordOpaque(commandRecorder, textureShader, projection * view);
+            commandRecorder.replay();
+        }
+        {
+            PROFILE_SCOPE("floor");
+            virtualTextureShader.use();
+            virtualTextures.bind(virtualTextureShader, floorTexture);
+            virtualQueue.drawOpaque(virtualTextureShader);
+        }
+
+        depthPrepass.endShadingPass();
 
         // 2nd render pass: draw scaled versions of the objects, this time disabling stencil
         // writing. The parts of the stencil buffer that have been written (the entire box) are not
@@ -230,22 +413,21 @@ int main() {
 
         glDisable(GL_DEPTH_TEST); // disable depth testing to draw the outline above all fragments
 
-        // draw scaled boxes
-        glBindVertexArray(cubeVAO);
-        colorShader.use();
-        glm::vec3 outlineScale(1.01f);
-        // first box
-        model = glm::mat4(1.0f);
-        model = glm::scale(model, outlineScale);
-        colorShader.setMat4("model", model);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        // second box
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(1.25f, 0.0f, -0.75f));
-        model = glm::scale(model, outlineScale);
-        colorShader.setMat4("model", model);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
+        {
+            PROFILE_SCOPE("outline");
+            // draw scaled boxes
+            glBindVertexArray(cubeVAO);
+            colorShader.use();
+            glm::vec3 outlineScale(1.01f);
+            for (unsigned int i = 0 ; i < 2 ; i++) {
+                model = glm::mat4(1.0f);
+                model = glm::translate(model, boxPositions[i]);
+                model = glm::scale(model, outlineScale);
+                colorShader.setMat4("model", model);
+                glDrawArrays(GL_TRIANGLES, 0, 36);
+            }
+            glBindVertexArray(0);
+        }
 
         // reenable depth testing after outline drawing
         glEnable(GL_DEPTH_TEST);
@@ -256,10 +438,16 @@ int main() {
 
         glfwSwapBuffers(window);
         glfwPollEvents();
-    }
 
-    glfwTerminate();
-    return 0;
+        RenderStats::instance().endFrame();
+        if (printStats)
+            RenderStats::print(RenderStats::instance().last(), true);
+
+        unsigned long long allocations = allocationCount() - allocationsBefore;
+        if (printAllocations && allocations != frameAllocations)
+            printf("Frame heap allocations: %llu\n", allocations);
+        frameAllocations = allocations;
+    }
 }
 
 void framebuffer_size_callback(GLFWwindow*, int width, int height) {
@@ -281,60 +469,63 @@ void mouse_callback(GLFWwindow*, double xPos, double yPos) {
     lastX = xPos;
     lastY = yPos;
 
-    camera.ProcessMouseMovement(xOffset, yOffset);
+    simulation.addMouseMovement(xOffset, yOffset);
 }
 
 void scroll_callback(GLFWwindow*, double, double yOffset) {
-    camera.ProcessMouseScroll(yOffset);
+    simulation.addMouseScroll((float) yOffset);
 }
 
 void processInput(GLFWwindow* window) {
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
 
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-        camera.ProcessKeyboard(CameraMovement::FORWARD, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-        camera.ProcessKeyboard(CameraMovement::BACKWARD, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-        camera.ProcessKeyboard(CameraMovement::RIGHT, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-        camera.ProcessKeyboard(CameraMovement::LEFT, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS)
-        camera.ProcessKeyboard(CameraMovement::UP, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
-        camera.ProcessKeyboard(CameraMovement::DOWN, deltaTime);
+    // F12 writes the pass timings of the next 120 frames to a Chrome trace
+    bool captureKey = glfwGetKey(window, GLFW_KEY_F12) == GLFW_PRESS;
+    if (captureKey && !captureKeyDown)
+        Profiler::instance().capture(120, "profile.json");
+    captureKeyDown = captureKey;
+
+    // F11 toggles printing every frame's draw and state change counts as JSON
+    bool statsKey = glfwGetKey(window, GLFW_KEY_F11) == GLFW_PRESS;
+    if (statsKey && !statsKeyDown)
+        printStats = !printStats;
+    statsKeyDown = statsKey;
+
+    // F10 toggles printing the frame's heap allocation count when it changes
+    bool allocationsKey = glfwGetKey(window, GLFW_KEY_F10) == GLFW_PRESS;
+    if (allocationsKey && !allocationsKeyDown)
+        printAllocations = !printAllocations;
+    allocationsKeyDown = allocationsKey;
+
+    // held keys are sampled by every simulation step
+    simulation.setKey(CameraMovement::FORWARD, glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS);
+    simulation.setKey(CameraMovement::BACKWARD, glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS);
+    simulation.setKey(CameraMovement::RIGHT, glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS);
+    simulation.setKey(CameraMovement::LEFT, glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS);
+    simulation.setKey(CameraMovement::UP, glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS);
+    simulation.setKey(CameraMovement::DOWN, glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS);
 }
 
-unsigned int loadTexture(const char* path) {
-    unsigned int id;
-    glGenTextures(1, &id);
-
-    int width, height, channels;
-    unsigned char *data = stbi_load(path,
-        &width, &height, &channels, 0);
-
-    if (data != NULL) {
-        GLenum format;
-        if (channels == 1)
-            format = GL_RED;
-        else if (channels == 3)
-            format = GL_RGB;
-        else if (channels == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, id);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        glTexImage2D(GL_TEXTURE_2D, 0, (GLint) format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    } else {
-        printf("Texture load failed. Path: %s\n", path);
+unsigned int createPositionVAO(const float* vertices, unsigned int vertexCount, unsigned int stride) {
+    // copy the first 3 floats (the position) of every interleaved vertex
+    float* positions = new float[vertexCount * 3];
+    for (unsigned int i = 0 ; i < vertexCount ; i++) {
+        positions[i * 3 + 0] = vertices[i * stride + 0];
+        positions[i * 3 + 1] = vertices[i * stride + 1];
+        positions[i * 3 + 2] = vertices[i * stride + 2];
     }
-    stbi_image_free(data);
 
-    return id;
+    unsigned int VAO, VBO;
+    glGenVertexArrays(1, &VAO);
+    glBindVertexArray(VAO);
+    glGenBuffers(1, &VBO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr) (vertexCount * 3 * sizeof(float)), positions, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*) 0);
+    glBindVertexArray(0);
+
+    delete[] positions;
+    return VAO;
 }
\ No newline at end of file
@@ -0,0 +1,111 @@
+#include "material_table.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "glad/glad.h"
+
+#include "gl_extensions.hpp"
+#include "texture_manager.hpp"
+
+static uint64_t handleOf(const uint32_t* words);
+
+MaterialTable &MaterialTable::instance() {
+    static MaterialTable table;
+    return table;
+}
+
+unsigned int MaterialTable::add(const Material &material) {
+    unsigned int index;
+    if (!freeIndices.empty()) {
+        index = freeIndices.back();
+        freeIndices.pop_back();
+    } else if (materials.size() < maxMaterials) {
+        index = (unsigned int) materials.size();
+        materials.push_back(GPUMaterial());
+    } else {
+        printf("Material table full\nMaterials: %u\n", maxMaterials);
+        return invalidIndex;
+    }
+
+    GPUMaterial &entry = materials[index];
+    uint64_t diffuse = acquireHandle(material.diffuseTexture);
+    uint64_t specular = acquireHandle(material.specularTexture);
+    entry.handles[0] = (uint32_t) diffuse;
+    entry.handles[1] = (uint32_t) (diffuse >> 32);
+    entry.handles[2] = (uint32_t) specular;
+    entry.handles[3] = (uint32_t) (specular >> 32);
+    entry.parameters[0] = (float) material.diffuseLayer;
+    entry.parameters[1] = (float) material.specularLayer;
+    entry.parameters[2] = material.shininess;
+    entry.parameters[3] = 0.0f;
+
+    if (dirtyBegin == dirtyEnd) {
+        dirtyBegin = index;
+        dirtyEnd = index + 1;
+    } else {
+        dirtyBegin = std::min(dirtyBegin, index);
+        dirtyEnd = std::max(dirtyEnd, index + 1);
+    }
+    return index;
+}
+
+void MaterialTable::remove(unsigned int index) {
+    if (index >= materials.size())
+        return;
+
+    // the entry itself stays in the buffer until reused
+    GPUMaterial &entry = materials[index];
+    releaseHandle(handleOf(&entry.handles[0]));
+    releaseHandle(handleOf(&entry.handles[2]));
+    entry.handles[0] = entry.handles[1] = entry.handles[2] = entry.handles[3] = 0;
+    freeIndices.push_back(index);
+}
+
+bool MaterialTable::bindless() const {
+    return glExtensions().bindlessTexture;
+}
+
+void MaterialTable::bind() {
+    // allocated at full size once, so bindings never see it move
+    if (buffer == 0) {
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferData(GL_UNIFORM_BUFFER, (GLsizeiptr) (maxMaterials * sizeof(GPUMaterial)), NULL, GL_DYNAMIC_DRAW);
+    }
+    if (dirtyBegin != dirtyEnd) {
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, (GLintptr) (dirtyBegin * sizeof(GPUMaterial)),
+            (GLsizeiptr) ((dirtyEnd - dirtyBegin) * sizeof(GPUMaterial)), &materials[dirtyBegin]);
+        dirtyBegin = dirtyEnd = 0;
+    }
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+}
+
+uint64_t MaterialTable::acquireHandle(unsigned int texture) {
+    if (texture == 0 || !bindless())
+        return 0;
+
+    // handles make the texture immutable, so streaming must stop first
+    TextureManager::instance().pin(texture);
+    uint64_t handle = glExtensions().getTextureHandle(texture);
+    if (handleReferences[handle]++ == 0)
+        glExtensions().makeTextureHandleResident(handle);
+    return handle;
+}
+
+void MaterialTable::releaseHandle(uint64_t handle) {
+    std::unordered_map<uint64_t, unsigned int>::iterator found = handleReferences.find(handle);
+    if (handle == 0 || found == handleReferences.end())
+        return;
+    if (--found->second > 0)
+        return;
+
+    // must be done before the texture is deleted
+    glExtensions().makeTextureHandleNonResident(handle);
+    handleReferences.erase(found);
+}
+
+static uint64_t handleOf(const uint32_t* words) {
+    return (uint64_t) words[0] | ((uint64_t) words[1] << 32);
+}
\ No newline at end of file
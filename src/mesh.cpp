@@ -1,14 +1,92 @@
 #include "mesh.hpp"
 
+#include <utility>
+
 #include "shader.hpp"
 #include "glad/glad.h"
 
-Mesh::Mesh(std::vector<Vertex> inVertices, std::vector<unsigned int> inIndices, std::vector<Texture> inTextures) {
-    vertices = inVertices;
-    indices = inIndices;
-    textures = inTextures;
+Mesh::Mesh(std::vector<Vertex> inVertices, std::vector<unsigned int> inIndices, std::vector<Texture> inTextures, bool createBuffers)
+    : shininess(32.0f), material(-1), boundsCenter(0.0f), boundsRadius(0.0f), VAO(0), VBO(0), EBO(0), depthVAO(0), depthVBO(0) {
+    vertices = std::move(inVertices);
+    indices = std::move(inIndices);
+    textures = std::move(inTextures);
+
+    // To set textures to their correct texture units, we use
+    // a simple convention. Every texture is set to the shader
+    // as, for example, "material.texture_diffuse0". the number
+    // can go from 0 to the texture unit max and in our case,
+    // the possible texture types are only diffuse and specular.
+    bool hasSpecular = false;
+    unsigned int diffuseCount = 0;
+    unsigned int specularCount = 0;
+    for (unsigned int i = 0 ; i < textures.size() ; i++) {
+        std::string number;
+        const std::string &type = textures[i].type;
+        if (type == "texture_diffuse") {
+            number = std::to_string(diffuseCount++);
+        } else if (type == "texture_specular") {
+            number = std::to_string(specularCount++);
+            hasSpecular = true;
+        }
+        textureUniforms.push_back("material." + type + number);
+    }
+    // lets the compiler drop the specular term instead of sampling an
+    // unbound texture for it
+    if (!hasSpecular)
+        defines.push_back("NO_SPECULAR_MAP");
+
+    if (createBuffers)
+        setup();
+}
 
-    setup();
+Mesh::~Mesh() {
+    release();
+}
+
+Mesh::Mesh(Mesh &&other) noexcept
+    : vertices(std::move(other.vertices)), indices(std::move(other.indices)), textures(std::move(other.textures)),
+      defines(std::move(other.defines)), shininess(other.shininess), material(other.material),
+      boundsCenter(other.boundsCenter), boundsRadius(other.boundsRadius),
+      VAO(other.VAO), VBO(other.VBO), EBO(other.EBO), textureUniforms(std::move(other.textureUniforms)),
+      depthVAO(other.depthVAO), depthVBO(other.depthVBO) {
+    other.VAO = other.VBO = other.EBO = 0;
+    other.depthVAO = other.depthVBO = 0;
+}
+
+Mesh &Mesh::operator=(Mesh &&other) noexcept {
+    if (this != &other) {
+        release();
+        vertices = std::move(other.vertices);
+        indices = std::move(other.indices);
+        textures = std::move(other.textures);
+        defines = std::move(other.defines);
+        shininess = other.shininess;
+        material = other.material;
+        boundsCenter = other.boundsCenter;
+        boundsRadius = other.boundsRadius;
+        textureUniforms = std::move(other.textureUniforms);
+        std::swap(VAO, other.VAO);
+        std::swap(VBO, other.VBO);
+        std::swap(EBO, other.EBO);
+        std::swap(depthVAO, other.depthVAO);
+        std::swap(depthVBO, other.depthVBO);
+    }
+    return *this;
+}
+
+// CPU-only meshes never created their buffers
+void Mesh::release() {
+    if (VAO != 0) {
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+    }
+    if (depthVAO != 0) {
+        glDeleteVertexArrays(1, &depthVAO);
+        glDeleteBuffers(1, &depthVBO);
+    }
+    VAO = VBO = EBO = 0;
+    depthVAO = depthVBO = 0;
 }
 
 void Mesh::setup() {
@@ -39,33 +117,52 @@ void Mesh::setup() {
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*) offsetof(Vertex, texCoords));
     glEnableVertexAttribArray(2);
 
+    // tangents (4 floats)
+    glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*) offsetof(Vertex, tangent));
+    glEnableVertexAttribArray(4);
+
     // unbinds VAO
     glBindVertexArray(0);
+
+    // position-only stream for depth-only passes
+    std::vector<glm::vec3> positions(vertices.size());
+    for (unsigned int i = 0 ; i < vertices.size() ; i++) {
+        positions[i] = vertices[i].position;
+    }
+
+    glGenVertexArrays(1, &depthVAO);
+    glBindVertexArray(depthVAO);
+
+    glGenBuffers(1, &depthVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, depthVBO);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr) (positions.size() * sizeof(glm::vec3)), &positions[0], GL_STATIC_DRAW);
+    // the element buffer binding is VAO state, so bind the same EBO again
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*) 0);
+    glEnableVertexAttribArray(0);
+
+    glBindVertexArray(0);
 }
 
 // , ,
 // sets the right texture unit in the material uniforms, binds the VAO
 // and draws the mesh.
 void Mesh::Draw(Shader& shader) {
-    // To set textures to their correct texture units, we use
-    // a simple convention. Every texture is set to the shader
-    // as, for example, "material.texture_diffuse0". the number
-    // can go from 0 to the texture unit max and in our case,
-    // the possible texture types are only diffuse and specular.
-    unsigned int diffuseCount = 0;
-    unsigned int specularCount = 0;
-    for (unsigned int i = 0 ; i < textures.size() ; i++) {
-        std::string number;
-        std::string type = textures[i].type;
-        if (type == "texture_diffuse")
-            number = std::to_string(diffuseCount++);
-        else if (type == "texture_specular")
-            number = std::to_string(specularCount++);
+    // the textures and parameters are in the bound material table
+    if (material >= 0) {
+        shader.setInt("materialIndex", material);
+        glBindVertexArray(VAO);
+        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+        glBindVertexArray(0);
+        return;
+    }
 
+    for (unsigned int i = 0 ; i < textures.size() ; i++) {
         // set the Nth texture unit to the shader uniform.
         // our shader supports just 1 texture of each type, but it
         // can be extended to support more using this convention.
-        shader.setInt(("material." + type + number).c_str(), (int) i);
+        shader.setInt(textureUniforms[i].c_str(), (int) i);
         // bind the Nth texture to the Nth texture unit
         glActiveTexture(GL_TEXTURE0 + i);
         glBindTexture(GL_TEXTURE_2D, textures[i].id);
@@ -75,4 +172,10 @@ void Mesh::Draw(Shader& shader) {
     glBindVertexArray(VAO);
     glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
     glBindVertexArray(0);
+}
+
+void Mesh::DrawDepth() {
+    glBindVertexArray(depthVAO);
+    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+    glBindVertexArray(0);
 }
\ No newline at end of file
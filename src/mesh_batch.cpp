@@ -0,0 +1,160 @@
+#include "mesh_batch.hpp"
+
+#include <cstddef>
+#include <utility>
+
+#include "glad/glad.h"
+
+#include "mesh.hpp"
+
+struct BatchVertex {
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 texCoords;
+    unsigned int material;
+    glm::vec4 tangent;
+};
+
+MeshBatch::MeshBatch(const std::vector<const Mesh*> &meshes, const std::vector<unsigned int> &meshMaterials,
+    unsigned int inDiffuseArray, unsigned int inSpecularArray)
+    : diffuseArray(inDiffuseArray), specularArray(inSpecularArray) {
+    defines.push_back("TEXTURE_ARRAYS");
+    if (specularArray == 0)
+        defines.push_back("NO_SPECULAR_MAP");
+
+    // indices are rebased onto the merged vertex buffer
+    std::vector<BatchVertex> vertices;
+    std::vector<glm::vec3> positions;
+    std::vector<unsigned int> indices;
+    glm::vec3 minimum(0.0f);
+    glm::vec3 maximum(0.0f);
+    for (unsigned int i = 0 ; i < meshes.size() ; i++) {
+        const Mesh &mesh = *meshes[i];
+        unsigned int base = (unsigned int) vertices.size();
+        for (unsigned int j = 0 ; j < mesh.vertices.size() ; j++) {
+            BatchVertex vertex;
+            vertex.position = mesh.vertices[j].position;
+            vertex.normal = mesh.vertices[j].normal;
+            vertex.texCoords = mesh.vertices[j].texCoords;
+            vertex.material = meshMaterials[i];
+            vertex.tangent = mesh.vertices[j].tangent;
+            vertices.push_back(vertex);
+            positions.push_back(vertex.position);
+            minimum = vertices.size() == 1 ? vertex.position : glm::min(minimum, vertex.position);
+            maximum = vertices.size() == 1 ? vertex.position : glm::max(maximum, vertex.position);
+        }
+        for (unsigned int j = 0 ; j < mesh.indices.size() ; j++) {
+            indices.push_back(base + mesh.indices[j]);
+        }
+    }
+    indexCount = (unsigned int) indices.size();
+    boundsCenter = (minimum + maximum) * 0.5f;
+    boundsRadius = glm::length(maximum - boundsCenter);
+
+    glGenVertexArrays(1, &VAO);
+    glBindVertexArray(VAO);
+
+    glGenBuffers(1, &VBO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr) (vertices.size() * sizeof(BatchVertex)), &vertices[0], GL_STATIC_DRAW);
+
+    glGenBuffers(1, &EBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr) (indices.size() * sizeof(unsigned int)), &indices[0], GL_STATIC_DRAW);
+
+    // same layout as Mesh, plus the material index
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(BatchVertex), (void*) 0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(BatchVertex), (void*) offsetof(BatchVertex, normal));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(BatchVertex), (void*) offsetof(BatchVertex, texCoords));
+    glEnableVertexAttribArray(2);
+    // material table index (1 unsigned int), read as an integer attribute
+    glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(BatchVertex), (void*) offsetof(BatchVertex, material));
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(BatchVertex), (void*) offsetof(BatchVertex, tangent));
+    glEnableVertexAttribArray(4);
+
+    glBindVertexArray(0);
+
+    // position-only stream for depth-only passes, see Mesh
+    glGenVertexArrays(1, &depthVAO);
+    glBindVertexArray(depthVAO);
+
+    glGenBuffers(1, &depthVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, depthVBO);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr) (positions.size() * sizeof(glm::vec3)), &positions[0], GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*) 0);
+    glEnableVertexAttribArray(0);
+
+    glBindVertexArray(0);
+}
+
+MeshBatch::~MeshBatch() {
+    release();
+}
+
+MeshBatch::MeshBatch(MeshBatch &&other) noexcept
+    : defines(std::move(other.defines)), boundsCenter(other.boundsCenter), boundsRadius(other.boundsRadius),
+      VAO(other.VAO), VBO(other.VBO), EBO(other.EBO), depthVAO(other.depthVAO), depthVBO(other.depthVBO),
+      indexCount(other.indexCount), diffuseArray(other.diffuseArray), specularArray(other.specularArray) {
+    other.VAO = other.VBO = other.EBO = 0;
+    other.depthVAO = other.depthVBO = 0;
+    other.indexCount = 0;
+}
+
+MeshBatch &MeshBatch::operator=(MeshBatch &&other) noexcept {
+    if (this != &other) {
+        release();
+        defines = std::move(other.defines);
+        boundsCenter = other.boundsCenter;
+        boundsRadius = other.boundsRadius;
+        indexCount = other.indexCount;
+        diffuseArray = other.diffuseArray;
+        specularArray = other.specularArray;
+        std::swap(VAO, other.VAO);
+        std::swap(VBO, other.VBO);
+        std::swap(EBO, other.EBO);
+        std::swap(depthVAO, other.depthVAO);
+        std::swap(depthVBO, other.depthVBO);
+    }
+    return *this;
+}
+
+void MeshBatch::release() {
+    if (VAO != 0) {
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+    }
+    if (depthVAO != 0) {
+        glDeleteVertexArrays(1, &depthVAO);
+        glDeleteBuffers(1, &depthVBO);
+    }
+    VAO = VBO = EBO = 0;
+    depthVAO = depthVBO = 0;
+}
+
+void MeshBatch::Draw(Shader &shader) {
+    shader.setInt("material.diffuseArray", 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, diffuseArray);
+    if (specularArray != 0) {
+        shader.setInt("material.specularArray", 1);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, specularArray);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    glBindVertexArray(VAO);
+    glDrawElements(GL_TRIANGLES, (GLsizei) indexCount, GL_UNSIGNED_INT, 0);
+    glBindVertexArray(0);
+}
+
+void MeshBatch::DrawDepth() {
+    glBindVertexArray(depthVAO);
+    glDrawElements(GL_TRIANGLES, (GLsizei) indexCount, GL_UNSIGNED_INT, 0);
+    glBindVertexArray(0);
+}
\ No newline at end of file
@@ -1,176 +1,320 @@
 #include "model.hpp"
 
 #include <cstdio>
+#include <map>
+#include <unordered_map>
+#include <utility>
 
 #include "glad/glad.h"
-#include "glm/glm.hpp"
-#include "assimp/Importer.hpp"
-#include "assimp/scene.h"
-#include "assimp/postprocess.h"
-#include "stb/stb_image.h"
 
+#include "cooked_assets.hpp"
+#include "fileutil.hpp"
 #include "mesh.hpp"
+#include "material_table.hpp"
+#include "mesh_batch.hpp"
+#include "model_data.hpp"
+#include "parallel.hpp"
 #include "shader.hpp"
+#include "shader_cache.hpp"
+#include "texture_array.hpp"
+#include "texture_manager.hpp"
 
-Model::Model(std::string path) {
-    this->loadModel(path);
+// data's decoded image for a texture path, NULL if it wasn't decoded
+static TextureData* decodedTexture(ModelData &data, const std::string &path);
+
+Model::Model(std::string path, bool inBatched) : batched(inBatched) {
+    std::vector<std::string> paths(1, path);
+    std::vector<ModelData> data(1);
+    if (loadModelData(path, data[0])) {
+        decodeTextures(paths, data, this->batched);
+        this->create(path, data[0]);
+    }
 }
 
-void Model::Draw(Shader &shader) {
+Model::~Model() {
+    // handles are made non-resident before their textures can be deleted
+    for (unsigned int i = 0 ; i < this->materials.size() ; i++) {
+        MaterialTable::instance().remove(this->materials[i]);
+    }
+    // every texture of every mesh was acquired once in loadModel, or in
+    // buildBatches for meshes left out of the batches. batched meshes
+    // only hold their texture arrays
     for (unsigned int i = 0 ; i < this->meshes.size() ; i++) {
-        this->meshes[i].Draw(shader);
+        for (unsigned int j = 0 ; j < this->meshes[i].textures.size() ; j++) {
+            if (this->meshes[i].textures[j].id != 0)
+                TextureManager::instance().release(this->meshes[i].textures[j].id);
+        }
     }
+    if (!this->textureArrays.empty())
+        glDeleteTextures((GLsizei) this->textureArrays.size(), &this->textureArrays[0]);
 }
 
-void Model::loadModel(std::string path) {
-    Assimp::Importer importer;
-    // Triangulates the mesh because we only use the GL_TRIANGLES primitive
-    // in our glDrawElements calls. Flips UVs because OpenGL expects images
-    // to have their 0.0 coordinates at the bottom.
-    const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
-
-    if (!scene || !scene->mRootNode || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE) {
-        printf("Assimp model loading error\nPath: %s\n%s", path.c_str(), importer.GetErrorString());
-        return;
+void Model::selectShaders(ShaderCache &cache, const char* vertexPath, const char* fragmentPath,
+        const ShaderDefines &defines) {
+    this->batchShaders.clear();
+    for (unsigned int i = 0 ; i < this->batches.size() ; i++) {
+        ShaderDefines batchDefines = defines;
+        batchDefines.insert(batchDefines.end(), this->batches[i].defines.begin(), this->batches[i].defines.end());
+        this->batchShaders.push_back(&cache.get(vertexPath, fragmentPath, batchDefines));
+    }
+    this->meshShaders.clear();
+    for (unsigned int i = 0 ; i < this->meshes.size() ; i++) {
+        ShaderDefines meshDefines = defines;
+        meshDefines.insert(meshDefines.end(), this->meshes[i].defines.begin(), this->meshes[i].defines.end());
+        this->meshShaders.push_back(&cache.get(vertexPath, fragmentPath, meshDefines));
     }
-
-    // stores only the directory to append with the filename returned by
-    // GetTexture() to compare with a loaded texture.
-    this->directory = path.substr(0, path.find_last_of('/'));
-    processNode(scene->mRootNode, scene);
 }
 
-void Model::processNode(aiNode* node, const aiScene* scene) {
-    // process all meshes in current node
-    for (unsigned int i = 0 ; i < node->mNumMeshes ; i++) {
-        unsigned int meshIndex = node->mMeshes[i];
-        aiMesh* mesh = scene->mMeshes[meshIndex];
-        this->meshes.push_back(processMesh(mesh, scene));
+void Model::Draw() {
+    if (!this->materials.empty())
+        MaterialTable::instance().bind();
+    // consecutive meshes often share a permutation
+    Shader* current = NULL;
+    for (unsigned int i = 0 ; i < this->batches.size() ; i++) {
+        if (this->batchShaders[i] != current) {
+            current = this->batchShaders[i];
+            current->use();
+        }
+        this->batches[i].Draw(*current);
     }
+    for (unsigned int i = 0 ; i < this->meshes.size() ; i++) {
+        if (this->meshShaders[i] != current) {
+            current = this->meshShaders[i];
+            current->use();
+        }
+        this->meshes[i].Draw(*current);
+    }
+}
 
-    // process children recursively
-    for (unsigned int i = 0 ; i < node->mNumChildren ; i++) {
-        processNode(node->mChildren[i], scene);
+void Model::DrawDepth() {
+    for (unsigned int i = 0 ; i < this->batches.size() ; i++) {
+        this->batches[i].DrawDepth();
+    }
+    for (unsigned int i = 0 ; i < this->meshes.size() ; i++) {
+        this->meshes[i].DrawDepth();
     }
 }
 
-Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene) {
-    std::vector<Vertex> vertices;
-    std::vector<unsigned int> indices;
-    std::vector<Texture> textures;
-
-    // move all vertex data to glm vectors
-    for (unsigned int i = 0 ; i < mesh->mNumVertices ; i++) {
-        Vertex vertex;
-        glm::vec3 vector;
-        vector.x = mesh->mVertices[i].x;
-        vector.y = mesh->mVertices[i].y;
-        vector.z = mesh->mVertices[i].z;
-        vertex.position = vector;
-
-        if(mesh->HasNormals()) {
-            vector.x = mesh->mNormals[i].x;
-            vector.y = mesh->mNormals[i].y;
-            vector.z = mesh->mNormals[i].z;
-            vertex.normal = vector;
+std::vector<std::unique_ptr<Model>> Model::loadAll(const std::vector<std::string> &paths, bool batched) {
+    // files load concurrently, and so do the meshes within each of them
+    // (see importModel)
+    std::vector<ModelData> data(paths.size());
+    parallelFor((unsigned int) paths.size(), 1, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int i = begin ; i < end ; i++) {
+            loadModelData(paths[i], data[i]);
         }
+    });
+    decodeTextures(paths, data, batched);
 
-        if (mesh->mTextureCoords[0]) {
-            vector.x = mesh->mTextureCoords[0][i].x;
-            vector.y = mesh->mTextureCoords[0][i].y;
-            vertex.texCoords = glm::vec2(vector);
-        } else
-            vertex.texCoords = glm::vec2(0.0f, 0.0f);
-
-        vertices.push_back(vertex);
+    std::vector<std::unique_ptr<Model>> models;
+    for (unsigned int i = 0 ; i < paths.size() ; i++) {
+        models.push_back(std::unique_ptr<Model>(new Model(paths[i], data[i], batched)));
     }
+    return models;
+}
+
+Model::Model(const std::string &path, ModelData &data, bool inBatched) : batched(inBatched) {
+    this->create(path, data);
+}
 
-    for (unsigned int i = 0 ; i < mesh->mNumFaces ; i++) {
-        aiFace face = mesh->mFaces[i];
-        for (unsigned int j = 0 ; j < face.mNumIndices ; j++) {
-            indices.push_back(face.mIndices[j]);
+bool Model::loadModelData(const std::string &path, ModelData &data) {
+    // the cooked model when there is an up to date one: no parsing, and
+    // its buffers were already optimized by the cooker
+    std::string cookedPath = CookedAssets::instance().find(path.c_str());
+    return (!cookedPath.empty() && loadCookedModel(cookedPath.c_str(), data)) || importModel(path.c_str(), data);
+}
+
+void Model::decodeTextures(const std::vector<std::string> &paths, std::vector<ModelData> &data, bool batched) {
+    // the distinct files across all models, decoded concurrently: the
+    // same file decoded twice at once would also write its cache file
+    // twice. entries are inserted up front, so workers only fill them in
+    std::vector<std::pair<std::string, TextureData*>> textures;
+    std::unordered_map<std::string, TextureData*> decoding;
+    // (copy, decoded) for batched models sharing a file with an earlier one
+    std::vector<std::pair<TextureData*, TextureData*>> copies;
+    for (unsigned int i = 0 ; i < paths.size() ; i++) {
+        std::string directory = paths[i].substr(0, paths[i].find_last_of('/'));
+        for (unsigned int j = 0 ; j < data[i].meshes.size() ; j++) {
+            const MeshData &mesh = data[i].meshes[j];
+            for (unsigned int k = 0 ; k < mesh.textures.size() ; k++) {
+                const std::string &path = mesh.textures[k].path;
+                if (data[i].textures.find(path) != data[i].textures.end())
+                    continue;
+                std::string fullPath = directory + '/' + path;
+                // acquire only adds a reference to loaded textures
+                if (!batched && TextureManager::instance().loaded(fullPath.c_str()))
+                    continue;
+                std::string key = canonicalPath(fullPath.c_str());
+                std::unordered_map<std::string, TextureData*>::iterator found = decoding.find(key);
+                if (found == decoding.end()) {
+                    decoding[key] = &data[i].textures[path];
+                    textures.push_back(std::make_pair(fullPath, &data[i].textures[path]));
+                } else if (batched) {
+                    copies.push_back(std::make_pair(&data[i].textures[path], found->second));
+                }
+            }
         }
     }
-
-    // load all textures and store in the textures array
-    if (scene->mNumMaterials > 0) {
-        // scene->mMaterials is of size scene->mNumMaterials
-        aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-        std::vector<Texture> diffuseTextures = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-        textures.insert(textures.end(), diffuseTextures.begin(), diffuseTextures.end());
-        std::vector<Texture> specularTextures = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-        textures.insert(textures.end(), specularTextures.begin(), specularTextures.end());
+    parallelFor((unsigned int) textures.size(), 1, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int i = begin ; i < end ; i++) {
+            TextureManager::instance().decode(textures[i].first.c_str(), *textures[i].second);
+        }
+    });
+    // before any model takes its images to pack or upload them
+    for (unsigned int i = 0 ; i < copies.size() ; i++) {
+        *copies[i].first = *copies[i].second;
     }
+}
 
-    return Mesh(vertices, indices, textures);
+void Model::create(const std::string &path, ModelData &data) {
+    // stores only the directory to append with the texture filenames
+    this->directory = path.substr(0, path.find_last_of('/'));
+    for (unsigned int i = 0 ; i < data.meshes.size() ; i++) {
+        MeshData &mesh = data.meshes[i];
+        // the texture manager skips loading textures that are already
+        // loaded, by this model or any other. those decoded by
+        // decodeTextures are only uploaded.
+        // batched models sample texture arrays built from the paths instead
+        for (unsigned int j = 0 ; j < mesh.textures.size() ; j++) {
+            std::string texturePath = this->directory + '/' + mesh.textures[j].path;
+            mesh.textures[j].id = this->batched ? 0
+                : TextureManager::instance().acquire(texturePath.c_str(), decodedTexture(data, mesh.textures[j].path));
+        }
+        // batched meshes only feed buildBatches(), which creates the buffers.
+        // the vectors are moved, not copied
+        this->meshes.push_back(Mesh(std::move(mesh.vertices), std::move(mesh.indices), std::move(mesh.textures), !this->batched));
+        this->meshes.back().shininess = mesh.shininess;
+        this->meshes.back().boundsCenter = mesh.boundsCenter;
+        this->meshes.back().boundsRadius = mesh.boundsRadius;
+    }
+    if (this->batched)
+        buildBatches(data);
+    else if (MaterialTable::instance().bindless())
+        addBindlessMaterials();
 }
 
-std::vector<Texture> Model::loadMaterialTextures(aiMaterial* material, aiTextureType textureType, std::string textureTypeName) {
-    std::vector<Texture> textures;
-    for (unsigned int i = 0 ; i < material->GetTextureCount(textureType) ; i++) {
-        aiString aiFilename;
-        material->GetTexture(textureType, i, &aiFilename);
-        const char* filename = aiFilename.C_Str();
-        // texture loading skip logic
-        bool skip = false;
-        for (unsigned int j = 0 ; j < this->textures_loaded.size() ; j++) {
-            bool textureAlreadyLoaded = std::strcmp(filename, this->textures_loaded[j].path.data()) == 0;
-            if (textureAlreadyLoaded) {
-                // just assign the loaded texture to the textures array
-                // instead of loading again from the file
-                textures.push_back(this->textures_loaded[j]);
-                skip = true;
-                break;
+void Model::buildBatches(ModelData &data) {
+    // packs the first diffuse and specular texture of every mesh. textures
+    // of the same format and size share an array
+    TextureArrayPacker packer;
+    std::vector<std::pair<int, int>> meshHandles;
+    for (unsigned int i = 0 ; i < this->meshes.size() ; i++) {
+        int diffuse = -1;
+        int specular = -1;
+        for (unsigned int j = 0 ; j < this->meshes[i].textures.size() ; j++) {
+            const Texture &texture = this->meshes[i].textures[j];
+            std::string path = this->directory + '/' + texture.path;
+            if (texture.type == "texture_diffuse" && diffuse == -1)
+                diffuse = packer.add(path, decodedTexture(data, texture.path));
+            else if (texture.type == "texture_specular" && specular == -1)
+                specular = packer.add(path, decodedTexture(data, texture.path));
+        }
+        // without a diffuse texture (or when it failed to load) the mesh
+        // samples a white layer, rather than layer 0 of whatever array
+        // its batch would bind. a missing specular map already selects
+        // NO_SPECULAR_MAP for the batch
+        if (diffuse == -1)
+            diffuse = packer.addColor(255, 255, 255, 255);
+        meshHandles.push_back(std::make_pair(diffuse, specular));
+    }
+    packer.build();
+    this->textureArrays = packer.arrays();
+
+    // meshes sampling the same pair of arrays share a batch. meshes with
+    // the same layers and parameters share a material table entry
+    struct Group {
+        unsigned int diffuseArray;
+        unsigned int specularArray;
+        std::vector<const Mesh*> meshes;
+        std::vector<unsigned int> meshMaterials;
+    };
+    std::vector<Group> groups;
+    std::map<std::pair<unsigned int, unsigned int>, unsigned int> groupsByArrays;
+    std::map<std::pair<std::pair<unsigned int, unsigned int>, float>, unsigned int> materialsByLayers;
+    // meshes left without a table entry, drawn on their own
+    std::vector<unsigned int> unbatched;
+    for (unsigned int i = 0 ; i < this->meshes.size() ; i++) {
+        int diffuse = meshHandles[i].first;
+        int specular = meshHandles[i].second;
+        Material material;
+        material.diffuseTexture = 0;
+        material.specularTexture = 0;
+        material.diffuseLayer = packer.layer(diffuse);
+        material.specularLayer = specular == -1 ? 0 : packer.layer(specular);
+        material.shininess = this->meshes[i].shininess;
+        std::pair<std::pair<unsigned int, unsigned int>, float> key(
+            std::make_pair(material.diffuseLayer, material.specularLayer), material.shininess);
+        std::map<std::pair<std::pair<unsigned int, unsigned int>, float>, unsigned int>::iterator found = materialsByLayers.find(key);
+        if (found == materialsByLayers.end()) {
+            unsigned int index = MaterialTable::instance().add(material);
+            if (index == MaterialTable::invalidIndex) {
+                unbatched.push_back(i);
+                continue;
             }
+            this->materials.push_back(index);
+            found = materialsByLayers.insert(std::make_pair(key, index)).first;
+        }
+
+        std::pair<unsigned int, unsigned int> arrays(packer.array(diffuse), packer.array(specular));
+        std::map<std::pair<unsigned int, unsigned int>, unsigned int>::iterator group = groupsByArrays.find(arrays);
+        if (group == groupsByArrays.end()) {
+            Group created;
+            created.diffuseArray = arrays.first;
+            created.specularArray = arrays.second;
+            groups.push_back(created);
+            group = groupsByArrays.insert(std::make_pair(arrays, (unsigned int) groups.size() - 1)).first;
         }
+        groups[group->second].meshes.push_back(&this->meshes[i]);
+        groups[group->second].meshMaterials.push_back(found->second);
+    }
 
-        // texture loading
-        if (!skip) {
-            Texture texture;
-            std::string path = this->directory + '/' + std::string(filename);
-            texture.id = this->textureFromFile(path.c_str());
-            texture.type = textureTypeName;
-            texture.path = filename;
-            textures.push_back(texture);
-            this->textures_loaded.push_back(texture);
+    for (unsigned int i = 0 ; i < groups.size() ; i++) {
+        this->batches.push_back(MeshBatch(groups[i].meshes, groups[i].meshMaterials,
+            groups[i].diffuseArray, groups[i].specularArray));
+    }
+    // the merged buffers replace the meshes. those that didn't fit in the
+    // table bind their own textures by name instead
+    std::vector<Mesh> remaining;
+    for (unsigned int i = 0 ; i < unbatched.size() ; i++) {
+        Mesh &mesh = this->meshes[unbatched[i]];
+        for (unsigned int j = 0 ; j < mesh.textures.size() ; j++) {
+            std::string texturePath = this->directory + '/' + mesh.textures[j].path;
+            mesh.textures[j].id = TextureManager::instance().acquire(texturePath.c_str());
         }
+        mesh.setup();
+        remaining.push_back(std::move(mesh));
     }
-    return textures;
+    this->meshes.swap(remaining);
 }
 
-unsigned int Model::textureFromFile(const char* path) {
-    unsigned int id;
-    glGenTextures(1, &id);
-
-    int width, height, channels;
-    unsigned char* data = stbi_load(path,
-        &width, &height, &channels, 0);
-
-    if (data != NULL) {
-        GLenum format = 0;
-        if (channels == 1)
-            format = GL_RED;
-        else if (channels == 3)
-            format = GL_RGB;
-        else if (channels == 4)
-            format = GL_RGBA;
-
-        if (format != 0) {
-            glBindTexture(GL_TEXTURE_2D, id);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-            glTexImage2D(GL_TEXTURE_2D, 0, (GLint) format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-            glGenerateMipmap(GL_TEXTURE_2D);
-        } else {
-            printf("Texture load failed\nPath: %s\n", path);
+void Model::addBindlessMaterials() {
+    // one table entry per mesh, holding handles of its first diffuse and
+    // specular texture. the draw then only sets materialIndex
+    for (unsigned int i = 0 ; i < this->meshes.size() ; i++) {
+        Mesh &mesh = this->meshes[i];
+        Material material;
+        material.diffuseTexture = 0;
+        material.specularTexture = 0;
+        material.diffuseLayer = 0;
+        material.specularLayer = 0;
+        material.shininess = mesh.shininess;
+        for (unsigned int j = 0 ; j < mesh.textures.size() ; j++) {
+            if (mesh.textures[j].type == "texture_diffuse" && material.diffuseTexture == 0)
+                material.diffuseTexture = mesh.textures[j].id;
+            else if (mesh.textures[j].type == "texture_specular" && material.specularTexture == 0)
+                material.specularTexture = mesh.textures[j].id;
         }
-    } else {
-        printf("Texture load failed\nPath: %s\n", path);
+        unsigned int index = MaterialTable::instance().add(material);
+        // a full table leaves the mesh binding its textures by name
+        if (index == MaterialTable::invalidIndex)
+            continue;
+        this->materials.push_back(index);
+        mesh.material = (int) index;
+        mesh.defines.push_back("BINDLESS_TEXTURES");
     }
-    stbi_image_free(data);
+}
 
-    return id;
+static TextureData* decodedTexture(ModelData &data, const std::string &path) {
+    std::unordered_map<std::string, TextureData>::iterator found = data.textures.find(path);
+    return found != data.textures.end() ? &found->second : NULL;
 }
\ No newline at end of file
@@ -0,0 +1,408 @@
+#include "model_data.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "assimp/IOStream.hpp"
+#include "assimp/IOSystem.hpp"
+#include "assimp/Importer.hpp"
+#include "assimp/postprocess.h"
+#include "assimp/scene.h"
+
+#include "arena.hpp"
+#include "asset_cache.hpp"
+#include "fileutil.hpp"
+#include "pak.hpp"
+#include "parallel.hpp"
+
+static const char cookedModelMagic[4] = { 'C', 'M', 'D', 'L' };
+// bump when the layout of Vertex or of the file changes
+static const uint32_t cookedModelVersion = 2;
+
+struct CookedModelHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t meshCount;
+    uint32_t reserved;
+};
+
+// followed by the vertices, the indices, then per texture its type and
+// path lengths and characters
+struct CookedMeshHeader {
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t textureCount;
+    float shininess;
+};
+
+// Assimp file reads served by AssetCache: every file is opened once and
+// shared by all the streams Assimp opens on it, and comes from a pak
+// archive when one is mounted. The path of every opened file is recorded
+class AssetIOStream : public Assimp::IOStream {
+public:
+    std::shared_ptr<const AssetFile> file;
+    size_t position;
+
+    explicit AssetIOStream(const std::shared_ptr<const AssetFile> &inFile) : file(inFile), position(0) {}
+
+    size_t Read(void* buffer, size_t size, size_t count) override {
+        if (size == 0)
+            return 0;
+        // whole elements only, like fread
+        size_t elements = std::min(count, (file->size() - position) / size);
+        if (elements > 0)
+            std::memcpy(buffer, file->data() + position, elements * size);
+        position += elements * size;
+        return elements;
+    }
+    size_t Write(const void*, size_t, size_t) override {
+        return 0;
+    }
+    aiReturn Seek(size_t offset, aiOrigin origin) override {
+        // offsets from the end count backwards
+        size_t base = origin == aiOrigin_SET ? 0 : origin == aiOrigin_CUR ? position : file->size();
+        size_t target = origin == aiOrigin_END ? base - offset : base + offset;
+        if ((origin == aiOrigin_END && offset > base) || target > file->size())
+            return aiReturn_FAILURE;
+        position = target;
+        return aiReturn_SUCCESS;
+    }
+    size_t Tell() const override {
+        return position;
+    }
+    size_t FileSize() const override {
+        return file->size();
+    }
+    void Flush() override {}
+};
+
+class AssetIOSystem : public Assimp::IOSystem {
+public:
+    std::vector<std::string> opened;
+
+    bool Exists(const char* path) const override {
+        return AssetCache::instance().contains(path) || assetExists(path);
+    }
+    char getOsSeparator() const override {
+        return '/';
+    }
+    Assimp::IOStream* Open(const char* path, const char* mode) override {
+        // importers only ever read
+        if (std::strchr(mode, 'w') != NULL || std::strchr(mode, 'a') != NULL)
+            return NULL;
+        std::shared_ptr<const AssetFile> file = AssetCache::instance().open(path);
+        if (!file)
+            return NULL;
+        if (std::find(opened.begin(), opened.end(), path) == opened.end())
+            opened.push_back(path);
+        return new AssetIOStream(file);
+    }
+    void Close(Assimp::IOStream* stream) override {
+        delete stream;
+    }
+};
+
+static void collectMeshes(aiNode* node, const aiScene* scene, std::vector<const aiMesh*> &meshes);
+static MeshData processMesh(const aiMesh* mesh, const aiScene* scene);
+static void computeBounds(MeshData &mesh);
+static void loadMaterialTextures(aiMaterial* material, aiTextureType textureType, const char* textureTypeName,
+    std::vector<Texture> &textures);
+static void appendBytes(std::vector<unsigned char> &bytes, const void* data, size_t size);
+static bool readBytes(const AssetFile &file, size_t &offset, void* data, size_t size);
+
+bool importModel(const char* path, ModelData &model, bool optimize, std::vector<std::string>* dependencies) {
+    Assimp::Importer importer;
+    AssetIOSystem* files = new AssetIOSystem();
+    // the importer owns and deletes it
+    importer.SetIOHandler(files);
+    // what the last import of path read (.mtl libraries, .bin buffers) is
+    // read ahead while Assimp parses the model itself
+    AssetCache::instance().prefetch(path);
+
+    // Triangulates the mesh because we only use the GL_TRIANGLES primitive
+    // in our glDrawElements calls. Flips UVs because OpenGL expects images
+    // to have their 0.0 coordinates at the bottom.
+    unsigned int flags = aiProcess_Triangulate | aiProcess_FlipUVs;
+    if (optimize)
+        flags |= aiProcess_JoinIdenticalVertices | aiProcess_ImproveCacheLocality;
+    const aiScene* scene = importer.ReadFile(path, flags);
+
+    if (!scene || !scene->mRootNode || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE) {
+        printf("Assimp model loading error\nPath: %s\n%s", path, importer.GetErrorString());
+        return false;
+    }
+
+    // the scene is only read from here on, so every mesh can be converted
+    // on its own thread
+    std::vector<const aiMesh*> meshes;
+    collectMeshes(scene->mRootNode, scene, meshes);
+    model.meshes.clear();
+    model.meshes.resize(meshes.size());
+    parallelFor((unsigned int) meshes.size(), 1, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int i = begin ; i < end ; i++) {
+            MeshData &mesh = model.meshes[i];
+            mesh = processMesh(meshes[i], scene);
+            if (optimize)
+                optimizeVertexFetch(mesh);
+            generateTangents(mesh);
+            computeBounds(mesh);
+        }
+    });
+
+    model.dataTextures.clear();
+    for (unsigned int i = 0 ; i < scene->mNumMaterials ; i++) {
+        loadMaterialTextures(scene->mMaterials[i], aiTextureType_NORMALS, "texture_normal", model.dataTextures);
+        loadMaterialTextures(scene->mMaterials[i], aiTextureType_HEIGHT, "texture_height", model.dataTextures);
+        loadMaterialTextures(scene->mMaterials[i], aiTextureType_DISPLACEMENT, "texture_height", model.dataTextures);
+    }
+    AssetCache::instance().setDependencies(path, files->opened);
+    if (dependencies != NULL)
+        *dependencies = files->opened;
+    return true;
+}
+
+void optimizeVertexFetch(MeshData &mesh) {
+    const unsigned int unused = 0xFFFFFFFFu;
+    ArenaScope scratch(loadArena());
+    ArenaVector<unsigned int> remap(mesh.vertices.size(), unused, ArenaAllocator<unsigned int>(loadArena()));
+    std::vector<Vertex> vertices;
+    vertices.reserve(mesh.vertices.size());
+    for (unsigned int i = 0 ; i < mesh.indices.size() ; i++) {
+        unsigned int &index = remap[mesh.indices[i]];
+        if (index == unused) {
+            index = (unsigned int) vertices.size();
+            vertices.push_back(mesh.vertices[mesh.indices[i]]);
+        }
+        mesh.indices[i] = index;
+    }
+    mesh.vertices.swap(vertices);
+}
+
+void generateTangents(MeshData &mesh) {
+    // per triangle tangents and bitangents from the texture coordinate
+    // derivatives, summed on the vertices (weighted by triangle area)
+    ArenaScope scratch(loadArena());
+    ArenaAllocator<glm::vec3> allocator(loadArena());
+    ArenaVector<glm::vec3> tangents(mesh.vertices.size(), glm::vec3(0.0f), allocator);
+    ArenaVector<glm::vec3> bitangents(mesh.vertices.size(), glm::vec3(0.0f), allocator);
+    for (size_t i = 0 ; i + 2 < mesh.indices.size() ; i += 3) {
+        const Vertex &a = mesh.vertices[mesh.indices[i]];
+        const Vertex &b = mesh.vertices[mesh.indices[i + 1]];
+        const Vertex &c = mesh.vertices[mesh.indices[i + 2]];
+        glm::vec3 edge1 = b.position - a.position;
+        glm::vec3 edge2 = c.position - a.position;
+        glm::vec2 uv1 = b.texCoords - a.texCoords;
+        glm::vec2 uv2 = c.texCoords - a.texCoords;
+        float determinant = uv1.x * uv2.y - uv2.x * uv1.y;
+        // no texture mapping to follow
+        if (std::fabs(determinant) < 1e-12f)
+            continue;
+        float scale = 1.0f / determinant;
+        glm::vec3 tangent = (edge1 * uv2.y - edge2 * uv1.y) * scale;
+        glm::vec3 bitangent = (edge2 * uv1.x - edge1 * uv2.x) * scale;
+        for (unsigned int j = 0 ; j < 3 ; j++) {
+            tangents[mesh.indices[i + j]] += tangent;
+            bitangents[mesh.indices[i + j]] += bitangent;
+        }
+    }
+
+    for (size_t i = 0 ; i < mesh.vertices.size() ; i++) {
+        Vertex &vertex = mesh.vertices[i];
+        const glm::vec3 &normal = vertex.normal;
+        // Gram-Schmidt against the normal
+        glm::vec3 tangent = tangents[i] - normal * glm::dot(normal, tangents[i]);
+        if (glm::dot(tangent, tangent) < 1e-12f) {
+            // any direction orthogonal to the normal
+            glm::vec3 axis = std::fabs(normal.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+            tangent = glm::cross(normal, axis);
+            if (glm::dot(tangent, tangent) < 1e-12f)
+                tangent = axis;
+        }
+        tangent = glm::normalize(tangent);
+        float handedness = glm::dot(glm::cross(normal, tangent), bitangents[i]) < 0.0f ? -1.0f : 1.0f;
+        vertex.tangent = glm::vec4(tangent, handedness);
+    }
+}
+
+bool saveCookedModel(const char* path, const ModelData &model) {
+    CookedModelHeader header;
+    std::memcpy(header.magic, cookedModelMagic, 4);
+    header.version = cookedModelVersion;
+    header.meshCount = (uint32_t) model.meshes.size();
+    header.reserved = 0;
+
+    std::vector<unsigned char> bytes;
+    appendBytes(bytes, &header, sizeof(header));
+    for (unsigned int i = 0 ; i < model.meshes.size() ; i++) {
+        const MeshData &mesh = model.meshes[i];
+        CookedMeshHeader meshHeader;
+        meshHeader.vertexCount = (uint32_t) mesh.vertices.size();
+        meshHeader.indexCount = (uint32_t) mesh.indices.size();
+        meshHeader.textureCount = (uint32_t) mesh.textures.size();
+        meshHeader.shininess = mesh.shininess;
+        appendBytes(bytes, &meshHeader, sizeof(meshHeader));
+        appendBytes(bytes, mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+        appendBytes(bytes, mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+        for (unsigned int j = 0 ; j < mesh.textures.size() ; j++) {
+            uint32_t lengths[2] = { (uint32_t) mesh.textures[j].type.size(), (uint32_t) mesh.textures[j].path.size() };
+            appendBytes(bytes, lengths, sizeof(lengths));
+            appendBytes(bytes, mesh.textures[j].type.data(), lengths[0]);
+            appendBytes(bytes, mesh.textures[j].path.data(), lengths[1]);
+        }
+    }
+    return writeFileBytes(path, &bytes[0], bytes.size());
+}
+
+bool loadCookedModel(const char* path, ModelData &model) {
+    AssetFile file;
+    if (!file.open(path))
+        return false;
+
+    size_t offset = 0;
+    CookedModelHeader header;
+    if (!readBytes(file, offset, &header, sizeof(header)) || std::memcmp(header.magic, cookedModelMagic, 4) != 0
+        || header.version != cookedModelVersion) {
+        printf("Cooked model load failed, invalid header\nPath: %s\n", path);
+        return false;
+    }
+
+    model.meshes.resize(header.meshCount);
+    for (unsigned int i = 0 ; i < header.meshCount ; i++) {
+        MeshData &mesh = model.meshes[i];
+        CookedMeshHeader meshHeader;
+        bool valid = readBytes(file, offset, &meshHeader, sizeof(meshHeader));
+        // bounded by the file size before anything is allocated
+        valid = valid && (uint64_t) meshHeader.vertexCount * sizeof(Vertex)
+            + (uint64_t) meshHeader.indexCount * sizeof(unsigned int) <= file.size() - offset;
+        if (valid) {
+            mesh.vertices.resize(meshHeader.vertexCount);
+            mesh.indices.resize(meshHeader.indexCount);
+            mesh.shininess = meshHeader.shininess;
+            valid = readBytes(file, offset, mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex))
+                && readBytes(file, offset, mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+        }
+        for (unsigned int j = 0 ; valid && j < meshHeader.textureCount ; j++) {
+            uint32_t lengths[2];
+            valid = readBytes(file, offset, lengths, sizeof(lengths)) && lengths[0] + (uint64_t) lengths[1] <= file.size() - offset;
+            if (valid) {
+                Texture texture;
+                texture.id = 0;
+                texture.type.assign((const char*) file.data() + offset, lengths[0]);
+                texture.path.assign((const char*) file.data() + offset + lengths[0], lengths[1]);
+                offset += lengths[0] + lengths[1];
+                mesh.textures.push_back(texture);
+            }
+        }
+        if (!valid) {
+            printf("Cooked model load failed, truncated file\nPath: %s\n", path);
+            model.meshes.clear();
+            return false;
+        }
+        computeBounds(mesh);
+    }
+    return true;
+}
+
+static void collectMeshes(aiNode* node, const aiScene* scene, std::vector<const aiMesh*> &meshes) {
+    // meshes of the current node first, then its children's
+    for (unsigned int i = 0 ; i < node->mNumMeshes ; i++) {
+        meshes.push_back(scene->mMeshes[node->mMeshes[i]]);
+    }
+    for (unsigned int i = 0 ; i < node->mNumChildren ; i++) {
+        collectMeshes(node->mChildren[i], scene, meshes);
+    }
+}
+
+static MeshData processMesh(const aiMesh* mesh, const aiScene* scene) {
+    MeshData data;
+    data.vertices.reserve(mesh->mNumVertices);
+
+    // move all vertex data to glm vectors
+    for (unsigned int i = 0 ; i < mesh->mNumVertices ; i++) {
+        Vertex vertex;
+        glm::vec3 vector;
+        vector.x = mesh->mVertices[i].x;
+        vector.y = mesh->mVertices[i].y;
+        vector.z = mesh->mVertices[i].z;
+        vertex.position = vector;
+
+        if(mesh->HasNormals()) {
+            vector.x = mesh->mNormals[i].x;
+            vector.y = mesh->mNormals[i].y;
+            vector.z = mesh->mNormals[i].z;
+            vertex.normal = vector;
+        } else
+            vertex.normal = glm::vec3(0.0f, 0.0f, 0.0f);
+
+        if (mesh->mTextureCoords[0]) {
+            vector.x = mesh->mTextureCoords[0][i].x;
+            vector.y = mesh->mTextureCoords[0][i].y;
+            vertex.texCoords = glm::vec2(vector);
+        } else
+            vertex.texCoords = glm::vec2(0.0f, 0.0f);
+        vertex.tangent = glm::vec4(0.0f);
+
+        data.vertices.push_back(vertex);
+    }
+
+    for (unsigned int i = 0 ; i < mesh->mNumFaces ; i++) {
+        aiFace face = mesh->mFaces[i];
+        for (unsigned int j = 0 ; j < face.mNumIndices ; j++) {
+            data.indices.push_back(face.mIndices[j]);
+        }
+    }
+
+    // texture references, loaded by Model
+    data.shininess = 32.0f;
+    if (scene->mNumMaterials > 0) {
+        // scene->mMaterials is of size scene->mNumMaterials
+        aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+        loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", data.textures);
+        loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular", data.textures);
+        material->Get(AI_MATKEY_SHININESS, data.shininess);
+    }
+    return data;
+}
+
+static void loadMaterialTextures(aiMaterial* material, aiTextureType textureType, const char* textureTypeName,
+        std::vector<Texture> &textures) {
+    for (unsigned int i = 0 ; i < material->GetTextureCount(textureType) ; i++) {
+        aiString aiFilename;
+        material->GetTexture(textureType, i, &aiFilename);
+
+        Texture texture;
+        texture.id = 0;
+        texture.type = textureTypeName;
+        texture.path = aiFilename.C_Str();
+        textures.push_back(texture);
+    }
+}
+
+static void appendBytes(std::vector<unsigned char> &bytes, const void* data, size_t size) {
+    const unsigned char* begin = (const unsigned char*) data;
+    bytes.insert(bytes.end(), begin, begin + size);
+}
+
+static void computeBounds(MeshData &mesh) {
+    // sphere around the bounding box, loose but cheap
+    glm::vec3 minimum(0.0f);
+    glm::vec3 maximum(0.0f);
+    for (unsigned int i = 0 ; i < mesh.vertices.size() ; i++) {
+        minimum = i == 0 ? mesh.vertices[i].position : glm::min(minimum, mesh.vertices[i].position);
+        maximum = i == 0 ? mesh.vertices[i].position : glm::max(maximum, mesh.vertices[i].position);
+    }
+    mesh.boundsCenter = (minimum + maximum) * 0.5f;
+    mesh.boundsRadius = glm::length(maximum - mesh.boundsCenter);
+}
+
+static bool readBytes(const AssetFile &file, size_t &offset, void* data, size_t size) {
+    if (size > file.size() - offset)
+        return false;
+    if (size > 0)
+        std::memcpy(data, file.data() + offset, size);
+    offset += size;
+    return true;
+}
\ No newline at end of file
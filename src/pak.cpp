@@ -0,0 +1,284 @@
+#include "pak.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+#ifdef USE_ZSTD
+#include "zstd.h"
+#endif
+
+#include "hash.hpp"
+#include "lz4.hpp"
+
+static const char pakMagic[4] = { 'P', 'A', 'K', '1' };
+// bump when the layout of the archive changes
+static const uint32_t pakVersion = 1;
+
+// the table of contents follows right after, aligned since the header is
+// a multiple of 16 bytes
+struct PakHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t reserved;
+};
+
+struct PakEntry {
+    uint64_t pathHash;
+    uint64_t offset;
+    // bytes in the archive, and once decompressed
+    uint64_t storedSize;
+    uint64_t size;
+    // normalized path, in the names that follow the table of contents
+    uint32_t nameOffset;
+    uint32_t nameLength;
+    uint32_t compression;
+    uint32_t reserved;
+};
+
+static bool compressContents(PakCompression compression, const std::vector<unsigned char> &contents,
+    std::vector<unsigned char> &compressed);
+static bool decompressContents(PakCompression compression, const unsigned char* data, size_t dataSize,
+    unsigned char* output, size_t size);
+static size_t alignedSize(size_t size);
+
+// mounted archives, the most recently mounted last
+static std::vector<std::unique_ptr<PakArchive>> mountedPaks;
+static bool looseFileOverrides = false;
+
+bool writePak(const char* path, const std::vector<PakSource> &files) {
+    std::vector<PakEntry> entries(files.size());
+    std::vector<std::string> names(files.size());
+    std::vector<std::vector<unsigned char>> compressed(files.size());
+    std::vector<unsigned int> order(files.size());
+    for (unsigned int i = 0 ; i < files.size() ; i++) {
+        names[i] = normalizePath(files[i].path.c_str());
+        order[i] = i;
+
+        PakEntry &entry = entries[i];
+        entry.pathHash = hashString(names[i]);
+        entry.compression = (uint32_t) PakCompression::NONE;
+        entry.size = files[i].contents.size();
+        entry.storedSize = entry.size;
+        entry.reserved = 0;
+        // already compressed formats (JPEG, PNG) barely shrink, and are
+        // better mapped as they are than decompressed for a few percent
+        if (files[i].compression != PakCompression::NONE
+            && compressContents(files[i].compression, files[i].contents, compressed[i])
+            && compressed[i].size() <= files[i].contents.size() - files[i].contents.size() / 8) {
+            entry.compression = (uint32_t) files[i].compression;
+            entry.storedSize = compressed[i].size();
+        } else {
+            compressed[i].clear();
+        }
+    }
+    // sorted for binary search, by name among equal hashes
+    std::sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) {
+        return entries[a].pathHash != entries[b].pathHash ? entries[a].pathHash < entries[b].pathHash : names[a] < names[b];
+    });
+
+    PakHeader header;
+    std::memcpy(header.magic, pakMagic, 4);
+    header.version = pakVersion;
+    header.entryCount = (uint32_t) files.size();
+    header.reserved = 0;
+
+    // header, table of contents, names, then the contents
+    size_t namesOffset = sizeof(PakHeader) + files.size() * sizeof(PakEntry);
+    size_t offset = namesOffset;
+    for (unsigned int i = 0 ; i < files.size() ; i++) {
+        entries[i].nameOffset = (uint32_t) (offset - namesOffset);
+        entries[i].nameLength = (uint32_t) names[i].size();
+        offset += names[i].size();
+    }
+    for (unsigned int i = 0 ; i < files.size() ; i++) {
+        PakEntry &entry = entries[order[i]];
+        offset = alignedSize(offset);
+        entry.offset = offset;
+        offset += entry.storedSize;
+    }
+
+    std::vector<unsigned char> bytes(offset, 0);
+    std::memcpy(&bytes[0], &header, sizeof(header));
+    for (unsigned int i = 0 ; i < files.size() ; i++) {
+        unsigned int index = order[i];
+        const PakEntry &entry = entries[index];
+        std::memcpy(&bytes[sizeof(PakHeader) + i * sizeof(PakEntry)], &entry, sizeof(entry));
+        std::memcpy(&bytes[namesOffset + entry.nameOffset], names[index].data(), names[index].size());
+        const std::vector<unsigned char> &contents = compressed[index].empty() ? files[index].contents : compressed[index];
+        if (!contents.empty())
+            std::memcpy(&bytes[entry.offset], &contents[0], contents.size());
+    }
+    return writeFileBytes(path, &bytes[0], bytes.size());
+}
+
+bool PakArchive::open(const char* path) {
+    entries = NULL;
+    entryCount = 0;
+    if (!file.open(path))
+        return false;
+    modified = fileModifiedTime(path);
+
+    PakHeader header;
+    if (file.size() < sizeof(header)) {
+        printf("Pak load failed, not a pak file\nPath: %s\n", path);
+        file.close();
+        return false;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, pakMagic, 4) != 0 || header.version != pakVersion
+        || (file.size() - sizeof(header)) / sizeof(PakEntry) < header.entryCount) {
+        printf("Pak load failed, invalid header\nPath: %s\n", path);
+        file.close();
+        return false;
+    }
+
+    // checked once here so that lookups can trust every entry
+    const PakEntry* table = (const PakEntry*) (file.data() + sizeof(header));
+    size_t namesOffset = sizeof(header) + header.entryCount * sizeof(PakEntry);
+    for (unsigned int i = 0 ; i < header.entryCount ; i++) {
+        bool valid = table[i].nameOffset + (uint64_t) table[i].nameLength <= file.size() - namesOffset
+            && table[i].offset <= file.size() && table[i].storedSize <= file.size() - table[i].offset
+            && table[i].compression <= (uint32_t) PakCompression::ZSTD
+            && (table[i].compression != (uint32_t) PakCompression::NONE || table[i].storedSize == table[i].size);
+        if (!valid) {
+            printf("Pak load failed, invalid table of contents\nPath: %s\n", path);
+            file.close();
+            return false;
+        }
+    }
+    entries = table;
+    entryCount = header.entryCount;
+    return true;
+}
+
+bool PakArchive::read(const char* path, const unsigned char* &data, size_t &size,
+        std::vector<unsigned char> &decompressed) const {
+    const PakEntry* entry = find(normalizePath(path));
+    if (entry == NULL)
+        return false;
+
+    const unsigned char* stored = file.data() + entry->offset;
+    size = (size_t) entry->size;
+    PakCompression compression = (PakCompression) entry->compression;
+    if (compression == PakCompression::NONE) {
+        data = stored;
+        return true;
+    }
+
+    decompressed.resize(size);
+    if (!decompressContents(compression, stored, (size_t) entry->storedSize, decompressed.data(), size)) {
+        printf("Pak entry decompression failed\nPath: %s\n", path);
+        return false;
+    }
+    data = decompressed.data();
+    return true;
+}
+
+bool PakArchive::contains(const char* path) const {
+    return find(normalizePath(path)) != NULL;
+}
+
+size_t PakArchive::size() const {
+    return entryCount;
+}
+
+const PakEntry* PakArchive::find(const std::string &normalizedPath) const {
+    uint64_t hash = hashString(normalizedPath);
+    const PakEntry* end = entries + entryCount;
+    const PakEntry* entry = std::lower_bound(entries, end, hash, [](const PakEntry &a, uint64_t b) {
+        return a.pathHash < b;
+    });
+    const char* names = (const char*) file.data() + sizeof(PakHeader) + entryCount * sizeof(PakEntry);
+    for ( ; entry != end && entry->pathHash == hash ; ++entry) {
+        if (entry->nameLength == normalizedPath.size()
+            && std::memcmp(names + entry->nameOffset, normalizedPath.data(), normalizedPath.size()) == 0)
+            return entry;
+    }
+    return NULL;
+}
+
+bool mountPak(const char* path) {
+    std::unique_ptr<PakArchive> archive(new PakArchive());
+    if (!archive->open(path))
+        return false;
+    mountedPaks.push_back(std::move(archive));
+    return true;
+}
+
+void setLooseFileOverrides(bool enabled) {
+    looseFileOverrides = enabled;
+}
+
+bool AssetFile::open(const char* path) {
+    close();
+    for (size_t i = mountedPaks.size() ; i-- > 0 ; ) {
+        if (!mountedPaks[i]->contains(path))
+            continue;
+        // edited since the archive was made, the loose file wins
+        if (looseFileOverrides && fileModifiedTime(path) > mountedPaks[i]->modifiedTime())
+            break;
+        if (mountedPaks[i]->read(path, bytes, length, decompressed))
+            return true;
+    }
+    if (!file.open(path))
+        return false;
+    bytes = file.data();
+    length = file.size();
+    return true;
+}
+
+void AssetFile::close() {
+    file.close();
+    std::vector<unsigned char>().swap(decompressed);
+    bytes = NULL;
+    length = 0;
+}
+
+bool assetExists(const char* path) {
+    for (size_t i = 0 ; i < mountedPaks.size() ; i++) {
+        if (mountedPaks[i]->contains(path))
+            return true;
+    }
+    return fileExists(path);
+}
+
+static bool compressContents(PakCompression compression, const std::vector<unsigned char> &contents,
+        std::vector<unsigned char> &compressed) {
+    if (contents.empty())
+        return false;
+    if (compression == PakCompression::LZ4) {
+        compressLZ4(&contents[0], contents.size(), compressed);
+        return true;
+    }
+#ifdef USE_ZSTD
+    if (compression == PakCompression::ZSTD) {
+        compressed.resize(ZSTD_compressBound(contents.size()));
+        size_t size = ZSTD_compress(&compressed[0], compressed.size(), &contents[0], contents.size(), 19);
+        if (ZSTD_isError(size))
+            return false;
+        compressed.resize(size);
+        return true;
+    }
+#endif
+    return false;
+}
+
+static bool decompressContents(PakCompression compression, const unsigned char* data, size_t dataSize,
+        unsigned char* output, size_t size) {
+    if (compression == PakCompression::LZ4)
+        return decompressLZ4(data, dataSize, output, size);
+#ifdef USE_ZSTD
+    if (compression == PakCompression::ZSTD) {
+        size_t result = ZSTD_decompress(output, size, data, dataSize);
+        return !ZSTD_isError(result) && result == size;
+    }
+#endif
+    return false;
+}
+
+static size_t alignedSize(size_t size) {
+    return (size + pakAlignment - 1) / pakAlignment * pakAlignment;
+}
\ No newline at end of file
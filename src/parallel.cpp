@@ -0,0 +1,39 @@
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <thread>
+
+#include "job_system.hpp"
+
+// ranges per thread, so that threads finishing early steal the rest
+static const unsigned int rangesPerThread = 4;
+
+void parallelFor(unsigned int count, unsigned int grain, const std::function<void(unsigned int, unsigned int)> &body) {
+    grain = std::max(grain, 1u);
+    unsigned int ranges = std::min(workerCount() * rangesPerThread, (count + grain - 1) / grain);
+    if (ranges <= 1) {
+        if (count > 0)
+            body(0, count);
+        return;
+    }
+
+    // the first count % ranges ranges take one extra item
+    unsigned int size = count / ranges;
+    unsigned int extra = count % ranges;
+    JobSystem &jobs = JobSystem::instance();
+    JobCounter counter;
+    unsigned int begin = size + (extra > 0 ? 1 : 0);
+    for (unsigned int i = 1 ; i < ranges ; i++) {
+        unsigned int end = begin + size + (i < extra ? 1 : 0);
+        jobs.run([&body, begin, end]() { body(begin, end); }, &counter);
+        begin = end;
+    }
+    body(0, size + (extra > 0 ? 1 : 0));
+    jobs.wait(counter);
+}
+
+unsigned int workerCount() {
+    // 0 when the implementation can't tell
+    static const unsigned int count = std::max(std::thread::hardware_concurrency(), 1u);
+    return count;
+}
\ No newline at end of file
@@ -0,0 +1,224 @@
+#include "profiler.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+#include "glad/glad.h"
+
+#include "fileutil.hpp"
+
+// weight of the newest frame in the averages
+static const double smoothing = 0.1;
+// queries generated at once when a frame's pool runs out
+static const unsigned int queryBatch = 16;
+
+static double milliseconds(std::chrono::steady_clock::duration duration);
+
+Profiler &Profiler::instance() {
+    static Profiler profiler;
+    return profiler;
+}
+
+Profiler::Profiler()
+        : frameIndex(0), start(Clock::now()), gpuOffset(0), calibrated(false), captureFrames(0), captureInFlight(0) {
+    for (unsigned int i = 0 ; i < queryFrames ; i++) {
+        frames[i].used = 0;
+        frames[i].pending = false;
+        frames[i].captured = false;
+    }
+}
+
+void Profiler::beginFrame() {
+    if (!calibrated)
+        calibrate();
+
+    // the slot we are about to reuse holds the queries issued queryFrames
+    // frames ago, which should be available by now
+    frameIndex = (frameIndex + 1) % queryFrames;
+    Frame &frame = frames[frameIndex];
+    if (frame.pending)
+        collect(frame);
+
+    frame.scopes.clear();
+    frame.used = 0;
+    frame.captured = captureFrames > 0;
+    if (frame.captured) {
+        captureFrames--;
+        captureInFlight++;
+    }
+    // scopes left open by the previous frame are not measured
+    open.clear();
+}
+
+void Profiler::begin(const char* name) {
+    Frame &frame = frames[frameIndex];
+    Scope scope;
+    scope.name = name;
+    scope.gpuBegin = timestamp(frame);
+    scope.gpuEnd = scope.gpuBegin;
+    scope.cpuBegin = Clock::now();
+    scope.cpuEnd = scope.cpuBegin;
+    open.push_back((unsigned int) frame.scopes.size());
+    frame.scopes.push_back(scope);
+    frame.pending = true;
+}
+
+void Profiler::end() {
+    if (open.empty())
+        return;
+    Frame &frame = frames[frameIndex];
+    Scope &scope = frame.scopes[open.back()];
+    open.pop_back();
+    scope.cpuEnd = Clock::now();
+    scope.gpuEnd = timestamp(frame);
+}
+
+const std::vector<PassTiming> &Profiler::passes() const {
+    return timings;
+}
+
+void Profiler::print() const {
+    for (unsigned int i = 0 ; i < timings.size() ; i++) {
+        printf("%-16s cpu %7.3f ms  gpu %7.3f ms\n", timings[i].name, timings[i].cpuMilliseconds, timings[i].gpuMilliseconds);
+    }
+}
+
+void Profiler::capture(unsigned int frameCount, const char* path) {
+    if (captureFrames > 0 || captureInFlight > 0)
+        return;
+    capturePath = path;
+    captureFrames = frameCount;
+    trace.clear();
+    // the clocks drift apart, so they are lined up again for every capture
+    calibrate();
+}
+
+unsigned int Profiler::timestamp(Frame &frame) {
+    if (frame.used == frame.queries.size()) {
+        frame.queries.resize(frame.used + queryBatch);
+        glGenQueries((GLsizei) queryBatch, &frame.queries[frame.used]);
+    }
+    glQueryCounter(frame.queries[frame.used], GL_TIMESTAMP);
+    return frame.used++;
+}
+
+void Profiler::calibrate() {
+    // the GPU time at which this call is processed, which with nothing
+    // else queued is about now
+    GLint64 gpuNow = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+    long long cpuNow = (long long) std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    gpuOffset = cpuNow - (long long) gpuNow;
+    calibrated = true;
+}
+
+void Profiler::collect(Frame &frame) {
+    frame.pending = false;
+    bool captured = frame.captured;
+    frame.captured = false;
+    if (captured)
+        captureInFlight--;
+
+    // timestamps are written in order, so once the last one is available
+    // all of them are. never wait for it: if the GPU is further behind
+    // than expected, the frame is dropped instead
+    GLint available = 0;
+    if (frame.used > 0)
+        glGetQueryObjectiv(frame.queries[frame.used - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+
+    if (available) {
+        size_t known = timings.size();
+        for (unsigned int i = 0 ; i < known ; i++) {
+            frameCpu[i] = 0.0;
+            frameGpu[i] = 0.0;
+        }
+
+        for (unsigned int i = 0 ; i < frame.scopes.size() ; i++) {
+            const Scope &scope = frame.scopes[i];
+            GLuint64 gpuBegin = 0;
+            GLuint64 gpuEnd = 0;
+            glGetQueryObjectui64v(frame.queries[scope.gpuBegin], GL_QUERY_RESULT, &gpuBegin);
+            glGetQueryObjectui64v(frame.queries[scope.gpuEnd], GL_QUERY_RESULT, &gpuEnd);
+
+            unsigned int index = timingIndex(scope.name);
+            frameCpu[index] += milliseconds(scope.cpuEnd - scope.cpuBegin);
+            frameGpu[index] += (double) (gpuEnd - gpuBegin) / 1000000.0;
+
+            if (captured) {
+                TraceEvent cpuEvent;
+                cpuEvent.name = scope.name;
+                cpuEvent.gpu = false;
+                cpuEvent.begin = milliseconds(scope.cpuBegin - start) * 1000.0;
+                cpuEvent.duration = milliseconds(scope.cpuEnd - scope.cpuBegin) * 1000.0;
+                trace.push_back(cpuEvent);
+
+                TraceEvent gpuEvent;
+                gpuEvent.name = scope.name;
+                gpuEvent.gpu = true;
+                gpuEvent.begin = (double) ((long long) gpuBegin + gpuOffset) / 1000.0;
+                gpuEvent.duration = (double) (gpuEnd - gpuBegin) / 1000.0;
+                trace.push_back(gpuEvent);
+            }
+        }
+
+        // names first seen in this frame start from its times
+        for (unsigned int i = 0 ; i < timings.size() ; i++) {
+            PassTiming &timing = timings[i];
+            double weight = i < known ? smoothing : 1.0;
+            timing.cpuMilliseconds += (frameCpu[i] - timing.cpuMilliseconds) * weight;
+            timing.gpuMilliseconds += (frameGpu[i] - timing.gpuMilliseconds) * weight;
+        }
+    }
+
+    if (captured && captureFrames == 0 && captureInFlight == 0)
+        writeTrace();
+}
+
+unsigned int Profiler::timingIndex(const char* name) {
+    for (unsigned int i = 0 ; i < timings.size() ; i++) {
+        // the same literal usually has the same address
+        if (timings[i].name == name || std::strcmp(timings[i].name, name) == 0)
+            return i;
+    }
+
+    PassTiming timing;
+    timing.name = name;
+    timing.cpuMilliseconds = 0.0;
+    timing.gpuMilliseconds = 0.0;
+    timings.push_back(timing);
+    frameCpu.push_back(0.0);
+    frameGpu.push_back(0.0);
+    return (unsigned int) timings.size() - 1;
+}
+
+void Profiler::writeTrace() {
+    // Chrome's trace event format: complete ("X") events in microseconds,
+    // and metadata ("M") events naming the two tracks
+    std::ostringstream stream;
+    stream.setf(std::ios::fixed);
+    stream.precision(3);
+    stream << "{\"traceEvents\":[\n";
+    stream << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n";
+    stream << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}";
+    for (unsigned int i = 0 ; i < trace.size() ; i++) {
+        const TraceEvent &event = trace[i];
+        stream << ",\n{\"name\":\"" << event.name << "\",\"cat\":\"" << (event.gpu ? "gpu" : "cpu")
+            << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << (event.gpu ? 2 : 1)
+            << ",\"ts\":" << event.begin << ",\"dur\":" << event.duration << '}';
+    }
+    stream << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+    std::string text = stream.str();
+    if (!writeFileBytes(capturePath.c_str(), text.data(), text.size())) {
+        printf("Profile capture write failed\nPath: %s\n", capturePath.c_str());
+        return;
+    }
+    printf("Profile capture written\nPath: %s\n", capturePath.c_str());
+    print();
+    trace.clear();
+}
+
+static double milliseconds(std::chrono::steady_clock::duration duration) {
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
\ No newline at end of file
@@ -0,0 +1,105 @@
+#include "program_binary_cache.hpp"
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "glad/glad.h"
+
+#include "fileutil.hpp"
+#include "gl_extensions.hpp"
+#include "hash.hpp"
+
+// stored in front of every binary, so stale or foreign files are detected
+struct ProgramBinaryHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t key;
+    uint32_t format;
+    uint32_t length;
+};
+
+static const char binaryMagic[4] = { 'L', 'G', 'P', 'B' };
+static const uint32_t binaryVersion = 1;
+
+ProgramBinaryCache::ProgramBinaryCache(const char* inDirectory) {
+    directory = inDirectory;
+    supported = glExtensions().programBinary && makeDirectories(directory);
+
+    const char* vendor = (const char*) glGetString(GL_VENDOR);
+    const char* renderer = (const char*) glGetString(GL_RENDERER);
+    const char* version = (const char*) glGetString(GL_VERSION);
+    driverHash = hashString(vendor != NULL ? vendor : "");
+    driverHash = hashString(renderer != NULL ? renderer : "", driverHash);
+    driverHash = hashString(version != NULL ? version : "", driverHash);
+}
+
+bool ProgramBinaryCache::enabled() const {
+    return supported;
+}
+
+uint64_t ProgramBinaryCache::key(uint64_t sourceHash) const {
+    return hashCombine(driverHash, sourceHash);
+}
+
+bool ProgramBinaryCache::load(uint64_t cacheKey, unsigned int program) {
+    if (!supported)
+        return false;
+
+    std::vector<unsigned char> bytes;
+    if (!readFileBytes(pathFor(cacheKey).c_str(), bytes) || bytes.size() < sizeof(ProgramBinaryHeader))
+        return false;
+
+    ProgramBinaryHeader header;
+    std::memcpy(&header, &bytes[0], sizeof(header));
+    bool valid = std::memcmp(header.magic, binaryMagic, sizeof(binaryMagic)) == 0
+        && header.version == binaryVersion
+        && header.key == cacheKey
+        && header.length == bytes.size() - sizeof(header);
+    if (!valid)
+        return false;
+
+    glProgramBinary(program, header.format, &bytes[sizeof(header)], (GLsizei) header.length);
+
+    // the driver may still reject a binary, e.g. after an update that
+    // kept the same version string
+    int success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    return success != 0;
+}
+
+void ProgramBinaryCache::save(uint64_t cacheKey, unsigned int program) {
+    if (!supported)
+        return;
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    std::vector<unsigned char> bytes(sizeof(ProgramBinaryHeader) + (size_t) length);
+    ProgramBinaryHeader header;
+    std::memcpy(header.magic, binaryMagic, sizeof(binaryMagic));
+    header.version = binaryVersion;
+    header.key = cacheKey;
+
+    GLenum format = 0;
+    GLsizei written = 0;
+    glGetProgramBinary(program, length, &written, &format, &bytes[sizeof(header)]);
+    if (written <= 0)
+        return;
+    header.format = format;
+    header.length = (uint32_t) written;
+    std::memcpy(&bytes[0], &header, sizeof(header));
+
+    std::string path = pathFor(cacheKey);
+    if (!writeFileBytes(path.c_str(), &bytes[0], sizeof(header) + (size_t) written))
+        printf("Program binary cache write failed\nPath: %s\n", path.c_str());
+}
+
+std::string ProgramBinaryCache::pathFor(uint64_t cacheKey) const {
+    char filename[32];
+    snprintf(filename, sizeof(filename), "%016" PRIx64 ".bin", cacheKey);
+    return directory + '/' + filename;
+}
\ No newline at end of file
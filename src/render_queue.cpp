@@ -0,0 +1,252 @@
+#include "render_queue.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include "glad/glad.h"
+
+#include "command_list.hpp"
+#include "mesh.hpp"
+#include "shader.hpp"
+#include "texture_manager.hpp"
+
+// opaque draws recorded per job, enough to amortize starting the job
+static const unsigned int recordGrain = 256;
+
+static bool inFrustum(const glm::vec4* planes, const DrawItem &item);
+static void radixSort(uint32_t* keys, uint32_t* values, uint32_t* keysScratch, uint32_t* valuesScratch, size_t count);
+static void requestItemTextures(const DrawItem &item, const glm::mat4 &view, const glm::mat4 &projection,
+    int screenHeight);
+
+DrawItem::DrawItem()
+        : model(1.0f), center(0.0f), radius(0.0f), mesh(NULL), VAO(0), depthVAO(0), texture(0), first(0), count(0), stencilMask(0x00) {
+}
+
+void RenderQueue::clear() {
+    opaque.clear();
+    transparent.clear();
+}
+
+void RenderQueue::push(const DrawItem &item, bool isTransparent) {
+    if (isTransparent)
+        transparent.push_back(item);
+    else
+        opaque.push_back(item);
+}
+
+void RenderQueue::sort(const glm::mat4 &view) {
+    sortItems(opaque, opaqueOrder, view, false);
+    sortItems(transparent, transparentOrder, view, true);
+}
+
+void RenderQueue::requestTextures(const glm::mat4 &view, const glm::mat4 &projection, int screenHeight) const {
+    for (unsigned int i = 0 ; i < opaque.size() ; i++) {
+        requestItemTextures(opaque[i], view, projection, screenHeight);
+    }
+    for (unsigned int i = 0 ; i < transparent.size() ; i++) {
+        requestItemTextures(transparent[i], view, projection, screenHeight);
+    }
+}
+
+void RenderQueue::drawOpaque(Shader &shader) {
+    for (unsigned int i = 0 ; i < opaqueOrder.size() ; i++) {
+        drawItem(opaque[opaqueOrder[i]], shader);
+    }
+}
+
+void RenderQueue::recordOpaque(CommandRecorder &recorder, Shader &shader, const glm::mat4 &viewProjection) const {
+    // captured by a single reference: a std::function only stores two
+    // pointers without allocating
+    struct {
+        glm::vec4 planes[6];
+        Shader* pipeline;
+    } recording;
+
+    // the frustum planes are sums and differences of the rows of the
+    // view projection matrix, pointing inwards
+    glm::mat4 rows = glm::transpose(viewProjection);
+    for (int i = 0 ; i < 3 ; i++) {
+        recording.planes[i * 2] = rows[3] + rows[i];
+        recording.planes[i * 2 + 1] = rows[3] - rows[i];
+    }
+    recording.pipeline = &shader;
+
+    recorder.record((unsigned int) opaqueOrder.size(), recordGrain, [this, &recording](CommandList &list, unsigned int begin, unsigned int end) {
+        for (unsigned int i = begin ; i < end ; i++) {
+            const DrawItem &item = opaque[opaqueOrder[i]];
+            if (!inFrustum(recording.planes, item))
+                continue;
+
+            DrawCommand command;
+            command.pipeline = recording.pipeline;
+            command.mesh = item.mesh;
+            command.vertexArray = item.VAO;
+            command.texture = item.texture;
+            command.first = item.first;
+            command.count = item.count;
+            command.stencilMask = item.stencilMask;
+            list.draw(command, item.model);
+        }
+    });
+}
+
+void RenderQueue::drawOpaqueDepth(Shader &depthShader) {
+    for (unsigned int i = 0 ; i < opaqueOrder.size() ; i++) {
+        const DrawItem &item = opaque[opaqueOrder[i]];
+        depthShader.setMat4("model", item.model);
+        if (item.mesh != NULL) {
+            item.mesh->DrawDepth();
+        } else {
+            glBindVertexArray(item.depthVAO);
+            glDrawArrays(GL_TRIANGLES, item.first, item.count);
+        }
+    }
+    glBindVertexArray(0);
+}
+
+void RenderQueue::drawTransparent(Shader &shader) {
+    for (unsigned int i = 0 ; i < transparentOrder.size() ; i++) {
+        drawItem(transparent[transparentOrder[i]], shader);
+    }
+}
+
+void RenderQueue::sortItems(const std::vector<DrawItem> &items, std::vector<uint32_t> &order, const glm::mat4 &view, bool backToFront) {
+    size_t count = items.size();
+    order.resize(count);
+    depths.resize(count);
+    keys.resize(count);
+    keysScratch.resize(count);
+    indicesScratch.resize(count);
+    if (count == 0)
+        return;
+
+    // only the z row of the view matrix is needed for view-space depth,
+    // which saves transforming the full point for every draw
+    glm::vec4 viewZ(view[0][2], view[1][2], view[2][2], view[3][2]);
+
+    float minDepth = 0.0f;
+    float maxDepth = 0.0f;
+    for (size_t i = 0 ; i < count ; i++) {
+        const DrawItem &item = items[i];
+        glm::vec4 worldCenter = item.model * glm::vec4(item.center, 1.0f);
+        // the camera looks down -z, so negate to get distance in front of it
+        float depth = -glm::dot(viewZ, worldCenter);
+        depths[i] = depth;
+        minDepth = i == 0 ? depth : std::min(minDepth, depth);
+        maxDepth = i == 0 ? depth : std::max(maxDepth, depth);
+        order[i] = (uint32_t) i;
+    }
+
+    // quantize the depths of this frame to 16 bits, so the radix sort only
+    // needs two passes. 65536 buckets are far finer than draw order needs
+    float range = maxDepth - minDepth;
+    float scale = range > 0.0f ? 65535.0f / range : 0.0f;
+    for (size_t i = 0 ; i < count ; i++) {
+        uint32_t key = (uint32_t) ((depths[i] - minDepth) * scale);
+        // inverting the key reverses the order, giving back-to-front
+        keys[i] = backToFront ? 0xFFFFu - key : key;
+    }
+
+    radixSort(&keys[0], &order[0], &keysScratch[0], &indicesScratch[0], count);
+}
+
+void RenderQueue::drawItem(const DrawItem &item, Shader &shader) {
+    glStencilMask(item.stencilMask);
+    shader.setMat4("model", item.model);
+    if (item.mesh != NULL) {
+        item.mesh->Draw(shader);
+    } else {
+        glBindTexture(GL_TEXTURE_2D, item.texture);
+        glBindVertexArray(item.VAO);
+        glDrawArrays(GL_TRIANGLES, item.first, item.count);
+        glBindVertexArray(0);
+    }
+}
+
+// Whether the bounding sphere of the item is at least partly inside every
+// plane. the planes aren't normalized, so each distance is compared with
+// the radius scaled by the length of the plane's normal.
+static bool inFrustum(const glm::vec4* planes, const DrawItem &item) {
+    glm::vec3 center = item.mesh != NULL ? item.mesh->boundsCenter : item.center;
+    float radius = item.mesh != NULL ? item.mesh->boundsRadius : item.radius;
+    if (radius <= 0.0f)
+        return true;
+
+    // the largest axis scale of the model matrix scales the radius
+    float scale = glm::max(glm::length(glm::vec3(item.model[0])),
+        glm::max(glm::length(glm::vec3(item.model[1])), glm::length(glm::vec3(item.model[2]))));
+    glm::vec4 worldCenter = item.model * glm::vec4(center, 1.0f);
+    for (unsigned int i = 0 ; i < 6 ; i++) {
+        if (glm::dot(planes[i], worldCenter) < -radius * scale * glm::length(glm::vec3(planes[i])))
+            return false;
+    }
+    return true;
+}
+
+// Stable least significant digit radix sort of keys, moving values along.
+// Sorts 8 bits per pass, skipping passes where every key has the same digit
+// (always the case for the upper 16 bits of quantized depths). The
+// sorted result always ends up back in keys/values.
+static void radixSort(uint32_t* keys, uint32_t* values, uint32_t* keysScratch, uint32_t* valuesScratch, size_t count) {
+    uint32_t* srcKeys = keys;
+    uint32_t* srcValues = values;
+    uint32_t* dstKeys = keysScratch;
+    uint32_t* dstValues = valuesScratch;
+
+    for (unsigned int shift = 0 ; shift < 32 ; shift += 8) {
+        size_t histogram[256] = {};
+        for (size_t i = 0 ; i < count ; i++) {
+            histogram[(srcKeys[i] >> shift) & 0xFF]++;
+        }
+
+        // all keys share this digit, the pass would not change the order
+        if (histogram[(srcKeys[0] >> shift) & 0xFF] == count)
+            continue;
+
+        // exclusive prefix sum turns the counts into output offsets
+        size_t offset = 0;
+        for (unsigned int digit = 0 ; digit < 256 ; digit++) {
+            size_t digitCount = histogram[digit];
+            histogram[digit] = offset;
+            offset += digitCount;
+        }
+
+        for (size_t i = 0 ; i < count ; i++) {
+            size_t destination = histogram[(srcKeys[i] >> shift) & 0xFF]++;
+            dstKeys[destination] = srcKeys[i];
+            dstValues[destination] = srcValues[i];
+        }
+
+        std::swap(srcKeys, dstKeys);
+        std::swap(srcValues, dstValues);
+    }
+
+    if (srcKeys != keys) {
+        std::memcpy(keys, srcKeys, count * sizeof(uint32_t));
+        std::memcpy(values, srcValues, count * sizeof(uint32_t));
+    }
+}
+
+static void requestItemTextures(const DrawItem &item, const glm::mat4 &view, const glm::mat4 &projection,
+    int screenHeight) {
+    glm::vec3 center = item.mesh != NULL ? item.mesh->boundsCenter : item.center;
+    float radius = item.mesh != NULL ? item.mesh->boundsRadius : item.radius;
+    // the largest axis scale of the model matrix scales the radius
+    float scale = glm::max(glm::length(glm::vec3(item.model[0])),
+        glm::max(glm::length(glm::vec3(item.model[1])), glm::length(glm::vec3(item.model[2]))));
+
+    // diameter / (2 * depth * tan(fov / 2)) of the screen height, where
+    // projection[1][1] is 1 / tan(fov / 2). draws around the camera are
+    // treated as if they were at the near plane
+    float depth = glm::max(-(view * item.model * glm::vec4(center, 1.0f)).z, 0.1f);
+    float pixels = radius * scale * projection[1][1] / depth * (float) screenHeight;
+
+    if (item.mesh != NULL) {
+        for (unsigned int i = 0 ; i < item.mesh->textures.size() ; i++) {
+            TextureManager::instance().request(item.mesh->textures[i].id, pixels);
+        }
+    } else {
+        TextureManager::instance().request(item.texture, pixels);
+    }
+}
\ No newline at end of file
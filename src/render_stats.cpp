@@ -0,0 +1,214 @@
+#include "render_stats.hpp"
+
+#include "glad/glad.h"
+
+// the counts of the installing thread, NULL on every other thread
+static thread_local FrameStats* counted = NULL;
+
+// the driver's entry points, called by the wrappers
+static PFNGLDRAWARRAYSPROC drawArrays;
+static PFNGLDRAWELEMENTSPROC drawElements;
+static PFNGLUSEPROGRAMPROC useProgram;
+static PFNGLBINDTEXTUREPROC bindTexture;
+static PFNGLBINDVERTEXARRAYPROC bindVertexArray;
+static PFNGLUNIFORM1IVPROC uniform1iv;
+static PFNGLUNIFORM1FVPROC uniform1fv;
+static PFNGLUNIFORM2FVPROC uniform2fv;
+static PFNGLUNIFORM3FVPROC uniform3fv;
+static PFNGLUNIFORM4FVPROC uniform4fv;
+static PFNGLUNIFORMMATRIX2FVPROC uniformMatrix2fv;
+static PFNGLUNIFORMMATRIX3FVPROC uniformMatrix3fv;
+static PFNGLUNIFORMMATRIX4FVPROC uniformMatrix4fv;
+static PFNGLBUFFERDATAPROC bufferData;
+static PFNGLBUFFERSUBDATAPROC bufferSubData;
+
+static void countDraw(GLenum mode, GLsizei count);
+static void APIENTRY countedDrawArrays(GLenum mode, GLint first, GLsizei count);
+static void APIENTRY countedDrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices);
+static void APIENTRY countedUseProgram(GLuint program);
+static void APIENTRY countedBindTexture(GLenum target, GLuint texture);
+static void APIENTRY countedBindVertexArray(GLuint array);
+static void APIENTRY countedUniform1iv(GLint location, GLsizei count, const GLint* value);
+static void APIENTRY countedUniform1fv(GLint location, GLsizei count, const GLfloat* value);
+static void APIENTRY countedUniform2fv(GLint location, GLsizei count, const GLfloat* value);
+static void APIENTRY countedUniform3fv(GLint location, GLsizei count, const GLfloat* value);
+static void APIENTRY countedUniform4fv(GLint location, GLsizei count, const GLfloat* value);
+static void APIENTRY countedUniformMatrix2fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value);
+static void APIENTRY countedUniformMatrix3fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value);
+static void APIENTRY countedUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value);
+static void APIENTRY countedBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage);
+static void APIENTRY countedBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data);
+
+RenderStats &RenderStats::instance() {
+    static RenderStats stats;
+    return stats;
+}
+
+RenderStats::RenderStats() : counts(), lastCounts() {
+}
+
+void RenderStats::install() {
+    counted = &counts;
+    // installing twice would make the wrappers call themselves
+    if (glad_glDrawArrays == countedDrawArrays)
+        return;
+
+    drawArrays = glad_glDrawArrays;
+    drawElements = glad_glDrawElements;
+    useProgram = glad_glUseProgram;
+    bindTexture = glad_glBindTexture;
+    bindVertexArray = glad_glBindVertexArray;
+    uniform1iv = glad_glUniform1iv;
+    uniform1fv = glad_glUniform1fv;
+    uniform2fv = glad_glUniform2fv;
+    uniform3fv = glad_glUniform3fv;
+    uniform4fv = glad_glUniform4fv;
+    uniformMatrix2fv = glad_glUniformMatrix2fv;
+    uniformMatrix3fv = glad_glUniformMatrix3fv;
+    uniformMatrix4fv = glad_glUniformMatrix4fv;
+    bufferData = glad_glBufferData;
+    bufferSubData = glad_glBufferSubData;
+
+    glad_glDrawArrays = countedDrawArrays;
+    glad_glDrawElements = countedDrawElements;
+    glad_glUseProgram = countedUseProgram;
+    glad_glBindTexture = countedBindTexture;
+    glad_glBindVertexArray = countedBindVertexArray;
+    glad_glUniform1iv = countedUniform1iv;
+    glad_glUniform1fv = countedUniform1fv;
+    glad_glUniform2fv = countedUniform2fv;
+    glad_glUniform3fv = countedUniform3fv;
+    glad_glUniform4fv = countedUniform4fv;
+    glad_glUniformMatrix2fv = countedUniformMatrix2fv;
+    glad_glUniformMatrix3fv = countedUniformMatrix3fv;
+    glad_glUniformMatrix4fv = countedUniformMatrix4fv;
+    glad_glBufferData = countedBufferData;
+    glad_glBufferSubData = countedBufferSubData;
+}
+
+void RenderStats::endFrame() {
+    lastCounts = counts;
+    counts = FrameStats();
+}
+
+const FrameStats &RenderStats::current() const {
+    return counts;
+}
+
+const FrameStats &RenderStats::last() const {
+    return lastCounts;
+}
+
+void RenderStats::print(const FrameStats &stats, bool json, FILE* file) {
+    if (json) {
+        fprintf(file, "{\"drawCalls\":%llu,\"triangles\":%llu,\"vertices\":%llu,\"programBinds\":%llu,"
+            "\"textureBinds\":%llu,\"vertexArrayBinds\":%llu,\"uniformUpdates\":%llu,\"bufferUploadBytes\":%llu}\n",
+            stats.drawCalls, stats.triangles, stats.vertices, stats.programBinds,
+            stats.textureBinds, stats.vertexArrayBinds, stats.uniformUpdates, stats.bufferUploadBytes);
+    } else {
+        fprintf(file, "draws %llu, triangles %llu, vertices %llu, programs %llu, textures %llu, "
+            "VAOs %llu, uniforms %llu, uploaded %llu bytes\n",
+            stats.drawCalls, stats.triangles, stats.vertices, stats.programBinds,
+            stats.textureBinds, stats.vertexArrayBinds, stats.uniformUpdates, stats.bufferUploadBytes);
+    }
+}
+
+static void countDraw(GLenum mode, GLsizei count) {
+    if (counted == NULL || count <= 0)
+        return;
+    counted->drawCalls++;
+    counted->vertices += (unsigned long long) count;
+    if (mode == GL_TRIANGLES)
+        counted->triangles += (unsigned long long) count / 3;
+    else if ((mode == GL_TRIANGLE_STRIP || mode == GL_TRIANGLE_FAN) && count >= 3)
+        counted->triangles += (unsigned long long) count - 2;
+}
+
+static void APIENTRY countedDrawArrays(GLenum mode, GLint first, GLsizei count) {
+    countDraw(mode, count);
+    drawArrays(mode, first, count);
+}
+
+static void APIENTRY countedDrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices) {
+    countDraw(mode, count);
+    drawElements(mode, count, type, indices);
+}
+
+static void APIENTRY countedUseProgram(GLuint program) {
+    if (counted != NULL)
+        counted->programBinds++;
+    useProgram(program);
+}
+
+static void APIENTRY countedBindTexture(GLenum target, GLuint texture) {
+    if (counted != NULL)
+        counted->textureBinds++;
+    bindTexture(target, texture);
+}
+
+static void APIENTRY countedBindVertexArray(GLuint array) {
+    if (counted != NULL)
+        counted->vertexArrayBinds++;
+    bindVertexArray(array);
+}
+
+static void APIENTRY countedUniform1iv(GLint location, GLsizei count, const GLint* value) {
+    if (counted != NULL)
+        counted->uniformUpdates++;
+    uniform1iv(location, count, value);
+}
+
+static void APIENTRY countedUniform1fv(GLint location, GLsizei count, const GLfloat* value) {
+    if (counted != NULL)
+        counted->uniformUpdates++;
+    uniform1fv(location, count, value);
+}
+
+static void APIENTRY countedUniform2fv(GLint location, GLsizei count, const GLfloat* value) {
+    if (counted != NULL)
+        counted->uniformUpdates++;
+    uniform2fv(location, count, value);
+}
+
+static void APIENTRY countedUniform3fv(GLint location, GLsizei count, const GLfloat* value) {
+    if (counted != NULL)
+        counted->uniformUpdates++;
+    uniform3fv(location, count, value);
+}
+
+static void APIENTRY countedUniform4fv(GLint location, GLsizei count, const GLfloat* value) {
+    if (counted != NULL)
+        counted->uniformUpdates++;
+    uniform4fv(location, count, value);
+}
+
+static void APIENTRY countedUniformMatrix2fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) {
+    if (counted != NULL)
+        counted->uniformUpdates++;
+    uniformMatrix2fv(location, count, transpose, value);
+}
+
+static void APIENTRY countedUniformMatrix3fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) {
+    if (counted != NULL)
+        counted->uniformUpdates++;
+    uniformMatrix3fv(location, count, transpose, value);
+}
+
+static void APIENTRY countedUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) {
+    if (counted != NULL)
+        counted->uniformUpdates++;
+    uniformMatrix4fv(location, count, transpose, value);
+}
+
+static void APIENTRY countedBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) {
+    // storage without data uploads nothing
+    if (counted != NULL && data != NULL)
+        counted->bufferUploadBytes += (unsigned long long) size;
+    bufferData(target, size, data, usage);
+}
+
+static void APIENTRY countedBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data) {
+    if (counted != NULL)
+        counted->bufferUploadBytes += (unsigned long long) size;
+    bufferSubData(target, offset, size, data);
+}
\ No newline at end of file
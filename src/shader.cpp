@@ -1,49 +1,128 @@
 #include "shader.hpp"
 
 #include <cstdio>
+#include <cstring>
 #include <string>
-#include <fstream>
-#include <sstream>
 
 #include "glad/glad.h"
 
-Shader::Shader(const char* vertexPath, const char* fragmentPath) {
+#include "gl_extensions.hpp"
+#include "hash.hpp"
+#include "pak.hpp"
+#include "program_binary_cache.hpp"
+
+ProgramBinaryCache* Shader::binaryCache = NULL;
+std::unordered_map<std::string, unsigned int> Shader::uniformBlockBindings;
+
+Shader::Shader(const char* vertexPath, const char* fragmentPath, const ShaderDefines &inDefines, ShaderBuild build)
+        : ID(0), vertexShader(0), fragmentShader(0), binaryCacheKey(0), fromBinaryCache(false), linked(false) {
     // store paths for debugging
     this->vertexSourcePath = vertexPath;
     this->fragmentSourcePath = fragmentPath;
+    this->defines = inDefines;
+    if (build == ShaderBuild::IMMEDIATE) {
+        submit();
+        finish();
+    }
+}
 
-    // read shader source files
-    std::string vertexShaderCode = stringFromFile(vertexPath);
-    std::string fragmentShaderCode = stringFromFile(fragmentPath);
-
-    // copy c++ strings to c strings
-    const char* vertexShaderSource = vertexShaderCode.c_str();
-    const char* fragmentShaderSource = fragmentShaderCode.c_str();
+Shader::Shader(const char* vertexPath, const ShaderDefines &inDefines, ShaderBuild build)
+        : ID(0), vertexShader(0), fragmentShader(0), binaryCacheKey(0), fromBinaryCache(false), linked(false) {
+    this->vertexSourcePath = vertexPath;
+    this->defines = inDefines;
+    if (build == ShaderBuild::IMMEDIATE) {
+        submit();
+        finish();
+    }
+}
 
-    unsigned int vertexShader, fragmentShader;
+void Shader::setBinaryCache(ProgramBinaryCache* cache) {
+    binaryCache = cache;
+}
 
-    // vertex shader compilation and error checking
-    vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-    glCompileShader(vertexShader);
-    checkShaderCompileErrors(vertexShader, this->vertexSourcePath);
+void Shader::setUniformBlockBinding(const std::string &block, unsigned int binding) {
+    uniformBlockBindings[block] = binding;
+}
 
-    // fragment shader compilation and error checking
-    fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-    glCompileShader(fragmentShader);
-    checkShaderCompileErrors(fragmentShader, this->fragmentSourcePath);
+void Shader::submit() {
+    // read shader source files, with the permutation defines injected
+    std::string vertexCode = injectDefines(stringFromFile(this->vertexSourcePath.c_str()));
+    std::string fragmentCode;
+    if (!this->fragmentSourcePath.empty())
+        fragmentCode = injectDefines(stringFromFile(this->fragmentSourcePath.c_str()));
 
-    // shader program linking and error checking
     ID = glCreateProgram();
+
+    // the final sources already contain the defines, so their hash
+    // identifies the permutation
+    fromBinaryCache = false;
+    if (binaryCache != NULL && binaryCache->enabled()) {
+        binaryCacheKey = binaryCache->key(hashString(fragmentCode, hashString(vertexCode)));
+        if (binaryCache->load(binaryCacheKey, ID)) {
+            fromBinaryCache = true;
+            return;
+        }
+        // a miss or a rejected binary falls back to compiling from source
+        glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    vertexShader = compileShader(GL_VERTEX_SHADER, vertexCode);
+
+    // a program without a fragment shader is valid in the core profile.
+    // the fragment outputs are undefined, but depth is still written,
+    // which is all a depth-only pass needs.
+    fragmentShader = 0;
+    if (!this->fragmentSourcePath.empty())
+        fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentCode);
+
+    // shader program linking. no status is queried here: with the compile
+    // results still pending, the driver can work on them in the background
     glAttachShader(ID, vertexShader);
-    glAttachShader(ID, fragmentShader);
+    if (fragmentShader != 0)
+        glAttachShader(ID, fragmentShader);
     glLinkProgram(ID);
-    checkProgramLinkErrors(ID);
+}
+
+bool Shader::isComplete() const {
+    if (fromBinaryCache || !glExtensions().parallelShaderCompile)
+        return true;
+
+    int complete = 0;
+    glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &complete);
+    return complete != 0;
+}
+
+bool Shader::finish() {
+    if (fromBinaryCache) {
+        linked = true;
+        bindUniformBlocks();
+        return true;
+    }
+
+    // checking the link status first avoids waiting on each shader's
+    // compile status. the compile logs only matter when linking failed
+    linked = checkProgramLinkErrors(ID);
+    if (!linked) {
+        checkShaderCompileErrors(vertexShader, this->vertexSourcePath.c_str());
+        if (fragmentShader != 0)
+            checkShaderCompileErrors(fragmentShader, this->fragmentSourcePath.c_str());
+    }
 
     // the already compiled and linked shaders can be deleted
+    glDetachShader(ID, vertexShader);
     glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+    if (fragmentShader != 0) {
+        glDetachShader(ID, fragmentShader);
+        glDeleteShader(fragmentShader);
+    }
+    vertexShader = 0;
+    fragmentShader = 0;
+
+    if (linked)
+        bindUniformBlocks();
+    if (linked && binaryCache != NULL && binaryCache->enabled())
+        binaryCache->save(binaryCacheKey, ID);
+    return linked;
 }
 
 void Shader::use() {
@@ -51,74 +130,199 @@ void Shader::use() {
 }
 
 void Shader::setBool(const char* name, bool value) const {
-    glUniform1i(glGetUniformLocation(ID, name), (int) value);
+    int intValue = (int) value;
+    setUniform(name, UniformType::INT, &intValue, sizeof(intValue));
 }
 
 void Shader::setInt(const char* name, int value) const {
-    glUniform1i(glGetUniformLocation(ID, name), value);
+    setUniform(name, UniformType::INT, &value, sizeof(value));
 }
 
 void Shader::setFloat(const char* name, float value) const {
-    glUniform1f(glGetUniformLocation(ID, name), value);
+    setUniform(name, UniformType::FLOAT, &value, sizeof(value));
 }
 
 void Shader::setVec2(const char* name, const glm::vec2 &value) const {
-    glUniform2fv(glGetUniformLocation(ID, name), 1, &value[0]);
+    setUniform(name, UniformType::VEC2, &value[0], sizeof(value));
 }
 
 void Shader::setVec2(const char* name, float x, float y) const {
-    glUniform2f(glGetUniformLocation(ID, name), x, y);
+    setVec2(name, glm::vec2(x, y));
 }
 
 void Shader::setVec3(const char* name, const glm::vec3 &value) const {
-    glUniform3fv(glGetUniformLocation(ID, name), 1, &value[0]);
+    setUniform(name, UniformType::VEC3, &value[0], sizeof(value));
 }
 
 void Shader::setVec3(const char* name, float x, float y, float z) const {
-    glUniform3f(glGetUniformLocation(ID, name), x, y, z);
+    setVec3(name, glm::vec3(x, y, z));
 }
 
 void Shader::setVec4(const char* name, const glm::vec4 &value) const {
-    glUniform4fv(glGetUniformLocation(ID, name), 1, &value[0]);
+    setUniform(name, UniformType::VEC4, &value[0], sizeof(value));
 }
 
 void Shader::setVec4(const char* name, float x, float y, float z, float w) const {
-    glUniform4f(glGetUniformLocation(ID, name), x, y, z, w);
+    setVec4(name, glm::vec4(x, y, z, w));
 }
 
 void Shader::setMat2(const char* name, const glm::mat2 &mat) const {
-    glUniformMatrix2fv(glGetUniformLocation(ID, name), 1, GL_FALSE, &mat[0][0]);
+    setUniform(name, UniformType::MAT2, &mat[0][0], sizeof(mat));
 }
 
 void Shader::setMat3(const char* name, const glm::mat3 &mat) const {
-    glUniformMatrix3fv(glGetUniformLocation(ID, name), 1, GL_FALSE, &mat[0][0]);
+    setUniform(name, UniformType::MAT3, &mat[0][0], sizeof(mat));
 }
 
 void Shader::setMat4(const char* name, const glm::mat4 &mat) const {
-    glUniformMatrix4fv(glGetUniformLocation(ID, name), 1, GL_FALSE, &mat[0][0]);
+    setUniform(name, UniformType::MAT4, &mat[0][0], sizeof(mat));
 }
 
-std::string Shader::stringFromFile(const char* path) {
-    std::ifstream shaderFile;
-    shaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+bool Shader::dependsOn(const std::string &path) const {
+    return path == this->vertexSourcePath || path == this->fragmentSourcePath;
+}
 
-    try {
-        // open file
-        shaderFile.open(path);
-        std::stringstream shaderFileStream;
+bool Shader::isLinked() const {
+    return linked;
+}
+
+void Shader::replaceProgram(Shader &built) {
+    unsigned int oldProgram = ID;
+    ID = built.ID;
+    built.ID = 0;
+    // deleting the program in use is fine, GL deletes it once unbound
+    glDeleteProgram(oldProgram);
+
+    // uniforms are program state, so the new program starts with all of
+    // them at zero. upload every value set on the old program again
+    GLint currentProgram = 0;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &currentProgram);
+    glUseProgram(ID);
+    for (std::unordered_map<uint64_t, Uniform>::iterator it = uniforms.begin() ; it != uniforms.end() ; ++it) {
+        Uniform &uniform = it->second;
+        uniform.location = glGetUniformLocation(ID, uniform.name.c_str());
+        uploadUniform(uniform);
+    }
+    glUseProgram(currentProgram == (GLint) oldProgram ? ID : (unsigned int) currentProgram);
+}
+
+void Shader::setUniform(const char* name, UniformType type, const void* value, size_t size) const {
+    // the name's hash is the cache key, so cache hits never allocate
+    uint64_t key = hashBytes(name, std::strlen(name));
+    std::unordered_map<uint64_t, Uniform>::iterator found = uniforms.find(key);
+    if (found == uniforms.end()) {
+        Uniform uniform;
+        uniform.name = name;
+        uniform.location = glGetUniformLocation(ID, name);
+        uniform.type = type;
+        uniform.size = size;
+        std::memcpy(uniform.value, value, size);
+        found = uniforms.insert(std::make_pair(key, uniform)).first;
+        uploadUniform(found->second);
+        return;
+    }
+
+    // uniform values stick with the program, so setting the value it
+    // already holds can be skipped
+    Uniform &uniform = found->second;
+    if (uniform.type == type && uniform.size == size && std::memcmp(uniform.value, value, size) == 0)
+        return;
+    uniform.type = type;
+    uniform.size = size;
+    std::memcpy(uniform.value, value, size);
+    uploadUniform(uniform);
+}
+
+void Shader::uploadUniform(const Uniform &uniform) const {
+    const float* floats = (const float*) uniform.value;
+    switch (uniform.type) {
+        case UniformType::INT:
+            glUniform1iv(uniform.location, 1, (const int*) uniform.value);
+            break;
+        case UniformType::FLOAT:
+            glUniform1fv(uniform.location, 1, floats);
+            break;
+        case UniformType::VEC2:
+            glUniform2fv(uniform.location, 1, floats);
+            break;
+        case UniformType::VEC3:
+            glUniform3fv(uniform.location, 1, floats);
+            break;
+        case UniformType::VEC4:
+            glUniform4fv(uniform.location, 1, floats);
+            break;
+        case UniformType::MAT2:
+            glUniformMatrix2fv(uniform.location, 1, GL_FALSE, floats);
+            break;
+        case UniformType::MAT3:
+            glUniformMatrix3fv(uniform.location, 1, GL_FALSE, floats);
+            break;
+        case UniformType::MAT4:
+            glUniformMatrix4fv(uniform.location, 1, GL_FALSE, floats);
+            break;
+        default:
+            break;
+    }
+}
 
-        // read file as stream
-        shaderFileStream << shaderFile.rdbuf();
+void Shader::bindUniformBlocks() const {
+    // block bindings are program state that linking resets, like uniforms
+    for (std::unordered_map<std::string, unsigned int>::const_iterator it = uniformBlockBindings.begin() ; it != uniformBlockBindings.end() ; ++it) {
+        GLuint index = glGetUniformBlockIndex(ID, it->first.c_str());
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, index, it->second);
+    }
+}
 
-        // close file
-        shaderFile.close();
+unsigned int Shader::compileShader(unsigned int type, const std::string &code) {
+    // copy c++ string to c string
+    const char* shaderSource = code.c_str();
+
+    // shader compilation, errors are checked in finish()
+    unsigned int shader = glCreateShader(type);
+    glShaderSource(shader, 1, &shaderSource, NULL);
+    glCompileShader(shader);
+    return shader;
+}
 
-        // return string from stream
-        return shaderFileStream.str();
-    } catch(std::ifstream::failure& e) {
+std::string Shader::injectDefines(const std::string &source) {
+    if (this->defines.empty())
+        return source;
+
+    // "#version" must be the first statement of the source, so the defines
+    // go right after that line
+    size_t versionLine = source.find("#version");
+    size_t insertAt = 0;
+    if (versionLine != std::string::npos) {
+        size_t lineEnd = source.find('\n', versionLine);
+        insertAt = lineEnd == std::string::npos ? source.size() : lineEnd + 1;
+    }
+    // count the lines before the insertion point, so "#line" can restore
+    // the original numbering for compile error messages
+    unsigned int nextLine = 1;
+    for (size_t i = 0 ; i < insertAt ; i++) {
+        if (source[i] == '\n')
+            nextLine++;
+    }
+
+    std::string injected;
+    for (unsigned int i = 0 ; i < this->defines.size() ; i++) {
+        injected += "#define " + this->defines[i] + "\n";
+    }
+    injected += "#line " + std::to_string(nextLine) + "\n";
+
+    std::string result = source;
+    result.insert(insertAt, injected);
+    return result;
+}
+
+std::string Shader::stringFromFile(const char* path) {
+    AssetFile shaderFile;
+    if (!shaderFile.open(path)) {
         printf("Shader file read failed\nPath: %s\n", path);
         return "";
     }
+    return std::string((const char*) shaderFile.data(), shaderFile.size());
 }
 
 void Shader::checkShaderCompileErrors(unsigned int shader, const char* path) {
@@ -132,13 +336,15 @@ void Shader::checkShaderCompileErrors(unsigned int shader, const char* path) {
     }
 }
 
-void Shader::checkProgramLinkErrors(unsigned int program) {
+bool Shader::checkProgramLinkErrors(unsigned int program) {
     int success;
     glGetProgramiv(program, GL_LINK_STATUS, &success);
     if (!success) {
         const int bufSize = 1024;
         char infoLog[bufSize];
         glGetProgramInfoLog(program, bufSize, NULL, infoLog);
-        printf("Shader linking error\nPath vertex: %s\nPath fragment: %s\n%s\n", this->vertexSourcePath, this->fragmentSourcePath, infoLog);
+        printf("Shader linking error\nPath vertex: %s\nPath fragment: %s\n%s\n", this->vertexSourcePath.c_str(),
+            this->fragmentSourcePath.empty() ? "(none)" : this->fragmentSourcePath.c_str(), infoLog);
     }
+    return success != 0;
 }
\ No newline at end of file
@@ -0,0 +1,53 @@
+#include "shader_cache.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "glad/glad.h"
+
+#include "hash.hpp"
+
+ShaderCache::~ShaderCache() {
+    for (unsigned int i = 0 ; i < programList.size() ; i++) {
+        glDeleteProgram(programList[i]->ID);
+        delete programList[i];
+    }
+}
+
+Shader &ShaderCache::get(const char* vertexPath, const char* fragmentPath, const ShaderDefines &defines) {
+    // the order defines are requested in does not change the program:
+    // their hashes are summed, which doesn't need a sorted copy
+    uint64_t definesKey = 0;
+    for (unsigned int i = 0 ; i < defines.size() ; i++) {
+        definesKey += hashString(defines[i]);
+    }
+    uint64_t key = hashCombine(hashCombine(fileHash(vertexPath), fileHash(fragmentPath)), definesKey);
+
+    std::unordered_map<uint64_t, Shader*>::iterator found = programsByKey.find(key);
+    if (found != programsByKey.end())
+        return *found->second;
+
+    // programs live as long as the cache, so the returned references stay valid
+    ShaderDefines sortedDefines = defines;
+    std::sort(sortedDefines.begin(), sortedDefines.end());
+    Shader* shader = new Shader(vertexPath, fragmentPath, sortedDefines);
+    programsByKey[key] = shader;
+    programList.push_back(shader);
+    return *shader;
+}
+
+std::vector<Shader*> &ShaderCache::programs() {
+    return programList;
+}
+
+uint64_t ShaderCache::fileHash(const char* path) {
+    // hashed in place, a std::string key would be built every lookup
+    uint64_t pathHash = hashBytes(path, std::strlen(path));
+    std::unordered_map<uint64_t, uint64_t>::iterator found = fileHashes.find(pathHash);
+    if (found != fileHashes.end())
+        return found->second;
+
+    uint64_t hash = hashString(Shader::stringFromFile(path));
+    fileHashes[pathHash] = hash;
+    return hash;
+}
\ No newline at end of file
@@ -0,0 +1,103 @@
+#include "shader_compiler.hpp"
+
+#include <cstdio>
+
+#include "glad/glad.h"
+#include "GLFW/glfw3.h"
+
+#include "gl_extensions.hpp"
+#include "shader.hpp"
+
+ShaderCompiler::ShaderCompiler(GLFWwindow* inSharedWindow)
+        : sharedWindow(inSharedWindow), workerWindow(NULL), success(true), finished(false) {
+}
+
+ShaderCompiler::~ShaderCompiler() {
+    if (worker.joinable())
+        worker.join();
+    if (workerWindow != NULL)
+        glfwDestroyWindow(workerWindow);
+}
+
+void ShaderCompiler::add(Shader &shader) {
+    shaders.push_back(&shader);
+}
+
+bool ShaderCompiler::compile() {
+    run();
+    return success;
+}
+
+void ShaderCompiler::start() {
+    finished = false;
+    if (sharedWindow == NULL) {
+        printf("Shader compiler has no window to share a context with, compiling on the main thread\n");
+        run();
+        finished = true;
+        return;
+    }
+
+    // the hidden window only exists for its context. it inherits the
+    // context hints set for the main window, so the versions match
+    if (workerWindow == NULL) {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        workerWindow = glfwCreateWindow(1, 1, "", NULL, sharedWindow);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+    }
+    if (workerWindow == NULL) {
+        printf("Failed to create shader compiler context, compiling on the main thread\n");
+        run();
+        finished = true;
+        return;
+    }
+
+    worker = std::thread([this]() {
+        glfwMakeContextCurrent(workerWindow);
+        enableParallelShaderCompile();
+        run();
+        // make sure the driver is done with every program before the main
+        // context uses them
+        glFinish();
+        glfwMakeContextCurrent(NULL);
+        finished = true;
+    });
+}
+
+bool ShaderCompiler::done() const {
+    return finished;
+}
+
+bool ShaderCompiler::wait() {
+    if (worker.joinable())
+        worker.join();
+    return success;
+}
+
+void ShaderCompiler::run() {
+    success = true;
+    for (unsigned int i = 0 ; i < shaders.size() ; i++) {
+        shaders[i]->submit();
+    }
+
+    // finish programs in the order they complete. without
+    // KHR_parallel_shader_compile every program reports complete and
+    // this is a plain in-order finish
+    std::vector<Shader*> pending = shaders;
+    while (!pending.empty()) {
+        bool progressed = false;
+        for (unsigned int i = 0 ; i < pending.size() ; ) {
+            if (pending[i]->isComplete()) {
+                success = pending[i]->finish() && success;
+                pending[i] = pending.back();
+                pending.pop_back();
+                progressed = true;
+            } else {
+                i++;
+            }
+        }
+        if (!progressed)
+            std::this_thread::yield();
+    }
+
+    shaders.clear();
+}
\ No newline at end of file
@@ -0,0 +1,73 @@
+#include "shader_hot_reload.hpp"
+
+#include <algorithm>
+
+#include "glad/glad.h"
+
+#include "shader.hpp"
+
+ShaderHotReload::ShaderHotReload(const char* directory, GLFWwindow* inSharedWindow)
+        : watcher(directory), compiler(inSharedWindow) {
+}
+
+ShaderHotReload::~ShaderHotReload() {
+    // a pending batch is waited for and dropped, not applied. this runs
+    // before the context is destroyed, see main
+    if (!building.empty())
+        compiler.wait();
+    for (unsigned int i = 0 ; i < building.size() ; i++) {
+        glDeleteProgram(building[i].staging->ID);
+        delete building[i].staging;
+    }
+}
+
+void ShaderHotReload::add(Shader &shader) {
+    shaders.push_back(&shader);
+}
+
+void ShaderHotReload::update() {
+    std::vector<std::string> changed = watcher.poll();
+    for (unsigned int i = 0 ; i < changed.size() ; i++) {
+        for (unsigned int j = 0 ; j < shaders.size() ; j++) {
+            bool alreadyQueued = std::find(queued.begin(), queued.end(), shaders[j]) != queued.end();
+            if (shaders[j]->dependsOn(changed[i]) && !alreadyQueued)
+                queued.push_back(shaders[j]);
+        }
+    }
+
+    if (!building.empty() && compiler.done()) {
+        compiler.wait();
+        finishBatch();
+    }
+
+    if (building.empty() && !queued.empty())
+        startBatch();
+}
+
+void ShaderHotReload::startBatch() {
+    for (unsigned int i = 0 ; i < queued.size() ; i++) {
+        Rebuild rebuild;
+        rebuild.live = queued[i];
+        // the copy has the same sources, defines and uniform values. its
+        // program ID is replaced when the batch submits it
+        rebuild.staging = new Shader(*queued[i]);
+        building.push_back(rebuild);
+        compiler.add(*rebuild.staging);
+    }
+    queued.clear();
+    compiler.start();
+}
+
+void ShaderHotReload::finishBatch() {
+    for (unsigned int i = 0 ; i < building.size() ; i++) {
+        Rebuild &rebuild = building[i];
+        if (rebuild.staging->isLinked()) {
+            rebuild.live->replaceProgram(*rebuild.staging);
+        } else {
+            // the link error was already printed, keep the working program
+            glDeleteProgram(rebuild.staging->ID);
+        }
+        delete rebuild.staging;
+    }
+    building.clear();
+}
\ No newline at end of file
@@ -0,0 +1,150 @@
+#include "simulation.hpp"
+
+// after a stall longer than this many steps (a debugger break, the window
+// being dragged), the missed steps are skipped instead of run back to back
+static const int maxCatchUpSteps = 5;
+
+static float mix(float a, float b, float t);
+
+Camera FrameSnapshot::camera() const {
+    Camera result(cameraPosition, cameraWorldUp, cameraYaw, cameraPitch);
+    result.zoom = cameraZoom;
+    return result;
+}
+
+Simulation::Simulation(const Camera &inCamera, double stepSeconds)
+        : camera(inCamera), running(false) {
+    step = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(stepSeconds));
+    input = Input();
+    current = capture(0);
+    previous = current;
+    currentTime = Clock::now();
+}
+
+Simulation::~Simulation() {
+    stop();
+}
+
+void Simulation::start() {
+    std::lock_guard<std::mutex> guard(mutex);
+    if (running)
+        return;
+    running = true;
+    currentTime = Clock::now();
+    worker = std::thread(&Simulation::run, this);
+}
+
+void Simulation::stop() {
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        running = false;
+    }
+    stopped.notify_all();
+    if (worker.joinable())
+        worker.join();
+}
+
+void Simulation::setKey(CameraMovement movement, bool pressed) {
+    std::lock_guard<std::mutex> guard(mutex);
+    input.keys[(int) movement] = pressed;
+}
+
+void Simulation::addMouseMovement(float xOffset, float yOffset) {
+    std::lock_guard<std::mutex> guard(mutex);
+    input.mouseX += xOffset;
+    input.mouseY += yOffset;
+}
+
+void Simulation::addMouseScroll(float yOffset) {
+    std::lock_guard<std::mutex> guard(mutex);
+    input.scroll += yOffset;
+}
+
+FrameSnapshot Simulation::interpolate() {
+    FrameSnapshot from;
+    FrameSnapshot to;
+    Clock::time_point toTime;
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        from = previous;
+        to = current;
+        toTime = currentTime;
+    }
+
+    // 0 right when the latest step was produced, 1 a whole step later,
+    // when the next one is due
+    float t = (float) std::chrono::duration<double>(Clock::now() - toTime).count()
+        / (float) std::chrono::duration<double>(step).count();
+    if (t < 0.0f)
+        t = 0.0f;
+    if (t > 1.0f)
+        t = 1.0f;
+
+    FrameSnapshot result = to;
+    result.cameraPosition = glm::mix(from.cameraPosition, to.cameraPosition, t);
+    result.cameraYaw = mix(from.cameraYaw, to.cameraYaw, t);
+    result.cameraPitch = mix(from.cameraPitch, to.cameraPitch, t);
+    result.cameraZoom = mix(from.cameraZoom, to.cameraZoom, t);
+    return result;
+}
+
+void Simulation::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    Clock::time_point next = currentTime + step;
+    unsigned long long stepIndex = current.step;
+    while (running) {
+        stopped.wait_until(lock, next, [this] { return !running; });
+        if (!running)
+            break;
+
+        Input stepInput = input;
+        input.mouseX = 0.0f;
+        input.mouseY = 0.0f;
+        input.scroll = 0.0f;
+
+        lock.unlock();
+        update(stepInput);
+        FrameSnapshot snapshot = capture(++stepIndex);
+        lock.lock();
+
+        previous = current;
+        current = snapshot;
+        // the scheduled time rather than the actual one, so that late
+        // wakeups don't show up as uneven movement
+        currentTime = next;
+
+        next += step;
+        Clock::time_point now = Clock::now();
+        if (now - next > maxCatchUpSteps * step)
+            next = now;
+    }
+}
+
+void Simulation::update(const Input &stepInput) {
+    float deltaTime = (float) std::chrono::duration<double>(step).count();
+
+    if (stepInput.mouseX != 0.0f || stepInput.mouseY != 0.0f)
+        camera.ProcessMouseMovement(stepInput.mouseX, stepInput.mouseY);
+    if (stepInput.scroll != 0.0f)
+        camera.ProcessMouseScroll(stepInput.scroll);
+
+    for (int i = 0 ; i < (int) CameraMovement::SIZE ; i++) {
+        if (stepInput.keys[i])
+            camera.ProcessKeyboard((CameraMovement) i, deltaTime);
+    }
+}
+
+FrameSnapshot Simulation::capture(unsigned long long stepIndex) const {
+    FrameSnapshot snapshot;
+    snapshot.step = stepIndex;
+    snapshot.cameraPosition = camera.position;
+    snapshot.cameraWorldUp = camera.worldUp;
+    snapshot.cameraYaw = camera.yaw;
+    snapshot.cameraPitch = camera.pitch;
+    snapshot.cameraZoom = camera.zoom;
+    return snapshot;
+}
+
+static float mix(float a, float b, float t) {
+    return a + (b - a) * t;
+}
\ No newline at end of file
@@ -0,0 +1,104 @@
+#include "texture_array.hpp"
+
+#include <cstdio>
+
+#include "glad/glad.h"
+
+#include "fileutil.hpp"
+#include "texture_manager.hpp"
+
+int TextureArrayPacker::add(const std::string &path, TextureData* decoded) {
+    std::string key = canonicalPath(path.c_str());
+    std::unordered_map<std::string, int>::iterator found = handles.find(key);
+    if (found != handles.end())
+        return found->second;
+
+    TextureData texture;
+    if (decoded != NULL && !decoded->levels.empty()) {
+        texture.format = decoded->format;
+        texture.levels.swap(decoded->levels);
+    } else if (!TextureManager::instance().loadData(path.c_str(), texture) || texture.levels.empty()) {
+        handles[key] = -1;
+        return -1;
+    }
+
+    return insert(key, texture);
+}
+
+int TextureArrayPacker::addColor(unsigned char r, unsigned char g, unsigned char b, unsigned char a) {
+    // not a path canonicalPath can return
+    char key[16];
+    std::snprintf(key, sizeof(key), "#%02x%02x%02x%02x", r, g, b, a);
+    std::unordered_map<std::string, int>::iterator found = handles.find(key);
+    if (found != handles.end())
+        return found->second;
+
+    TextureData texture;
+    texture.format = TextureFormat::RGBA8;
+    texture.levels.resize(1);
+    texture.levels[0].width = 1;
+    texture.levels[0].height = 1;
+    unsigned char pixel[] = { r, g, b, a };
+    texture.levels[0].data.assign(pixel, pixel + 4);
+    return insert(key, texture);
+}
+
+int TextureArrayPacker::insert(const std::string &key, TextureData &texture) {
+    unsigned int group = 0;
+    while (group < groups.size()) {
+        const Group &candidate = groups[group];
+        if (candidate.format == texture.format && candidate.width == texture.levels[0].width
+            && candidate.height == texture.levels[0].height && candidate.levels == texture.levels.size()
+            && candidate.layers.size() < maxLayers)
+            break;
+        group++;
+    }
+    if (group == groups.size()) {
+        Group created;
+        created.format = texture.format;
+        created.width = texture.levels[0].width;
+        created.height = texture.levels[0].height;
+        created.levels = (unsigned int) texture.levels.size();
+        groups.push_back(created);
+    }
+
+    Slot slot;
+    slot.group = group;
+    slot.layer = (unsigned int) groups[group].layers.size();
+    groups[group].layers.push_back(TextureData());
+    groups[group].layers.back().format = texture.format;
+    groups[group].layers.back().levels.swap(texture.levels);
+
+    int handle = (int) slots.size();
+    slots.push_back(slot);
+    handles[key] = handle;
+    return handle;
+}
+
+void TextureArrayPacker::build() {
+    arrayIds.resize(groups.size());
+    for (unsigned int i = 0 ; i < groups.size() ; i++) {
+        glGenTextures(1, &arrayIds[i]);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, arrayIds[i]);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        std::vector<const TextureData*> layers;
+        for (unsigned int layer = 0 ; layer < groups[i].layers.size() ; layer++) {
+            layers.push_back(&groups[i].layers[layer]);
+        }
+        uploadTextureArray(layers);
+        std::vector<TextureData>().swap(groups[i].layers);
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+unsigned int TextureArrayPacker::array(int handle) const {
+    return handle >= 0 ? arrayIds[slots[(size_t) handle].group] : 0;
+}
+
+unsigned int TextureArrayPacker::layer(int handle) const {
+    return handle >= 0 ? slots[(size_t) handle].layer : 0;
+}
\ No newline at end of file
@@ -0,0 +1,418 @@
+#include "texture_compression.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "image_decoder.hpp"
+#include "parallel.hpp"
+
+// a 4x4 block of RGBA8 pixels, row by row
+struct PixelBlock {
+    unsigned char pixels[64];
+};
+
+static void fetchBlock(const unsigned char* rgba, unsigned int width, unsigned int height, unsigned int blockX, unsigned int blockY, PixelBlock &block);
+static void blockBounds(const PixelBlock &block, unsigned char minColor[4], unsigned char maxColor[4]);
+static void encodeColorBlock(const PixelBlock &block, unsigned char* output);
+static void encodeChannelBlock(const PixelBlock &block, unsigned int channel, unsigned char minValue, unsigned char maxValue, unsigned char* output);
+static uint32_t colorIndices(const PixelBlock &block, const int palette[4][3]);
+static uint64_t channelIndices(const PixelBlock &block, unsigned int channel, const int palette[8]);
+static uint16_t packRGB565(const unsigned char color[3]);
+static void unpackRGB565(uint16_t packed, int color[3]);
+static void compressImage(TextureFormat format, const unsigned char* rgba, unsigned int width, unsigned int height, unsigned char* output);
+
+void compressBC1(const unsigned char* rgba, unsigned int width, unsigned int height, unsigned char* output) {
+    for (unsigned int y = 0 ; y < height ; y += 4) {
+        for (unsigned int x = 0 ; x < width ; x += 4) {
+            PixelBlock block;
+            fetchBlock(rgba, width, height, x, y, block);
+            encodeColorBlock(block, output);
+            output += 8;
+        }
+    }
+}
+
+void compressBC3(const unsigned char* rgba, unsigned int width, unsigned int height, unsigned char* output) {
+    for (unsigned int y = 0 ; y < height ; y += 4) {
+        for (unsigned int x = 0 ; x < width ; x += 4) {
+            PixelBlock block;
+            fetchBlock(rgba, width, height, x, y, block);
+            unsigned char minColor[4], maxColor[4];
+            blockBounds(block, minColor, maxColor);
+            // alpha block first, then the color block
+            encodeChannelBlock(block, 3, minColor[3], maxColor[3], output);
+            encodeColorBlock(block, output + 8);
+            output += 16;
+        }
+    }
+}
+
+void compressBC4(const unsigned char* rgba, unsigned int width, unsigned int height, unsigned char* output) {
+    for (unsigned int y = 0 ; y < height ; y += 4) {
+        for (unsigned int x = 0 ; x < width ; x += 4) {
+            PixelBlock block;
+            fetchBlock(rgba, width, height, x, y, block);
+            unsigned char minColor[4], maxColor[4];
+            blockBounds(block, minColor, maxColor);
+            encodeChannelBlock(block, 0, minColor[0], maxColor[0], output);
+            output += 8;
+        }
+    }
+}
+
+void compressBC5(const unsigned char* rgba, unsigned int width, unsigned int height, unsigned char* output) {
+    for (unsigned int y = 0 ; y < height ; y += 4) {
+        for (unsigned int x = 0 ; x < width ; x += 4) {
+            PixelBlock block;
+            fetchBlock(rgba, width, height, x, y, block);
+            unsigned char minColor[4], maxColor[4];
+            blockBounds(block, minColor, maxColor);
+            encodeChannelBlock(block, 0, minColor[0], maxColor[0], output);
+            encodeChannelBlock(block, 1, minColor[1], maxColor[1], output + 8);
+            output += 16;
+        }
+    }
+}
+
+bool importTexture(const char* path, bool compress, TextureData &texture, TextureUsage usage) {
+    DecodedImage image;
+    if (!decodeImageFile(path, image))
+        return false;
+
+    // decoded and flipped at the file's own channel count, fewer bytes
+    // than RGBA, and only then expanded
+    unsigned int channels = image.channels;
+    std::vector<unsigned char> rgba((size_t) image.width * image.height * 4);
+    expandToRGBA(&image.pixels[0], (size_t) image.width * image.height, channels, &rgba[0]);
+
+    if (usage == TextureUsage::HEIGHT_MAP && channels >= 3)
+        usage = TextureUsage::NORMAL_MAP;
+    bool singleChannel = usage == TextureUsage::HEIGHT_MAP || (usage == TextureUsage::COLOR && channels == 1);
+    TextureFormat format = usage == TextureUsage::NORMAL_MAP ? TextureFormat::BC5
+        : singleChannel ? TextureFormat::BC4
+        : channels == 3 ? TextureFormat::BC1 : TextureFormat::BC3;
+    if (!compress)
+        format = singleChannel ? TextureFormat::R8 : TextureFormat::RGBA8;
+    // single channel images hold data (masks, heights), not colors
+    MipOptions options;
+    options.srgb = usage == TextureUsage::COLOR && channels != 1;
+    options.normalMap = usage == TextureUsage::NORMAL_MAP;
+    texture = compressTexture(&rgba[0], image.width, image.height, format, options);
+    return true;
+}
+
+TextureData compressTexture(const unsigned char* rgba, unsigned int width, unsigned int height, TextureFormat format,
+        const MipOptions &options) {
+    TextureData texture = generateMips(rgba, width, height, options);
+    if (format == TextureFormat::RGBA8)
+        return texture;
+
+    // red only, a quarter of the bytes, and g = b = 0 when sampled like
+    // any GL_RED texture
+    if (format == TextureFormat::R8) {
+        texture.format = format;
+        for (unsigned int level = 0 ; level < texture.levels.size() ; level++) {
+            TextureLevel &current = texture.levels[level];
+            size_t count = (size_t) current.width * current.height;
+            std::vector<unsigned char> red(count);
+            for (size_t i = 0 ; i < count ; i++) {
+                red[i] = current.data[i * 4];
+            }
+            current.data.swap(red);
+        }
+        return texture;
+    }
+
+    texture.format = format;
+    for (unsigned int level = 0 ; level < texture.levels.size() ; level++) {
+        TextureLevel &current = texture.levels[level];
+        std::vector<unsigned char> compressed(levelSize(format, current.width, current.height));
+        size_t blockRowBytes = levelSize(format, current.width, 4);
+        // rows of blocks are independent. the last band of each range
+        // keeps partial blocks at the bottom edge
+        parallelFor((current.height + 3) / 4, 16, [&](unsigned int begin, unsigned int end) {
+            unsigned int rows = std::min(end * 4, current.height) - begin * 4;
+            compressImage(format, &current.data[(size_t) begin * 4 * current.width * 4], current.width, rows,
+                &compressed[begin * blockRowBytes]);
+        });
+        current.data.swap(compressed);
+    }
+    return texture;
+}
+
+static void fetchBlock(const unsigned char* rgba, unsigned int width, unsigned int height, unsigned int blockX, unsigned int blockY, PixelBlock &block) {
+    for (unsigned int y = 0 ; y < 4 ; y++) {
+        unsigned int sourceY = blockY + y < height ? blockY + y : height - 1;
+        const unsigned char* row = rgba + (size_t) sourceY * width * 4;
+        if (blockX + 4 <= width) {
+            std::memcpy(&block.pixels[y * 16], row + blockX * 4, 16);
+            continue;
+        }
+        for (unsigned int x = 0 ; x < 4 ; x++) {
+            unsigned int sourceX = blockX + x < width ? blockX + x : width - 1;
+            std::memcpy(&block.pixels[y * 16 + x * 4], row + sourceX * 4, 4);
+        }
+    }
+}
+
+static void blockBounds(const PixelBlock &block, unsigned char minColor[4], unsigned char maxColor[4]) {
+#if defined(__SSE2__)
+    // each row of the block is one 16 byte register (4 RGBA pixels). min/max
+    // the rows together, then fold the 4 pixels of the result onto one
+    __m128i row0 = _mm_loadu_si128((const __m128i*) &block.pixels[0]);
+    __m128i row1 = _mm_loadu_si128((const __m128i*) &block.pixels[16]);
+    __m128i row2 = _mm_loadu_si128((const __m128i*) &block.pixels[32]);
+    __m128i row3 = _mm_loadu_si128((const __m128i*) &block.pixels[48]);
+    __m128i minimum = _mm_min_epu8(_mm_min_epu8(row0, row1), _mm_min_epu8(row2, row3));
+    __m128i maximum = _mm_max_epu8(_mm_max_epu8(row0, row1), _mm_max_epu8(row2, row3));
+    minimum = _mm_min_epu8(minimum, _mm_shuffle_epi32(minimum, _MM_SHUFFLE(1, 0, 3, 2)));
+    maximum = _mm_max_epu8(maximum, _mm_shuffle_epi32(maximum, _MM_SHUFFLE(1, 0, 3, 2)));
+    minimum = _mm_min_epu8(minimum, _mm_shuffle_epi32(minimum, _MM_SHUFFLE(2, 3, 0, 1)));
+    maximum = _mm_max_epu8(maximum, _mm_shuffle_epi32(maximum, _MM_SHUFFLE(2, 3, 0, 1)));
+    int minPixel = _mm_cvtsi128_si32(minimum);
+    int maxPixel = _mm_cvtsi128_si32(maximum);
+    std::memcpy(minColor, &minPixel, 4);
+    std::memcpy(maxColor, &maxPixel, 4);
+#else
+    for (unsigned int c = 0 ; c < 4 ; c++) {
+        minColor[c] = 255;
+        maxColor[c] = 0;
+    }
+    for (unsigned int i = 0 ; i < 16 ; i++) {
+        for (unsigned int c = 0 ; c < 4 ; c++) {
+            unsigned char value = block.pixels[i * 4 + c];
+            minColor[c] = value < minColor[c] ? value : minColor[c];
+            maxColor[c] = value > maxColor[c] ? value : maxColor[c];
+        }
+    }
+#endif
+}
+
+static void encodeColorBlock(const PixelBlock &block, unsigned char* output) {
+    unsigned char minColor[4], maxColor[4];
+    blockBounds(block, minColor, maxColor);
+
+    // inset the bounding box by 1/16 of its size on each side. the extremes
+    // are rarely exact palette entries, and this lowers the average error
+    for (unsigned int c = 0 ; c < 3 ; c++) {
+        unsigned char inset = (unsigned char) ((maxColor[c] - minColor[c]) >> 4);
+        minColor[c] = (unsigned char) (minColor[c] + inset);
+        maxColor[c] = (unsigned char) (maxColor[c] - inset);
+    }
+
+    uint16_t color0 = packRGB565(maxColor);
+    uint16_t color1 = packRGB565(minColor);
+    // color0 > color1 selects the 4 color mode in BC1
+    if (color0 < color1) {
+        uint16_t swap = color0;
+        color0 = color1;
+        color1 = swap;
+    }
+
+    uint32_t indices = 0;
+    if (color0 != color1) {
+        // the palette as the decoder sees it, from the quantized endpoints
+        int palette[4][3];
+        unpackRGB565(color0, palette[0]);
+        unpackRGB565(color1, palette[1]);
+        for (unsigned int c = 0 ; c < 3 ; c++) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        indices = colorIndices(block, palette);
+    }
+
+    // little endian, as the GPU reads it
+    output[0] = (unsigned char) (color0 & 0xFF);
+    output[1] = (unsigned char) (color0 >> 8);
+    output[2] = (unsigned char) (color1 & 0xFF);
+    output[3] = (unsigned char) (color1 >> 8);
+    output[4] = (unsigned char) (indices & 0xFF);
+    output[5] = (unsigned char) ((indices >> 8) & 0xFF);
+    output[6] = (unsigned char) ((indices >> 16) & 0xFF);
+    output[7] = (unsigned char) (indices >> 24);
+}
+
+static void encodeChannelBlock(const PixelBlock &block, unsigned int channel, unsigned char minValue, unsigned char maxValue, unsigned char* output) {
+    // value0 > value1 selects the 8 value interpolated mode
+    output[0] = maxValue;
+    output[1] = minValue;
+
+    uint64_t indices = 0;
+    if (maxValue != minValue) {
+        int palette[8];
+        palette[0] = maxValue;
+        palette[1] = minValue;
+        for (int p = 1 ; p < 7 ; p++) {
+            palette[p + 1] = ((7 - p) * maxValue + p * minValue) / 7;
+        }
+        indices = channelIndices(block, channel, palette);
+    }
+
+    // 16 indices of 3 bits, little endian
+    for (unsigned int i = 0 ; i < 6 ; i++) {
+        output[2 + i] = (unsigned char) ((indices >> (i * 8)) & 0xFF);
+    }
+}
+
+// the 2 bit index of the nearest palette entry (squared RGB distance) of
+// every pixel, the first entry winning ties
+static uint32_t colorIndices(const PixelBlock &block, const int palette[4][3]) {
+    uint32_t indices = 0;
+#if defined(__SSE2__)
+    // a row of 4 pixels at a time, widened to 16 bits with alpha cleared.
+    // madd squares the differences and sums them in pairs, leaving r + g
+    // and b per pixel, which the shuffles then add up
+    __m128i zero = _mm_setzero_si128();
+    __m128i rgbMask = _mm_set1_epi32(0x00FFFFFF);
+    __m128i entries[4];
+    for (unsigned int p = 0 ; p < 4 ; p++) {
+        entries[p] = _mm_setr_epi16((short) palette[p][0], (short) palette[p][1], (short) palette[p][2], 0,
+            (short) palette[p][0], (short) palette[p][1], (short) palette[p][2], 0);
+    }
+    for (unsigned int row = 0 ; row < 4 ; row++) {
+        __m128i pixels = _mm_and_si128(_mm_loadu_si128((const __m128i*) &block.pixels[row * 16]), rgbMask);
+        __m128i low = _mm_unpacklo_epi8(pixels, zero);
+        __m128i high = _mm_unpackhi_epi8(pixels, zero);
+        __m128i best = zero;
+        __m128i bestDistance = zero;
+        for (unsigned int p = 0 ; p < 4 ; p++) {
+            __m128i lowDifference = _mm_sub_epi16(low, entries[p]);
+            __m128i highDifference = _mm_sub_epi16(high, entries[p]);
+            __m128 lowSums = _mm_castsi128_ps(_mm_madd_epi16(lowDifference, lowDifference));
+            __m128 highSums = _mm_castsi128_ps(_mm_madd_epi16(highDifference, highDifference));
+            __m128i distance = _mm_add_epi32(
+                _mm_castps_si128(_mm_shuffle_ps(lowSums, highSums, _MM_SHUFFLE(2, 0, 2, 0))),
+                _mm_castps_si128(_mm_shuffle_ps(lowSums, highSums, _MM_SHUFFLE(3, 1, 3, 1))));
+            if (p == 0) {
+                bestDistance = distance;
+                continue;
+            }
+            __m128i closer = _mm_cmplt_epi32(distance, bestDistance);
+            bestDistance = _mm_or_si128(_mm_and_si128(closer, distance), _mm_andnot_si128(closer, bestDistance));
+            best = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32((int) p)), _mm_andnot_si128(closer, best));
+        }
+        // the 4 indices of 2 bits each, into the row's byte
+        int rowIndices[4];
+        _mm_storeu_si128((__m128i*) rowIndices, best);
+        for (unsigned int x = 0 ; x < 4 ; x++) {
+            indices |= (uint32_t) rowIndices[x] << ((row * 4 + x) * 2);
+        }
+    }
+#else
+    for (unsigned int i = 0 ; i < 16 ; i++) {
+        const unsigned char* pixel = &block.pixels[i * 4];
+        unsigned int best = 0;
+        int bestDistance = 0x7FFFFFFF;
+        for (unsigned int p = 0 ; p < 4 ; p++) {
+            int dr = pixel[0] - palette[p][0];
+            int dg = pixel[1] - palette[p][1];
+            int db = pixel[2] - palette[p][2];
+            int distance = dr * dr + dg * dg + db * db;
+            if (distance < bestDistance) {
+                bestDistance = distance;
+                best = p;
+            }
+        }
+        indices |= best << (i * 2);
+    }
+#endif
+    return indices;
+}
+
+// the 3 bit index of the nearest palette entry of every pixel's channel,
+// the first entry winning ties
+static uint64_t channelIndices(const PixelBlock &block, unsigned int channel, const int palette[8]) {
+    uint64_t indices = 0;
+#if defined(__SSE2__)
+    // the channel of all 16 pixels in one register, gathered by shifting
+    // it to the bottom of each pixel and packing the pixels down to bytes.
+    // distances are byte differences, so every pixel is compared at once
+    __m128i shift = _mm_cvtsi32_si128((int) channel * 8);
+    __m128i byteMask = _mm_set1_epi32(0xFF);
+    __m128i rows[4];
+    for (unsigned int row = 0 ; row < 4 ; row++) {
+        rows[row] = _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128((const __m128i*) &block.pixels[row * 16]), shift), byteMask);
+    }
+    __m128i values = _mm_packus_epi16(_mm_packs_epi32(rows[0], rows[1]), _mm_packs_epi32(rows[2], rows[3]));
+    __m128i best = _mm_setzero_si128();
+    __m128i bestDistance = _mm_setzero_si128();
+    for (unsigned int p = 0 ; p < 8 ; p++) {
+        __m128i entry = _mm_set1_epi8((char) palette[p]);
+        __m128i distance = _mm_or_si128(_mm_subs_epu8(values, entry), _mm_subs_epu8(entry, values));
+        if (p == 0) {
+            bestDistance = distance;
+            continue;
+        }
+        // unsigned bytes have no less than: closer where the minimum
+        // moved, that is where it differs from the best distance so far
+        __m128i minimum = _mm_min_epu8(distance, bestDistance);
+        __m128i closer = _mm_andnot_si128(_mm_cmpeq_epi8(minimum, bestDistance), _mm_set1_epi8(-1));
+        bestDistance = minimum;
+        best = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi8((char) p)), _mm_andnot_si128(closer, best));
+    }
+    unsigned char pixelIndices[16];
+    _mm_storeu_si128((__m128i*) pixelIndices, best);
+    for (unsigned int i = 0 ; i < 16 ; i++) {
+        indices |= (uint64_t) pixelIndices[i] << (i * 3);
+    }
+#else
+    for (unsigned int i = 0 ; i < 16 ; i++) {
+        int value = block.pixels[i * 4 + channel];
+        uint64_t best = 0;
+        int bestDistance = 256;
+        for (unsigned int p = 0 ; p < 8 ; p++) {
+            int distance = value > palette[p] ? value - palette[p] : palette[p] - value;
+            if (distance < bestDistance) {
+                bestDistance = distance;
+                best = p;
+            }
+        }
+        indices |= best << (i * 3);
+    }
+#endif
+    return indices;
+}
+
+static uint16_t packRGB565(const unsigned char color[3]) {
+    // round to the nearest representable value instead of truncating
+    unsigned int r = (color[0] * 31u + 127u) / 255u;
+    unsigned int g = (color[1] * 63u + 127u) / 255u;
+    unsigned int b = (color[2] * 31u + 127u) / 255u;
+    return (uint16_t) ((r << 11) | (g << 5) | b);
+}
+
+static void unpackRGB565(uint16_t packed, int color[3]) {
+    int r = (packed >> 11) & 0x1F;
+    int g = (packed >> 5) & 0x3F;
+    int b = packed & 0x1F;
+    // replicate the high bits into the low ones, like the hardware does
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+static void compressImage(TextureFormat format, const unsigned char* rgba, unsigned int width, unsigned int height, unsigned char* output) {
+    switch (format) {
+        case TextureFormat::BC1:
+            compressBC1(rgba, width, height, output);
+            break;
+        case TextureFormat::BC3:
+            compressBC3(rgba, width, height, output);
+            break;
+        case TextureFormat::BC4:
+            compressBC4(rgba, width, height, output);
+            break;
+        case TextureFormat::BC5:
+            compressBC5(rgba, width, height, output);
+            break;
+        default:
+            break;
+    }
+}
\ No newline at end of file
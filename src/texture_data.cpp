@@ -0,0 +1,155 @@
+#include "texture_data.hpp"
+
+#include "glad/glad.h"
+
+#include "gl_extensions.hpp"
+
+bool isCompressed(TextureFormat format) {
+    return format != TextureFormat::R8 && format != TextureFormat::RGB8 && format != TextureFormat::RGBA8;
+}
+
+unsigned int formatBlockBytes(TextureFormat format) {
+    switch (format) {
+        case TextureFormat::R8:
+            return 1;
+        case TextureFormat::RGB8:
+            return 3;
+        case TextureFormat::RGBA8:
+            return 4;
+        case TextureFormat::BC1:
+        case TextureFormat::BC4:
+        case TextureFormat::ETC2_RGB:
+            return 8;
+        case TextureFormat::BC3:
+        case TextureFormat::BC5:
+        case TextureFormat::BC7:
+        case TextureFormat::ETC2_RGBA:
+            return 16;
+        default:
+            return 0;
+    }
+}
+
+size_t levelSize(TextureFormat format, unsigned int width, unsigned int height) {
+    if (!isCompressed(format))
+        return (size_t) width * height * formatBlockBytes(format);
+
+    // partial blocks at the edges still take a whole block
+    size_t blocksX = (width + 3) / 4;
+    size_t blocksY = (height + 3) / 4;
+    return blocksX * blocksY * formatBlockBytes(format);
+}
+
+unsigned int mipLevelCount(unsigned int width, unsigned int height) {
+    unsigned int levels = 1;
+    while (width > 1 || height > 1) {
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+        levels++;
+    }
+    return levels;
+}
+
+unsigned int glInternalFormat(TextureFormat format) {
+    switch (format) {
+        case TextureFormat::R8:
+            return GL_RED;
+        case TextureFormat::RGB8:
+            return GL_RGB;
+        case TextureFormat::RGBA8:
+            return GL_RGBA;
+        case TextureFormat::BC1:
+            return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        case TextureFormat::BC3:
+            return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        case TextureFormat::BC4:
+            return GL_COMPRESSED_RED_RGTC1;
+        case TextureFormat::BC5:
+            return GL_COMPRESSED_RG_RGTC2;
+        case TextureFormat::BC7:
+            return GL_COMPRESSED_RGBA_BPTC_UNORM;
+        case TextureFormat::ETC2_RGB:
+            return GL_COMPRESSED_RGB8_ETC2;
+        case TextureFormat::ETC2_RGBA:
+            return GL_COMPRESSED_RGBA8_ETC2_EAC;
+        default:
+            return 0;
+    }
+}
+
+bool isFormatSupported(TextureFormat format) {
+    switch (format) {
+        case TextureFormat::BC1:
+        case TextureFormat::BC3:
+            return glExtensions().textureCompressionS3TC;
+        case TextureFormat::BC7:
+            return glExtensions().textureCompressionBPTC;
+        case TextureFormat::ETC2_RGB:
+        case TextureFormat::ETC2_RGBA:
+            return glExtensions().textureCompressionETC2;
+        default:
+            // uncompressed formats, and RGTC (BC4/BC5), are core in 3.3
+            return true;
+    }
+}
+
+void uploadTextureLevel(TextureFormat format, unsigned int level, unsigned int width, unsigned int height,
+    const unsigned char* data, size_t size) {
+    if (isCompressed(format)) {
+        glCompressedTexImage2D(GL_TEXTURE_2D, (GLint) level, glInternalFormat(format), (GLsizei) width,
+            (GLsizei) height, 0, (GLsizei) size, data);
+        return;
+    }
+
+    GLenum pixelFormat = format == TextureFormat::R8 ? GL_RED : format == TextureFormat::RGB8 ? GL_RGB : GL_RGBA;
+    // rows of 1 and 3 channel images are not always 4 byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, (GLint) level, (GLint) glInternalFormat(format), (GLsizei) width,
+        (GLsizei) height, 0, pixelFormat, GL_UNSIGNED_BYTE, data);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+void uploadTexture(const TextureData &texture) {
+    for (unsigned int i = 0 ; i < texture.levels.size() ; i++) {
+        const TextureLevel &level = texture.levels[i];
+        uploadTextureLevel(texture.format, i, level.width, level.height, &level.data[0], level.data.size());
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint) texture.levels.size() - 1);
+}
+
+void uploadTextureArray(const std::vector<const TextureData*> &layers) {
+    const TextureData &first = *layers[0];
+    GLenum internalFormat = glInternalFormat(first.format);
+    GLenum pixelFormat = first.format == TextureFormat::R8 ? GL_RED
+        : first.format == TextureFormat::RGB8 ? GL_RGB : GL_RGBA;
+    GLsizei depth = (GLsizei) layers.size();
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (unsigned int i = 0 ; i < first.levels.size() ; i++) {
+        GLsizei width = (GLsizei) first.levels[i].width;
+        GLsizei height = (GLsizei) first.levels[i].height;
+        GLsizei size = (GLsizei) first.levels[i].data.size();
+        if (isCompressed(first.format)) {
+            glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, (GLint) i, internalFormat, width, height, depth, 0,
+                size * depth, NULL);
+        } else {
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, (GLint) i, (GLint) internalFormat, width, height, depth, 0,
+                pixelFormat, GL_UNSIGNED_BYTE, NULL);
+        }
+
+        for (unsigned int layer = 0 ; layer < layers.size() ; layer++) {
+            const unsigned char* data = &layers[layer]->levels[i].data[0];
+            if (isCompressed(first.format)) {
+                glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, (GLint) i, 0, 0, (GLint) layer, width, height, 1,
+                    internalFormat, size, data);
+            } else {
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, (GLint) i, 0, 0, (GLint) layer, width, height, 1,
+                    pixelFormat, GL_UNSIGNED_BYTE, data);
+            }
+        }
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, (GLint) first.levels.size() - 1);
+}
\ No newline at end of file
@@ -0,0 +1,381 @@
+#include "texture_manager.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+
+#include "glad/glad.h"
+
+#include "cooked_assets.hpp"
+#include "dds.hpp"
+#include "fileutil.hpp"
+#include "hash.hpp"
+#include "ktx2.hpp"
+#include "pak.hpp"
+#include "texture_compression.hpp"
+
+// bump when the encoders change, to invalidate cached textures
+static const uint64_t textureCacheVersion = 3;
+
+TextureManager &TextureManager::instance() {
+    static TextureManager manager;
+    return manager;
+}
+
+unsigned int TextureManager::acquire(const char* path, TextureData* decoded) {
+    std::string key = canonicalPath(path);
+    std::unordered_map<std::string, Entry>::iterator found = entries.find(key);
+    if (found != entries.end()) {
+        found->second.references++;
+        return found->second.id;
+    }
+
+    Entry entry;
+    load(path, entry, decoded);
+    entry.references = 1;
+    resident += entryBytes(entry);
+    entries[key] = entry;
+    pathsById[entry.id] = key;
+    return entry.id;
+}
+
+void TextureManager::release(unsigned int id) {
+    std::unordered_map<unsigned int, std::string>::iterator path = pathsById.find(id);
+    if (path == pathsById.end())
+        return;
+
+    std::unordered_map<std::string, Entry>::iterator found = entries.find(path->second);
+    if (--found->second.references > 0)
+        return;
+
+    glDeleteTextures(1, &id);
+    resident -= entryBytes(found->second);
+    delete found->second.source;
+    entries.erase(found);
+    pathsById.erase(path);
+}
+
+bool TextureManager::loaded(const char* path) const {
+    return entries.find(canonicalPath(path)) != entries.end();
+}
+
+bool TextureManager::loadData(const char* path, TextureData &texture) {
+    if (loadPrecompressed(path, texture))
+        return true;
+
+    std::string cachePath = cacheFilePath(path);
+    KTX2File cached;
+    if (openCooked(path, cached)
+        || (!cachePath.empty() && cached.open(cachePath.c_str()) && isFormatSupported(cached.format()))) {
+        cached.read(texture);
+        return true;
+    }
+
+    if (!importTexture(path, compressing(), texture)) {
+        printf("Texture load failed\nPath: %s\n", path);
+        return false;
+    }
+    if (!cachePath.empty() && (!makeDirectories(cacheDirectory) || !saveKTX2(cachePath.c_str(), texture)))
+        printf("Texture cache write failed\nPath: %s\n", cachePath.c_str());
+    return true;
+}
+
+void TextureManager::decode(const char* path, TextureData &texture) const {
+    texture.levels.clear();
+    // the checks of loadData, without reading anything yet
+    if (assetExists(precompressedPath(path).c_str()))
+        return;
+    std::string cachePath = cacheFilePath(path);
+    KTX2File cached;
+    if (openCooked(path, cached)
+        || (!cachePath.empty() && cached.open(cachePath.c_str()) && isFormatSupported(cached.format())))
+        return;
+
+    if (!importTexture(path, compressing(), texture)) {
+        printf("Texture load failed\nPath: %s\n", path);
+        return;
+    }
+    if (!cachePath.empty() && (!makeDirectories(cacheDirectory) || !saveKTX2(cachePath.c_str(), texture)))
+        printf("Texture cache write failed\nPath: %s\n", cachePath.c_str());
+}
+
+void TextureManager::pin(unsigned int id) {
+    std::unordered_map<unsigned int, std::string>::iterator path = pathsById.find(id);
+    if (path == pathsById.end())
+        return;
+
+    Entry &entry = entries[path->second];
+    if (entry.source == NULL)
+        return;
+    while (entry.baseLevel > 0) {
+        raiseLevel(entry);
+    }
+    delete entry.source;
+    entry.source = NULL;
+}
+
+size_t TextureManager::size() const {
+    return entries.size();
+}
+
+void TextureManager::setCompression(bool enabled) {
+    compression = enabled;
+}
+
+void TextureManager::setCacheDirectory(const std::string &directory) {
+    cacheDirectory = directory;
+}
+
+void TextureManager::request(unsigned int id, float pixels) {
+    std::unordered_map<unsigned int, std::string>::iterator path = pathsById.find(id);
+    if (path == pathsById.end())
+        return;
+
+    Entry &entry = entries[path->second];
+    if (entry.source == NULL)
+        return;
+
+    // level whose size is closest to (but at least) pixels
+    float size = (float) std::max(entry.width, entry.height);
+    float level = std::floor(std::log2(size / std::max(pixels, 1.0f)));
+    unsigned int wanted = (unsigned int) std::min(std::max(level, 0.0f), (float) (entry.levels - 1));
+    entry.requestedLevel = std::min(entry.requestedLevel, wanted);
+    entry.lastRequested = frame;
+}
+
+void TextureManager::update() {
+    // textures nobody asked for only keep their always resident levels
+    for (std::unordered_map<std::string, Entry>::iterator i = entries.begin() ; i != entries.end() ; ++i) {
+        Entry &entry = i->second;
+        if (entry.source == NULL)
+            continue;
+        unsigned int floor = streamingFloor(entry);
+        entry.targetLevel = entry.lastRequested == frame ? std::min(entry.requestedLevel, floor) : floor;
+        entry.requestedLevel = entry.levels;
+    }
+
+    // one level at a time, to the texture missing the most levels first.
+    // room is made by releasing levels other textures don't need anymore
+    for (unsigned int uploads = 0 ; uploads < uploadsPerFrame ; uploads++) {
+        Entry* next = NULL;
+        for (std::unordered_map<std::string, Entry>::iterator i = entries.begin() ; i != entries.end() ; ++i) {
+            Entry &entry = i->second;
+            if (entry.source != NULL && entry.targetLevel < entry.baseLevel
+                && (next == NULL || entry.baseLevel - entry.targetLevel > next->baseLevel - next->targetLevel))
+                next = &entry;
+        }
+        if (next == NULL)
+            break;
+
+        size_t needed = levelBytes(*next, next->baseLevel - 1);
+        Entry* victim;
+        while (resident + needed > budget && (victim = evictionCandidate(next)) != NULL) {
+            dropLevel(*victim);
+        }
+        if (resident + needed > budget)
+            break;
+        raiseLevel(*next);
+    }
+
+    // the budget may have been lowered, or be too small for what is on
+    // screen: then the largest textures lose levels even if they need them
+    Entry* victim;
+    while (resident > budget && (victim = evictionCandidate(NULL)) != NULL) {
+        dropLevel(*victim);
+    }
+    while (resident > budget && (victim = largestStreamed()) != NULL) {
+        dropLevel(*victim);
+        victim->targetLevel = std::max(victim->targetLevel, victim->baseLevel);
+    }
+
+    frame++;
+}
+
+void TextureManager::setBudget(size_t bytes) {
+    budget = bytes;
+}
+
+size_t TextureManager::residentBytes() const {
+    return resident;
+}
+
+void TextureManager::load(const char* path, Entry &entry, TextureData* decoded) {
+    glGenTextures(1, &entry.id);
+    glBindTexture(GL_TEXTURE_2D, entry.id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    entry.format = TextureFormat::RGBA8;
+    entry.width = 0;
+    entry.height = 0;
+    entry.levels = 0;
+    entry.baseLevel = 0;
+    entry.targetLevel = 0;
+    entry.requestedLevel = 0;
+    entry.lastRequested = 0;
+    entry.source = NULL;
+
+    TextureData texture;
+    std::string cachePath = cacheFilePath(path);
+    KTX2File* cached = new KTX2File();
+    if (loadPrecompressed(path, texture)) {
+        uploadTexture(texture);
+    } else if (openCooked(path, *cached)
+        || (!cachePath.empty() && cached->open(cachePath.c_str()) && isFormatSupported(cached->format()))) {
+        // only the small levels for now, update streams in the rest
+        entry.source = cached;
+        entry.format = cached->format();
+        entry.width = cached->width();
+        entry.height = cached->height();
+        entry.levels = cached->levelCount();
+        entry.baseLevel = streamingFloor(entry);
+        entry.requestedLevel = entry.levels;
+        cached->upload(entry.baseLevel);
+        return;
+    } else if (decoded != NULL && !decoded->levels.empty()) {
+        // decode() would have written the cache, and the texture streamed
+        // from it above. so there is no cache and it stays resident
+        texture.format = decoded->format;
+        texture.levels.swap(decoded->levels);
+        uploadTexture(texture);
+    } else if (importTexture(path, compressing(), texture)) {
+        uploadTexture(texture);
+
+        if (!cachePath.empty()) {
+            if (makeDirectories(cacheDirectory) && saveKTX2(cachePath.c_str(), texture)
+                && cached->open(cachePath.c_str())) {
+                entry.source = cached;
+                entry.requestedLevel = (unsigned int) texture.levels.size();
+            } else {
+                printf("Texture cache write failed\nPath: %s\n", cachePath.c_str());
+            }
+        }
+    } else {
+        printf("Texture load failed\nPath: %s\n", path);
+    }
+
+    if (entry.source == NULL)
+        delete cached;
+    if (!texture.levels.empty()) {
+        entry.format = texture.format;
+        entry.width = texture.levels[0].width;
+        entry.height = texture.levels[0].height;
+        entry.levels = (unsigned int) texture.levels.size();
+    }
+}
+
+bool TextureManager::loadPrecompressed(const char* path, TextureData &texture) {
+    std::string ddsPath = precompressedPath(path);
+    if (!assetExists(ddsPath.c_str()) || !loadDDS(ddsPath.c_str(), texture))
+        return false;
+    if (!isFormatSupported(texture.format)) {
+        printf("Texture format not supported by the context, using the source image\nPath: %s\n", ddsPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+std::string TextureManager::precompressedPath(const char* path) {
+    std::string ddsPath = path;
+    size_t dot = ddsPath.find_last_of('.');
+    size_t slash = ddsPath.find_last_of("/\\");
+    if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+        ddsPath.erase(dot);
+    ddsPath += ".dds";
+    return ddsPath;
+}
+
+std::string TextureManager::cacheFilePath(const char* path) const {
+    if (cacheDirectory.empty())
+        return "";
+
+    // a new key whenever the source changes, or is loaded differently
+    uint64_t key = hashString(canonicalPath(path));
+    key = hashCombine(key, (uint64_t) fileModifiedTime(path));
+    key = hashCombine(key, compressing() ? 1 : 0);
+    key = hashCombine(key, textureCacheVersion);
+
+    char filename[32];
+    snprintf(filename, sizeof(filename), "%016" PRIx64 ".ktx2", key);
+    return cacheDirectory + "/" + filename;
+}
+
+bool TextureManager::openCooked(const char* path, KTX2File &file) const {
+    std::string cookedPath = CookedAssets::instance().find(path);
+    // cooked textures are compressed, unusable without BC support
+    return !cookedPath.empty() && file.open(cookedPath.c_str()) && isFormatSupported(file.format());
+}
+
+bool TextureManager::compressing() const {
+    return compression && isFormatSupported(TextureFormat::BC1);
+}
+
+size_t TextureManager::levelBytes(const Entry &entry, unsigned int level) const {
+    return levelSize(entry.format, std::max(entry.width >> level, 1u), std::max(entry.height >> level, 1u));
+}
+
+size_t TextureManager::entryBytes(const Entry &entry) const {
+    size_t bytes = 0;
+    for (unsigned int level = entry.baseLevel ; level < entry.levels ; level++) {
+        bytes += levelBytes(entry, level);
+    }
+    return bytes;
+}
+
+unsigned int TextureManager::streamingFloor(const Entry &entry) const {
+    unsigned int level = 0;
+    while (level + 1 < entry.levels && std::max(entry.width >> level, entry.height >> level) > minimumResidentSize) {
+        level++;
+    }
+    return level;
+}
+
+// the texture with levels finer than it needs that was drawn least
+// recently, or with the most surplus levels among equally recent ones
+TextureManager::Entry* TextureManager::evictionCandidate(const Entry* except) {
+    Entry* candidate = NULL;
+    for (std::unordered_map<std::string, Entry>::iterator i = entries.begin() ; i != entries.end() ; ++i) {
+        Entry &entry = i->second;
+        if (&entry == except || entry.source == NULL || entry.baseLevel >= entry.targetLevel)
+            continue;
+        if (candidate == NULL || entry.lastRequested < candidate->lastRequested
+            || (entry.lastRequested == candidate->lastRequested
+                && entry.targetLevel - entry.baseLevel > candidate->targetLevel - candidate->baseLevel))
+            candidate = &entry;
+    }
+    return candidate;
+}
+
+// the texture with the largest finest resident level above its floor
+TextureManager::Entry* TextureManager::largestStreamed() {
+    Entry* largest = NULL;
+    for (std::unordered_map<std::string, Entry>::iterator i = entries.begin() ; i != entries.end() ; ++i) {
+        Entry &entry = i->second;
+        if (entry.source == NULL || entry.baseLevel >= streamingFloor(entry))
+            continue;
+        if (largest == NULL || levelBytes(entry, entry.baseLevel) > levelBytes(*largest, largest->baseLevel))
+            largest = &entry;
+    }
+    return largest;
+}
+
+void TextureManager::raiseLevel(Entry &entry) {
+    entry.baseLevel--;
+    glBindTexture(GL_TEXTURE_2D, entry.id);
+    entry.source->uploadLevel(entry.baseLevel);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, (GLint) entry.baseLevel);
+    resident += levelBytes(entry, entry.baseLevel);
+}
+
+void TextureManager::dropLevel(Entry &entry) {
+    // sampling moves off the level first, then respecifying it as 0x0
+    // frees its storage
+    glBindTexture(GL_TEXTURE_2D, entry.id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, (GLint) entry.baseLevel + 1);
+    uploadTextureLevel(entry.format, entry.baseLevel, 0, 0, NULL, 0);
+    resident -= levelBytes(entry, entry.baseLevel);
+    entry.baseLevel++;
+}
\ No newline at end of file
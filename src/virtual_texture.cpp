@@ -0,0 +1,482 @@
+#include "virtual_texture.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "hash.hpp"
+#include "image_decoder.hpp"
+#include "image_processing.hpp"
+#include "shader.hpp"
+
+struct PageFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t pageSize;
+    uint32_t border;
+    uint32_t levels;
+    uint32_t reserved;
+};
+
+static const char pageFileMagic[4] = { 'L', 'G', 'V', 'T' };
+static const uint32_t pageFileVersion = 2;
+static const unsigned int slotSize = VirtualTextureSystem::pageSize + 2 * VirtualTextureSystem::pageBorder;
+static const size_t pageBytes = (size_t) slotSize * slotSize * 4;
+// texture ids and page coordinates are written to 8 bit channels
+static const unsigned int maxTextures = 255;
+static const unsigned int maxPages = 256;
+
+static unsigned int levelCount(unsigned int width, unsigned int height);
+static bool buildPageFile(const char* imagePath, const char* pagePath);
+static unsigned int nextPowerOfTwo(unsigned int value);
+
+VirtualTextureSystem::VirtualTextureSystem(const std::string &pageFileDirectory, unsigned int cacheSlots,
+    unsigned int inUploadsPerFrame) : directory(pageFileDirectory), slots(cacheSlots),
+    uploadsPerFrame(inUploadsPerFrame), frame(0), feedbackFramebuffer(0), feedbackColor(0), feedbackDepth(0),
+    feedbackWidth(0), feedbackHeight(0), screenWidth(0), screenHeight(0), feedbackIndex(0), feedbackSequence(0) {
+    glGenTextures(1, &cache);
+    glBindTexture(GL_TEXTURE_2D, cache);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, (GLsizei) (slots * slotSize), (GLsizei) (slots * slotSize), 0,
+        GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+    // handed out from the back, so slot 0 is used first
+    for (unsigned int slot = slots * slots ; slot-- > 0 ; ) {
+        freeSlots.push_back(slot);
+    }
+
+    glGenFramebuffers(1, &feedbackFramebuffer);
+    glGenRenderbuffers(1, &feedbackColor);
+    glGenRenderbuffers(1, &feedbackDepth);
+    for (unsigned int i = 0 ; i < feedbackFrames ; i++) {
+        glGenBuffers(1, &feedback[i].buffer);
+        feedback[i].fence = NULL;
+        feedback[i].sequence = 0;
+        feedback[i].width = 0;
+        feedback[i].height = 0;
+    }
+}
+
+VirtualTextureSystem::~VirtualTextureSystem() {
+    for (unsigned int i = 0 ; i < textures.size() ; i++) {
+        glDeleteTextures(1, &textures[i]->indirection);
+        delete textures[i];
+    }
+    for (unsigned int i = 0 ; i < feedbackFrames ; i++) {
+        if (feedback[i].fence != NULL)
+            glDeleteSync(feedback[i].fence);
+        glDeleteBuffers(1, &feedback[i].buffer);
+    }
+    glDeleteFramebuffers(1, &feedbackFramebuffer);
+    glDeleteRenderbuffers(1, &feedbackColor);
+    glDeleteRenderbuffers(1, &feedbackDepth);
+    glDeleteTextures(1, &cache);
+}
+
+unsigned int VirtualTextureSystem::add(const char* imagePath) {
+    if (textures.size() >= maxTextures) {
+        printf("Virtual texture limit reached\nPath: %s\n", imagePath);
+        return 0;
+    }
+
+    // rebuilt whenever the source image changes
+    uint64_t key = hashString(canonicalPath(imagePath));
+    key = hashCombine(key, (uint64_t) fileModifiedTime(imagePath));
+    key = hashCombine(key, pageSize);
+    key = hashCombine(key, pageBorder);
+    key = hashCombine(key, pageFileVersion);
+    char filename[32];
+    snprintf(filename, sizeof(filename), "%016" PRIx64 ".vtp", key);
+    std::string pagePath = directory + "/" + filename;
+
+    if (!fileExists(pagePath.c_str())) {
+        if (!makeDirectories(directory) || !buildPageFile(imagePath, pagePath.c_str())) {
+            printf("Virtual texture build failed\nPath: %s\n", imagePath);
+            return 0;
+        }
+    }
+
+    VirtualTexture* texture = new VirtualTexture();
+    PageFileHeader header;
+    if (!texture->pages.open(pagePath.c_str()) || texture->pages.size() < sizeof(header)) {
+        printf("Virtual texture load failed\nPath: %s\n", pagePath.c_str());
+        delete texture;
+        return 0;
+    }
+    std::memcpy(&header, texture->pages.data(), sizeof(header));
+
+    texture->width = header.width;
+    texture->height = header.height;
+    texture->levels = header.levels;
+    size_t pageCount = 0;
+    for (unsigned int level = 0 ; level < header.levels ; level++) {
+        unsigned int width = std::max(header.width >> level, 1u);
+        unsigned int height = std::max(header.height >> level, 1u);
+        texture->firstPage.push_back(pageCount);
+        texture->pagesX.push_back((width + pageSize - 1) / pageSize);
+        texture->pagesY.push_back((height + pageSize - 1) / pageSize);
+        pageCount += (size_t) texture->pagesX.back() * texture->pagesY.back();
+    }
+    if (std::memcmp(header.magic, pageFileMagic, 4) != 0 || header.version != pageFileVersion
+        || header.pageSize != pageSize || header.border != pageBorder
+        || texture->pages.size() < sizeof(header) + pageCount * pageBytes
+        || texture->pagesX[0] > maxPages || texture->pagesY[0] > maxPages) {
+        printf("Virtual texture load failed, invalid page file\nPath: %s\n", pagePath.c_str());
+        delete texture;
+        return 0;
+    }
+
+    // padded to powers of two, so every level of the table has at least
+    // as many texels as the texture has pages at that level
+    texture->indirectionWidth = nextPowerOfTwo(texture->pagesX[0]);
+    texture->indirectionHeight = nextPowerOfTwo(texture->pagesY[0]);
+    glGenTextures(1, &texture->indirection);
+    glBindTexture(GL_TEXTURE_2D, texture->indirection);
+    for (unsigned int level = 0 ; level < texture->levels ; level++) {
+        glTexImage2D(GL_TEXTURE_2D, (GLint) level, GL_RGBA8,
+            (GLsizei) std::max(texture->indirectionWidth >> level, 1u),
+            (GLsizei) std::max(texture->indirectionHeight >> level, 1u), 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint) texture->levels - 1);
+    texture->dirty = true;
+
+    textures.push_back(texture);
+    unsigned int id = (unsigned int) textures.size();
+    if (!makeResident(pageKey(id, texture->levels - 1, 0, 0), true))
+        printf("Virtual texture cache is full, texture will be black\nPath: %s\n", imagePath);
+    updateIndirection(id);
+    return id;
+}
+
+void VirtualTextureSystem::update() {
+    frame++;
+
+    // both lists only live during this call, in the frame arena
+    ArenaAllocator<uint32_t> allocator(FrameArena::instance().current());
+    ArenaVector<uint32_t> requests(allocator);
+    if (!readFeedback(requests))
+        return;
+
+    // pages in use this frame can't be evicted to make room for others
+    ArenaVector<uint32_t> missing(allocator);
+    missing.reserve(requests.size());
+    for (unsigned int i = 0 ; i < requests.size() ; i++) {
+        if (residents.count(requests[i]) != 0)
+            touch(requests[i]);
+        else
+            missing.push_back(requests[i]);
+    }
+
+    // coarse pages first: they cover more of the screen and are the
+    // fallback of the finer ones
+    std::sort(missing.begin(), missing.end(), [](uint32_t a, uint32_t b) {
+        return ((a >> 16) & 0xFF) > ((b >> 16) & 0xFF);
+    });
+    unsigned int uploads = std::min((unsigned int) missing.size(), uploadsPerFrame);
+    for (unsigned int i = 0 ; i < uploads ; i++) {
+        if (!makeResident(missing[i], false))
+            break;
+    }
+
+    for (unsigned int i = 0 ; i < textures.size() ; i++) {
+        if (textures[i]->dirty)
+            updateIndirection(i + 1);
+    }
+}
+
+void VirtualTextureSystem::beginFeedback(int inScreenWidth, int inScreenHeight) {
+    screenWidth = inScreenWidth;
+    screenHeight = inScreenHeight;
+    int width = std::max(screenWidth / (int) feedbackDivisor, 1);
+    int height = std::max(screenHeight / (int) feedbackDivisor, 1);
+    if (width != feedbackWidth || height != feedbackHeight) {
+        feedbackWidth = width;
+        feedbackHeight = height;
+        glBindRenderbuffer(GL_RENDERBUFFER, feedbackColor);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, feedbackDepth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, feedbackFramebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, feedbackColor);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, feedbackDepth);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, feedbackFramebuffer);
+    glViewport(0, 0, feedbackWidth, feedbackHeight);
+    // alpha 0 is "no texture"
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void VirtualTextureSystem::endFeedback() {
+    FeedbackFrame &target = feedback[feedbackIndex];
+    feedbackIndex = (feedbackIndex + 1) % feedbackFrames;
+    if (target.fence != NULL)
+        glDeleteSync(target.fence);
+
+    // the copy into the pixel buffer runs on the GPU; readFeedback maps
+    // it once the fence says it is done
+    size_t size = (size_t) feedbackWidth * (size_t) feedbackHeight * 4;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, target.buffer);
+    if (target.width != feedbackWidth || target.height != feedbackHeight)
+        glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr) size, NULL, GL_STREAM_READ);
+    glReadPixels(0, 0, feedbackWidth, feedbackHeight, GL_RGBA, GL_UNSIGNED_BYTE, (void*) 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    target.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    target.sequence = ++feedbackSequence;
+    target.width = feedbackWidth;
+    target.height = feedbackHeight;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, screenWidth, screenHeight);
+}
+
+void VirtualTextureSystem::bind(Shader &shader, unsigned int texture, bool feedbackPass) const {
+    if (texture == 0 || texture > textures.size())
+        return;
+
+    const VirtualTexture &virtualTexture = *textures[texture - 1];
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, virtualTexture.indirection);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, cache);
+
+    shader.setInt("vtCache", 0);
+    shader.setInt("vtIndirection", 1);
+    shader.setVec2("vtSize", (float) virtualTexture.width, (float) virtualTexture.height);
+    shader.setFloat("vtMaxLevel", (float) (virtualTexture.levels - 1));
+    shader.setFloat("vtPageSize", (float) pageSize);
+    shader.setFloat("vtBorder", (float) pageBorder);
+    shader.setFloat("vtCacheSize", (float) (slots * slotSize));
+    shader.setFloat("vtId", (float) texture);
+    shader.setFloat("vtLodBias", feedbackPass ? -std::log2((float) feedbackDivisor) : 0.0f);
+}
+
+uint32_t VirtualTextureSystem::pageKey(unsigned int texture, unsigned int level, unsigned int x, unsigned int y) {
+    return (uint32_t) (texture << 24 | level << 16 | y << 8 | x);
+}
+
+bool VirtualTextureSystem::readFeedback(ArenaVector<uint32_t> &requests) {
+    // the newest finished frame wins, older ones are out of date
+    FeedbackFrame* newest = NULL;
+    for (unsigned int i = 0 ; i < feedbackFrames ; i++) {
+        FeedbackFrame &candidate = feedback[i];
+        if (candidate.fence == NULL)
+            continue;
+        GLenum status = glClientWaitSync(candidate.fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            continue;
+        if (newest == NULL || candidate.sequence > newest->sequence)
+            newest = &candidate;
+    }
+    if (newest == NULL)
+        return false;
+    for (unsigned int i = 0 ; i < feedbackFrames ; i++) {
+        if (feedback[i].fence != NULL && feedback[i].sequence <= newest->sequence) {
+            glDeleteSync(feedback[i].fence);
+            feedback[i].fence = NULL;
+        }
+    }
+
+    size_t size = (size_t) newest->width * (size_t) newest->height * 4;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, newest->buffer);
+    const unsigned char* pixels = (const unsigned char*) glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+        (GLsizeiptr) size, GL_MAP_READ_BIT);
+    if (pixels != NULL) {
+        // at most a request per pixel, reserved up front since growing
+        // would leave the smaller copies behind in the arena
+        requests.reserve(size / 4);
+        for (size_t i = 0 ; i < size ; i += 4) {
+            unsigned int texture = pixels[i + 3];
+            if (texture == 0 || texture > textures.size())
+                continue;
+            // clamped like the shader does, in case a texture's page
+            // count changed while a frame was in flight
+            const VirtualTexture &virtualTexture = *textures[texture - 1];
+            unsigned int level = std::min((unsigned int) pixels[i + 2], virtualTexture.levels - 1);
+            unsigned int x = std::min((unsigned int) pixels[i], virtualTexture.pagesX[level] - 1);
+            unsigned int y = std::min((unsigned int) pixels[i + 1], virtualTexture.pagesY[level] - 1);
+            requests.push_back(pageKey(texture, level, x, y));
+        }
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    std::sort(requests.begin(), requests.end());
+    requests.erase(std::unique(requests.begin(), requests.end()), requests.end());
+    return true;
+}
+
+void VirtualTextureSystem::touch(uint32_t key) {
+    Resident &resident = residents[key];
+    resident.lastUsed = frame;
+    if (!resident.pinned)
+        lru.splice(lru.begin(), lru, resident.position);
+}
+
+bool VirtualTextureSystem::makeResident(uint32_t key, bool pinned) {
+    unsigned int slot;
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    } else {
+        // evict the least recently used page, unless even that one is
+        // visible: then the cache is too small for the view
+        if (lru.empty() || residents[lru.back()].lastUsed == frame)
+            return false;
+        uint32_t evicted = lru.back();
+        slot = residents[evicted].slot;
+        lru.pop_back();
+        residents.erase(evicted);
+        textures[(evicted >> 24) - 1]->dirty = true;
+    }
+
+    unsigned int texture = key >> 24;
+    unsigned int level = (key >> 16) & 0xFF;
+    unsigned int y = (key >> 8) & 0xFF;
+    unsigned int x = key & 0xFF;
+    VirtualTexture &virtualTexture = *textures[texture - 1];
+    size_t page = virtualTexture.firstPage[level] + (size_t) y * virtualTexture.pagesX[level] + x;
+    const unsigned char* pixels = virtualTexture.pages.data() + sizeof(PageFileHeader) + page * pageBytes;
+
+    glBindTexture(GL_TEXTURE_2D, cache);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, (GLint) ((slot % slots) * slotSize), (GLint) ((slot / slots) * slotSize),
+        (GLsizei) slotSize, (GLsizei) slotSize, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+
+    Resident resident;
+    resident.slot = slot;
+    resident.lastUsed = frame;
+    resident.pinned = pinned;
+    if (!pinned) {
+        lru.push_front(key);
+        resident.position = lru.begin();
+    }
+    residents[key] = resident;
+    virtualTexture.dirty = true;
+    return true;
+}
+
+void VirtualTextureSystem::updateIndirection(unsigned int texture) {
+    VirtualTexture &virtualTexture = *textures[texture - 1];
+    virtualTexture.dirty = false;
+
+    // from the coarsest level down, every page without a resident copy
+    // inherits the entry of the page covering it one level up
+    std::vector<unsigned char> above;
+    std::vector<unsigned char> entries;
+    unsigned int aboveWidth = 0;
+    glBindTexture(GL_TEXTURE_2D, virtualTexture.indirection);
+    for (unsigned int level = virtualTexture.levels ; level-- > 0 ; ) {
+        unsigned int width = std::max(virtualTexture.indirectionWidth >> level, 1u);
+        unsigned int height = std::max(virtualTexture.indirectionHeight >> level, 1u);
+        entries.assign((size_t) width * height * 4, 0);
+        for (unsigned int y = 0 ; y < height ; y++) {
+            for (unsigned int x = 0 ; x < width ; x++) {
+                unsigned char* entry = &entries[((size_t) y * width + x) * 4];
+                std::unordered_map<uint32_t, Resident>::const_iterator resident = residents.end();
+                if (x < virtualTexture.pagesX[level] && y < virtualTexture.pagesY[level])
+                    resident = residents.find(pageKey(texture, level, x, y));
+
+                if (resident != residents.end()) {
+                    entry[0] = (unsigned char) (resident->second.slot % slots);
+                    entry[1] = (unsigned char) (resident->second.slot / slots);
+                    entry[2] = (unsigned char) level;
+                    entry[3] = 255;
+                } else if (!above.empty()) {
+                    std::memcpy(entry, &above[((size_t) (y / 2) * aboveWidth + x / 2) * 4], 4);
+                }
+            }
+        }
+        glTexSubImage2D(GL_TEXTURE_2D, (GLint) level, 0, 0, (GLsizei) width, (GLsizei) height,
+            GL_RGBA, GL_UNSIGNED_BYTE, &entries[0]);
+        above.swap(entries);
+        aboveWidth = width;
+    }
+}
+
+static unsigned int levelCount(unsigned int width, unsigned int height) {
+    unsigned int levels = 1;
+    while (width > VirtualTextureSystem::pageSize || height > VirtualTextureSystem::pageSize) {
+        width = std::max(width / 2, 1u);
+        height = std::max(height / 2, 1u);
+        levels++;
+    }
+    return levels;
+}
+
+// cuts every level of the image into pages with their borders. borders
+// wrap around the image edges, since textures repeat
+static bool buildPageFile(const char* imagePath, const char* pagePath) {
+    DecodedImage image;
+    if (!decodeImageFile(imagePath, image))
+        return false;
+
+    unsigned int width = image.width;
+    unsigned int height = image.height;
+    std::vector<unsigned char> current((size_t) width * height * 4);
+    expandToRGBA(&image.pixels[0], (size_t) width * height, image.channels, &current[0]);
+
+    PageFileHeader header;
+    std::memcpy(header.magic, pageFileMagic, 4);
+    header.version = pageFileVersion;
+    header.width = width;
+    header.height = height;
+    header.pageSize = VirtualTextureSystem::pageSize;
+    header.border = VirtualTextureSystem::pageBorder;
+    header.levels = levelCount(width, height);
+    header.reserved = 0;
+
+    const unsigned int pageSize = VirtualTextureSystem::pageSize;
+    const int border = (int) VirtualTextureSystem::pageBorder;
+    std::vector<unsigned char> bytes((const unsigned char*) &header, (const unsigned char*) (&header + 1));
+    std::vector<unsigned char> next;
+    for (unsigned int level = 0 ; level < header.levels ; level++) {
+        unsigned int pagesX = (width + pageSize - 1) / pageSize;
+        unsigned int pagesY = (height + pageSize - 1) / pageSize;
+        for (unsigned int pageY = 0 ; pageY < pagesY ; pageY++) {
+            for (unsigned int pageX = 0 ; pageX < pagesX ; pageX++) {
+                for (unsigned int row = 0 ; row < slotSize ; row++) {
+                    int sourceY = (int) (pageY * pageSize + row) - border;
+                    sourceY = (sourceY % (int) height + (int) height) % (int) height;
+                    for (unsigned int column = 0 ; column < slotSize ; column++) {
+                        int sourceX = (int) (pageX * pageSize + column) - border;
+                        sourceX = (sourceX % (int) width + (int) width) % (int) width;
+                        const unsigned char* texel = &current[((size_t) sourceY * width + (size_t) sourceX) * 4];
+                        bytes.insert(bytes.end(), texel, texel + 4);
+                    }
+                }
+            }
+        }
+
+        if (level + 1 < header.levels) {
+            unsigned int nextWidth = std::max(width / 2, 1u);
+            unsigned int nextHeight = std::max(height / 2, 1u);
+            next.resize((size_t) nextWidth * nextHeight * 4);
+            downsampleImage(&current[0], width, height, &next[0], MipOptions());
+            current.swap(next);
+            width = nextWidth;
+            height = nextHeight;
+        }
+    }
+
+    return writeFileBytes(pagePath, &bytes[0], bytes.size());
+}
+
+static unsigned int nextPowerOfTwo(unsigned int value) {
+    unsigned int power = 1;
+    while (power < value) {
+        power *= 2;
+    }
+    return power;
+}
\ No newline at end of file
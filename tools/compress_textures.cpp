@@ -0,0 +1,102 @@
+// Offline texture compression: writes <image>.dds next to each image,
+// which TextureManager then loads instead of decoding and compressing the
+// image at startup.
+//
+// usage: compress_textures [--normal] [--premultiply] [--box] <image>...
+//   --normal       compress the following images to BC5 (tangent-space
+//                  normal maps, x and y only, renormalized in every mip);
+//                  others pick BC1, BC3 or BC4 from their channel count
+//   --premultiply  multiply the following images' colors by their alpha
+//   --box          filter the following images' mips with a 2x2 box
+//                  instead of the Kaiser filter
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "dds.hpp"
+#include "image_decoder.hpp"
+#include "image_processing.hpp"
+#include "texture_compression.hpp"
+
+static const char* formatName(TextureFormat format);
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printf("usage: %s [--normal] [--premultiply] [--box] <image>...\n", argv[0]);
+        return 1;
+    }
+
+    bool normal = false;
+    bool premultiply = false;
+    MipOptions options;
+    int failed = 0;
+    for (int i = 1 ; i < argc ; i++) {
+        if (std::strcmp(argv[i], "--normal") == 0) {
+            normal = true;
+            options.normalMap = true;
+            continue;
+        }
+        if (std::strcmp(argv[i], "--premultiply") == 0) {
+            premultiply = true;
+            continue;
+        }
+        if (std::strcmp(argv[i], "--box") == 0) {
+            options.filter = MipFilter::BOX;
+            continue;
+        }
+
+        // same orientation as the renderer, see importTexture
+        DecodedImage image;
+        if (!decodeImageFile(argv[i], image)) {
+            printf("Texture load failed\nPath: %s\n", argv[i]);
+            failed++;
+            continue;
+        }
+        size_t count = (size_t) image.width * image.height;
+        std::vector<unsigned char> rgba(count * 4);
+        expandToRGBA(&image.pixels[0], count, image.channels, &rgba[0]);
+        if (premultiply)
+            premultiplyAlpha(&rgba[0], count);
+
+        TextureFormat format = normal ? TextureFormat::BC5
+            : image.channels == 1 ? TextureFormat::BC4
+            : image.channels == 3 ? TextureFormat::BC1 : TextureFormat::BC3;
+        MipOptions imageOptions = options;
+        imageOptions.srgb = !normal && image.channels != 1;
+        TextureData texture = compressTexture(&rgba[0], image.width, image.height, format, imageOptions);
+
+        std::string path = argv[i];
+        size_t dot = path.find_last_of('.');
+        size_t slash = path.find_last_of("/\\");
+        if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+            path.erase(dot);
+        path += ".dds";
+
+        if (saveDDS(path.c_str(), texture)) {
+            printf("%s > %s (%s, %u levels)\n", argv[i], path.c_str(), formatName(format),
+                (unsigned int) texture.levels.size());
+        } else {
+            printf("Texture save failed\nPath: %s\n", path.c_str());
+            failed++;
+        }
+    }
+
+    return failed > 0 ? 1 : 0;
+}
+
+static const char* formatName(TextureFormat format) {
+    switch (format) {
+        case TextureFormat::BC1:
+            return "BC1";
+        case TextureFormat::BC3:
+            return "BC3";
+        case TextureFormat::BC4:
+            return "BC4";
+        case TextureFormat::BC5:
+            return "BC5";
+        default:
+            return "?";
+    }
+}
\ No newline at end of file
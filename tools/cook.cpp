@@ -0,0 +1,291 @@
+// Offline asset cooker: imports every model and image under a source
+// directory and writes what the runtime loads in their place (see
+// CookedAssets) into a cooked directory, with a manifest.txt mapping
+// sources to outputs.
+//
+// usage: cook [<source dir> [<cooked dir>]]
+//   defaults to resources and cooked, which is what make cook runs
+//
+// Images become KTX2 files with their whole block compressed mip chain,
+// models binary files of optimized vertex and index buffers. Models are
+// cooked first, so that the images their materials use as normal or
+// height maps are compressed linear (BC5, BC4) rather than as sRGB color.
+// Outputs are named by a hash of their inputs' contents, so identical
+// sources share one file. Assets whose inputs are unchanged since the
+// last run (same modification times, output still there) are not cooked
+// again, the others are cooked in parallel over every core. Outputs the
+// new manifest no longer references are deleted.
+
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "asset_cache.hpp"
+#include "cooked_assets.hpp"
+#include "fileutil.hpp"
+#include "hash.hpp"
+#include "ktx2.hpp"
+#include "model_data.hpp"
+#include "parallel.hpp"
+#include "texture_compression.hpp"
+
+// bump when cooking changes, to recook everything
+static const unsigned int cookVersion = 3;
+
+static bool hasExtension(const std::string &path, const char* const* extensions);
+static unsigned int cookAll(const std::vector<std::string> &sources, const std::vector<std::string> &kinds,
+    const std::string &cookedDirectory, std::vector<ManifestEntry> &entries,
+    std::unordered_map<std::string, std::string> &imageKinds, unsigned int &failed);
+static bool cookAsset(const std::string &source, const std::string &kind, const std::string &cookedDirectory,
+    ManifestEntry &entry, std::vector<Texture> &dataTextures);
+static bool hashContents(const std::vector<std::pair<std::string, long long>> &dependencies, const std::string &kind, uint64_t &hash);
+static bool upToDate(const ManifestEntry &entry, const std::string &cookedDirectory);
+static unsigned int removeStale(const std::string &cookedDirectory, const std::vector<ManifestEntry> &entries);
+
+static const char* const imageExtensions[] = {".png", ".jpg", ".jpeg", ".tga", ".bmp", NULL};
+static const char* const modelExtensions[] = {".obj", ".glb", ".gltf", ".fbx", ".dae", NULL};
+static const char* const cookedExtensions[] = {".model", ".ktx2", NULL};
+
+int main(int argc, char** argv) {
+    if (argc > 3) {
+        printf("usage: %s [<source dir> [<cooked dir>]]\n", argv[0]);
+        return 1;
+    }
+    std::string sourceDirectory = argc > 1 ? argv[1] : "resources";
+    std::string cookedDirectory = argc > 2 ? argv[2] : "cooked";
+
+    std::vector<std::string> files;
+    if (!listFiles(sourceDirectory, files)) {
+        printf("Source directory listing failed\nPath: %s\n", sourceDirectory.c_str());
+        return 1;
+    }
+    if (!makeDirectories(cookedDirectory)) {
+        printf("Cooked directory creation failed\nPath: %s\n", cookedDirectory.c_str());
+        return 1;
+    }
+
+    std::string manifestPath = cookedDirectory + "/manifest.txt";
+    std::vector<ManifestEntry> previous;
+    unsigned int previousVersion = 0;
+    // everything is recooked after the cooker changed
+    if (readManifest(manifestPath.c_str(), previous, &previousVersion) && previousVersion != cookVersion)
+        previous.clear();
+    std::unordered_map<std::string, unsigned int> previousBySource;
+    for (unsigned int i = 0 ; i < previous.size() ; i++) {
+        previousBySource[previous[i].dependencies[0].first] = i;
+    }
+
+    // models are cooked first: their materials tell which images are
+    // normal or height maps, which are compressed as data rather than color
+    std::vector<ManifestEntry> entries;
+    std::vector<std::string> sources;
+    std::vector<std::string> kinds;
+    for (unsigned int i = 0 ; i < files.size() ; i++) {
+        if (!hasExtension(files[i], modelExtensions))
+            continue;
+        std::unordered_map<std::string, unsigned int>::iterator found = previousBySource.find(files[i]);
+        if (found != previousBySource.end() && previous[found->second].kind == "model"
+            && upToDate(previous[found->second], cookedDirectory)) {
+            entries.push_back(previous[found->second]);
+            continue;
+        }
+        sources.push_back(files[i]);
+        kinds.push_back("model");
+    }
+    unsigned int skipped = (unsigned int) entries.size();
+
+    // models are read ahead in the background while the first ones import
+    for (unsigned int i = 0 ; i < sources.size() ; i++) {
+        AssetCache::instance().prefetch(sources[i].c_str());
+    }
+    std::unordered_map<std::string, std::string> imageKinds;
+    unsigned int failed = 0;
+    unsigned int cookedCount = cookAll(sources, kinds, cookedDirectory, entries, imageKinds, failed);
+
+    // images not referenced by a model cooked this time keep the kind they
+    // were cooked as, their models are unchanged
+    sources.clear();
+    kinds.clear();
+    for (unsigned int i = 0 ; i < files.size() ; i++) {
+        if (!hasExtension(files[i], imageExtensions))
+            continue;
+        std::unordered_map<std::string, unsigned int>::iterator found = previousBySource.find(files[i]);
+        std::unordered_map<std::string, std::string>::iterator referenced = imageKinds.find(canonicalPath(files[i].c_str()));
+        std::string kind = referenced != imageKinds.end() ? referenced->second
+            : found != previousBySource.end() && previous[found->second].kind != "model" ? previous[found->second].kind
+            : "texture";
+        if (found != previousBySource.end() && previous[found->second].kind == kind
+            && upToDate(previous[found->second], cookedDirectory)) {
+            entries.push_back(previous[found->second]);
+            skipped++;
+            continue;
+        }
+        sources.push_back(files[i]);
+        kinds.push_back(kind);
+    }
+    cookedCount += cookAll(sources, kinds, cookedDirectory, entries, imageKinds, failed);
+
+    if (!writeManifest(manifestPath.c_str(), entries, cookVersion)) {
+        printf("Manifest write failed\nPath: %s\n", manifestPath.c_str());
+        return 1;
+    }
+    // only once the new manifest is written, the old one still used them
+    unsigned int removed = removeStale(cookedDirectory, entries);
+    printf("%u cooked, %u up to date, %u failed, %u removed\n", cookedCount, skipped, failed, removed);
+    return failed > 0 ? 1 : 0;
+}
+
+static bool hasExtension(const std::string &path, const char* const* extensions) {
+    size_t dot = path.find_last_of('.');
+    size_t slash = path.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return false;
+
+    std::string extension = path.substr(dot);
+    for (unsigned int i = 0 ; i < extension.size() ; i++) {
+        if (extension[i] >= 'A' && extension[i] <= 'Z')
+            extension[i] = (char) (extension[i] - 'A' + 'a');
+    }
+    for (unsigned int i = 0 ; extensions[i] != NULL ; i++) {
+        if (extension == extensions[i])
+            return true;
+    }
+    return false;
+}
+
+// cooks sources in parallel, every worker taking the next uncooked one,
+// and appends their entries. the images models reference as normal or
+// height maps are added to imageKinds, by canonical path. returns how many
+// were cooked, adding the others to failed
+static unsigned int cookAll(const std::vector<std::string> &sources, const std::vector<std::string> &kinds,
+        const std::string &cookedDirectory, std::vector<ManifestEntry> &entries,
+        std::unordered_map<std::string, std::string> &imageKinds, unsigned int &failed) {
+    std::vector<ManifestEntry> cooked(sources.size());
+    std::vector<std::vector<Texture>> dataTextures(sources.size());
+    std::vector<char> succeeded(sources.size(), 0);
+    std::atomic<unsigned int> next(0);
+    parallelFor(workerCount(), 1, [&](unsigned int, unsigned int) {
+        unsigned int i;
+        while ((i = next++) < sources.size()) {
+            succeeded[i] = cookAsset(sources[i], kinds[i], cookedDirectory, cooked[i], dataTextures[i]);
+        }
+    });
+
+    unsigned int count = 0;
+    for (unsigned int i = 0 ; i < sources.size() ; i++) {
+        if (!succeeded[i]) {
+            failed++;
+            continue;
+        }
+        printf("%s > %s/%s\n", sources[i].c_str(), cookedDirectory.c_str(), cooked[i].output.c_str());
+        entries.push_back(cooked[i]);
+        count++;
+
+        // texture paths are relative to the model. the first reference wins
+        std::string directory = sources[i].substr(0, sources[i].find_last_of("/\\"));
+        for (unsigned int j = 0 ; j < dataTextures[i].size() ; j++) {
+            std::string path = canonicalPath((directory + '/' + dataTextures[i][j].path).c_str());
+            const char* kind = dataTextures[i][j].type == "texture_normal" ? "normal_map" : "height_map";
+            imageKinds.insert(std::make_pair(path, std::string(kind)));
+        }
+    }
+    return count;
+}
+
+static bool cookAsset(const std::string &source, const std::string &kind, const std::string &cookedDirectory,
+        ManifestEntry &entry, std::vector<Texture> &dataTextures) {
+    entry.kind = kind;
+    entry.dependencies.clear();
+
+    // the same processing as the runtime, but always compressed and with
+    // the slow mesh optimizations
+    TextureData texture;
+    ModelData model;
+    std::vector<std::string> dependencies;
+    if (kind != "model") {
+        TextureUsage usage = kind == "normal_map" ? TextureUsage::NORMAL_MAP
+            : kind == "height_map" ? TextureUsage::HEIGHT_MAP : TextureUsage::COLOR;
+        if (!importTexture(source.c_str(), true, texture, usage)) {
+            printf("Texture load failed\nPath: %s\n", source.c_str());
+            return false;
+        }
+        dependencies.push_back(source);
+    } else if (!importModel(source.c_str(), model, true, &dependencies)) {
+        return false;
+    }
+    dataTextures.swap(model.dataTextures);
+
+    // the source first, then whatever else the importer read
+    entry.dependencies.push_back(std::make_pair(source, fileModifiedTime(source.c_str())));
+    for (unsigned int i = 0 ; i < dependencies.size() ; i++) {
+        if (canonicalPath(dependencies[i].c_str()) != canonicalPath(source.c_str()))
+            entry.dependencies.push_back(std::make_pair(dependencies[i], fileModifiedTime(dependencies[i].c_str())));
+    }
+
+    uint64_t hash;
+    if (!hashContents(entry.dependencies, kind, hash))
+        return false;
+    char filename[32];
+    snprintf(filename, sizeof(filename), "%016" PRIx64 "%s", hash, kind == "model" ? ".model" : ".ktx2");
+    entry.output = filename;
+
+    std::string output = cookedDirectory + "/" + entry.output;
+    if (kind == "model" ? !saveCookedModel(output.c_str(), model) : !saveKTX2(output.c_str(), texture)) {
+        printf("Cooked asset write failed\nPath: %s\n", output.c_str());
+        return false;
+    }
+    return true;
+}
+
+static bool hashContents(const std::vector<std::pair<std::string, long long>> &dependencies, const std::string &kind, uint64_t &hash) {
+    hash = hashCombine(hashString(kind), cookVersion);
+    for (unsigned int i = 0 ; i < dependencies.size() ; i++) {
+        std::vector<unsigned char> bytes;
+        if (!readFileBytes(dependencies[i].first.c_str(), bytes)) {
+            printf("Cook dependency read failed\nPath: %s\n", dependencies[i].first.c_str());
+            return false;
+        }
+        hash = hashCombine(hash, bytes.empty() ? 0 : hashBytes(&bytes[0], bytes.size()));
+    }
+    return true;
+}
+
+static bool upToDate(const ManifestEntry &entry, const std::string &cookedDirectory) {
+    if (!fileExists((cookedDirectory + "/" + entry.output).c_str()))
+        return false;
+    for (unsigned int i = 0 ; i < entry.dependencies.size() ; i++) {
+        if (fileModifiedTime(entry.dependencies[i].first.c_str()) != entry.dependencies[i].second)
+            return false;
+    }
+    return true;
+}
+
+// deletes the outputs of sources that were removed, and those a changed
+// source was cooked to before. returns how many
+static unsigned int removeStale(const std::string &cookedDirectory, const std::vector<ManifestEntry> &entries) {
+    std::unordered_map<std::string, bool> referenced;
+    for (unsigned int i = 0 ; i < entries.size() ; i++) {
+        referenced[entries[i].output] = true;
+    }
+
+    std::vector<std::string> files;
+    if (!listFiles(cookedDirectory, files))
+        return 0;
+    unsigned int removed = 0;
+    for (unsigned int i = 0 ; i < files.size() ; i++) {
+        // outputs are written directly into the cooked directory
+        std::string name = files[i].substr(cookedDirectory.size() + 1);
+        if (name.find('/') != std::string::npos || !hasExtension(name, cookedExtensions)
+            || referenced.find(name) != referenced.end())
+            continue;
+        if (std::remove(files[i].c_str()) == 0)
+            removed++;
+        else
+            printf("Stale cooked asset removal failed\nPath: %s\n", files[i].c_str());
+    }
+    return removed;
+}
\ No newline at end of file
@@ -0,0 +1,89 @@
+// Image decoding benchmark: decodes every image with each compiled in
+// backend that accepts it (see imageDecoders, stb_image accepts all) and
+// reports the fastest of several runs, flip included, as the renderer
+// loads them. Files are read into memory first, so disk speed is left out.
+//
+// usage: decode_benchmark [--runs <count>] [<image>...]
+//   without images, the textures shipped in resources/ are used
+//   --runs  decodes per image and backend, 5 by default
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "fileutil.hpp"
+#include "image_decoder.hpp"
+
+static const char* shippedImages[] = {
+    "resources/textures/awesomeface.png",
+    "resources/textures/container.jpg",
+    "resources/textures/container2.png",
+    "resources/textures/container2_specular.png",
+    "resources/textures/marble.jpg",
+    "resources/textures/metal.png",
+    "resources/models/backpack/ao.jpg",
+    "resources/models/cube/diffuse.jpg",
+    "resources/models/cube/normal.jpg",
+    "resources/models/cube/roughness.jpg"
+};
+
+int main(int argc, char** argv) {
+    unsigned int runs = 5;
+    std::vector<const char*> paths;
+    for (int i = 1 ; i < argc ; i++) {
+        if (std::strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+            runs = (unsigned int) std::max(std::atoi(argv[++i]), 1);
+            continue;
+        }
+        paths.push_back(argv[i]);
+    }
+    if (paths.empty())
+        paths.assign(shippedImages, shippedImages + sizeof(shippedImages) / sizeof(shippedImages[0]));
+
+    const std::vector<ImageDecoder> &decoders = imageDecoders();
+    std::vector<double> totals(decoders.size(), 0.0);
+    std::vector<unsigned int> counts(decoders.size(), 0);
+    printf("%-48s %-10s %11s %10s %10s\n", "image", "decoder", "size", "ms", "MP/s");
+    for (unsigned int i = 0 ; i < paths.size() ; i++) {
+        std::vector<unsigned char> bytes;
+        if (!readFileBytes(paths[i], bytes) || bytes.empty()) {
+            printf("Image read failed\nPath: %s\n", paths[i]);
+            continue;
+        }
+
+        for (unsigned int d = 0 ; d < decoders.size() ; d++) {
+            if (!decoders[d].accepts(&bytes[0], bytes.size()))
+                continue;
+
+            double best = 0.0;
+            DecodedImage image;
+            bool decoded = true;
+            for (unsigned int run = 0 ; run < runs && decoded ; run++) {
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                decoded = decodeImage(&bytes[0], bytes.size(), image, true, &decoders[d]);
+                double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                best = run == 0 ? ms : std::min(best, ms);
+            }
+            if (!decoded) {
+                printf("%-48s %-10s decode failed\n", paths[i], decoders[d].name);
+                continue;
+            }
+
+            char size[32];
+            snprintf(size, sizeof(size), "%ux%ux%u", image.width, image.height, image.channels);
+            double megapixels = (double) image.width * image.height / 1e6;
+            printf("%-48s %-10s %11s %10.2f %10.1f\n", paths[i], decoders[d].name, size, best, megapixels / (best / 1000.0));
+            totals[d] += best;
+            counts[d]++;
+        }
+    }
+
+    printf("\n");
+    for (unsigned int d = 0 ; d < decoders.size() ; d++) {
+        printf("%-10s %u images, %.2f ms total\n", decoders[d].name, counts[d], totals[d]);
+    }
+    return 0;
+}
\ No newline at end of file
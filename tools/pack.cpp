@@ -0,0 +1,78 @@
+// Pak archive writer: packs files, and every file under directories, into
+// one archive that the renderer mounts (see mountPak) instead of opening
+// them one by one.
+//
+// usage: pack <archive> [--store] [--lz4] [--zstd] <file or directory>...
+//   --store  store the following files uncompressed (the default). files
+//            that are streamed, like cooked KTX2 textures, are best
+//            stored: they are then used straight from the mapping
+//   --lz4    compress the following files with LZ4
+//   --zstd   compress the following files with Zstandard, which packs
+//            smaller but decompresses slower (builds with USE_ZSTD only)
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "fileutil.hpp"
+#include "pak.hpp"
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        printf("usage: %s <archive> [--store] [--lz4] [--zstd] <file or directory>...\n", argv[0]);
+        return 1;
+    }
+
+    PakCompression compression = PakCompression::NONE;
+    std::vector<PakSource> files;
+    size_t bytes = 0;
+    for (int i = 2 ; i < argc ; i++) {
+        if (std::strcmp(argv[i], "--store") == 0) {
+            compression = PakCompression::NONE;
+            continue;
+        }
+        if (std::strcmp(argv[i], "--lz4") == 0) {
+            compression = PakCompression::LZ4;
+            continue;
+        }
+        if (std::strcmp(argv[i], "--zstd") == 0) {
+#ifdef USE_ZSTD
+            compression = PakCompression::ZSTD;
+            continue;
+#else
+            printf("Zstandard compression requires building with compressors=zstd\n");
+            return 1;
+#endif
+        }
+
+        std::vector<std::string> paths;
+        std::string input = argv[i];
+        while (input.size() > 1 && (input[input.size() - 1] == '/' || input[input.size() - 1] == '\\')) {
+            input.erase(input.size() - 1);
+        }
+        if (!listFiles(input, paths))
+            paths.push_back(input);
+        for (unsigned int j = 0 ; j < paths.size() ; j++) {
+            PakSource file;
+            file.path = paths[j];
+            file.compression = compression;
+            if (!readFileBytes(paths[j].c_str(), file.contents)) {
+                printf("Pack input read failed\nPath: %s\n", paths[j].c_str());
+                return 1;
+            }
+            bytes += file.contents.size();
+            files.push_back(file);
+        }
+    }
+
+    if (!writePak(argv[1], files)) {
+        printf("Pak write failed\nPath: %s\n", argv[1]);
+        return 1;
+    }
+    MappedFile archive;
+    archive.open(argv[1]);
+    printf("%s: %u files, %.1f MB packed into %.1f MB\n", argv[1], (unsigned int) files.size(),
+        bytes / 1048576.0, archive.size() / 1048576.0);
+    return 0;
+}
\ No newline at end of file